@@ -0,0 +1,432 @@
+#include "core/engine.h"
+
+#include "hierarchy/services/workspace.h"
+#include "hierarchy/services/scripting.h"
+#include "hierarchy/services/renderer.h"
+#include "hierarchy/services/mesh_cache.h"
+#include "hierarchy/services/debug.h"
+
+#include "logging/log.h"
+
+#include "spdlog/spdlog.h"
+
+#include <random>
+
+// Microbenchmarks for the engine's hot paths. Every benchmark runs a fixed amount of work per
+// sample with fixed seeds, the report has nanoseconds per operation over all samples.
+// Results go to a JSON file (bench.json by default) for comparing runs, a table to stdout.
+
+namespace {
+	// Results are folded into this so the optimizer can't drop the work being measured
+	volatile std::uintptr_t g_sink = 0;
+
+	template<typename T>
+	void keep(const T& value) {
+		g_sink = g_sink ^ static_cast<std::uintptr_t>(std::hash<T>{}(value));
+	}
+
+	template<typename T>
+	void keep(const std::shared_ptr<T>& value) {
+		g_sink = g_sink ^ reinterpret_cast<std::uintptr_t>(value.get());
+	}
+
+	struct Result {
+		std::string name;
+		std::uint64_t operations = 0; // per sample
+		std::vector<double> samples;  // ns per operation
+		std::string skipped;          // why, when it didn't run
+	};
+
+	class Bench {
+	public:
+		Bench(std::size_t repetitions, std::string filter)
+			: m_repetitions(repetitions), m_filter(std::move(filter)) {}
+
+		bool selected(std::string_view name) const {
+			return m_filter.empty() || name.find(m_filter) != std::string_view::npos;
+		}
+
+		// setup runs untimed before every sample, body does operations of whatever is measured
+		template<typename Setup, typename Body>
+		void run(std::string name, std::uint64_t operations, Setup&& setup, Body&& body) {
+			if (!selected(name)) return;
+
+			Result result{ std::move(name), operations };
+			result.samples.reserve(m_repetitions);
+			// One sample for warmup, caches and lazily created state
+			for (std::size_t i = 0; i <= m_repetitions; ++i) {
+				setup();
+				auto start = std::chrono::steady_clock::now();
+				body();
+				auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+				if (i > 0) result.samples.push_back(elapsed / double(operations));
+			}
+
+			print(result);
+			m_results.push_back(std::move(result));
+		}
+
+		template<typename Body>
+		void run(std::string name, std::uint64_t operations, Body&& body) {
+			run(std::move(name), operations, [] {}, std::forward<Body>(body));
+		}
+
+		void skip(std::string name, std::string reason) {
+			if (!selected(name)) return;
+			std::cout << std::format("{:<40} skipped: {}\n", name, reason);
+			m_results.push_back({ std::move(name), 0, {}, std::move(reason) });
+		}
+
+		bool writeJson(const std::filesystem::path& path) const;
+
+	private:
+		std::size_t m_repetitions;
+		std::string m_filter;
+		std::vector<Result> m_results;
+
+		static void print(const Result& result);
+	};
+
+	struct Summary {
+		double median = 0.0;
+		double mean = 0.0;
+		double min = 0.0;
+		double max = 0.0;
+		double stddev = 0.0;
+	};
+
+	Summary summarize(std::vector<double> samples) {
+		Summary summary;
+		if (samples.empty()) return summary;
+
+		std::sort(samples.begin(), samples.end());
+		const std::size_t middle = samples.size() / 2;
+		summary.median = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+		summary.min = samples.front();
+		summary.max = samples.back();
+		for (double sample : samples) summary.mean += sample;
+		summary.mean /= double(samples.size());
+		for (double sample : samples) summary.stddev += (sample - summary.mean) * (sample - summary.mean);
+		summary.stddev = std::sqrt(summary.stddev / double(samples.size()));
+		return summary;
+	}
+
+	void Bench::print(const Result& result) {
+		const Summary summary = summarize(result.samples);
+		std::cout << std::format("{:<40} {:>12.2f} ns/op  (min {:.2f}, max {:.2f}, +-{:.1f}%)\n", result.name,
+			summary.median, summary.min, summary.max, summary.mean > 0.0 ? 100.0 * summary.stddev / summary.mean : 0.0);
+	}
+
+	std::string escapeJson(std::string_view text) {
+		std::string escaped;
+		escaped.reserve(text.size());
+		for (char c : text) {
+			switch (c) {
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) escaped += std::format("\\u{:04x}", static_cast<unsigned char>(c));
+				else escaped += c;
+			}
+		}
+		return escaped;
+	}
+
+	bool Bench::writeJson(const std::filesystem::path& path) const {
+		std::ofstream file(path);
+		if (!file) return false;
+
+#ifdef NDEBUG
+		constexpr std::string_view configuration = "release";
+#else
+		constexpr std::string_view configuration = "debug";
+#endif
+		const auto now = std::chrono::system_clock::now();
+		file << "{\n";
+		file << std::format("  \"timestamp\": \"{:%Y-%m-%dT%H:%M:%SZ}\",\n", std::chrono::floor<std::chrono::seconds>(now));
+		file << std::format("  \"configuration\": \"{}\",\n", configuration);
+		file << std::format("  \"repetitions\": {},\n", m_repetitions);
+		file << "  \"benchmarks\": [\n";
+		for (std::size_t i = 0; i < m_results.size(); ++i) {
+			const Result& result = m_results[i];
+			file << std::format("    {{\"name\": \"{}\"", escapeJson(result.name));
+			if (!result.skipped.empty()) {
+				file << std::format(", \"skipped\": \"{}\"}}", escapeJson(result.skipped));
+			}
+			else {
+				const Summary summary = summarize(result.samples);
+				file << std::format(", \"operations\": {}, \"ns_per_op\": {{\"median\": {:.3f}, \"mean\": {:.3f}, "
+					"\"min\": {:.3f}, \"max\": {:.3f}, \"stddev\": {:.3f}}}, \"ops_per_second\": {:.1f}}}",
+					result.operations, summary.median, summary.mean, summary.min, summary.max, summary.stddev,
+					summary.median > 0.0 ? 1e9 / summary.median : 0.0);
+			}
+			file << (i + 1 < m_results.size() ? ",\n" : "\n");
+		}
+		file << "  ]\n}\n";
+		return static_cast<bool>(file);
+	}
+
+	class BenchService : public Lunatic::Service {
+	public:
+		explicit BenchService(std::string_view name) : Service(name) {}
+		void update(float) override {}
+	};
+
+	// Children named Part0..PartN-1 under one parent
+	std::vector<std::shared_ptr<Lunatic::Instance>> makeChildren(std::size_t count) {
+		std::vector<std::shared_ptr<Lunatic::Instance>> children;
+		children.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			children.push_back(std::make_shared<Lunatic::Instance>(std::format("Part{}", i)));
+		}
+		return children;
+	}
+
+	void benchHierarchy(Bench& bench) {
+		for (std::size_t count : { 1000, 100000 }) {
+			std::shared_ptr<Lunatic::Instance> parent;
+			std::vector<std::shared_ptr<Lunatic::Instance>> children;
+			bench.run(std::format("hierarchy/addChild/{}", count), count,
+				[&] {
+					parent.reset();
+					children = makeChildren(count);
+					parent = std::make_shared<Lunatic::Instance>("Parent");
+					// Nobody listens here, so nothing should be queued, but it must not grow across samples
+					Lunatic::HierarchyEvents::Dispatch();
+				},
+				[&] {
+					for (const auto& child : children) parent->addChild(child);
+				});
+			parent.reset();
+			children.clear();
+			Lunatic::HierarchyEvents::Dispatch();
+		}
+
+		for (std::size_t count : { 100, 10000 }) {
+			auto parent = std::make_shared<Lunatic::Instance>("Parent");
+			for (const auto& child : makeChildren(count)) parent->addChild(child);
+			Lunatic::HierarchyEvents::Dispatch();
+
+			constexpr std::size_t LOOKUPS = 1000;
+			std::mt19937 random(42);
+			std::uniform_int_distribution<std::size_t> pick(0, count - 1);
+			std::vector<std::string> names;
+			for (std::size_t i = 0; i < LOOKUPS; ++i) names.push_back(std::format("Part{}", pick(random)));
+
+			bench.run(std::format("hierarchy/find/{}", count), LOOKUPS, [&] {
+				for (const std::string& name : names) keep(parent->find(name));
+			});
+			bench.run(std::format("hierarchy/findMiss/{}", count), LOOKUPS, [&] {
+				for (std::size_t i = 0; i < LOOKUPS; ++i) keep(parent->find("Missing"));
+			});
+		}
+		Lunatic::HierarchyEvents::Dispatch();
+	}
+
+	void benchServiceLocator(Bench& bench) {
+		// About as many as a real game registers
+		for (std::size_t i = 0; i < 16; ++i) {
+			Lunatic::ServiceLocator::Register(std::make_shared<BenchService>(std::format("BenchService{}", i)));
+		}
+
+		constexpr std::size_t LOOKUPS = 100000;
+		bench.run("services/ServiceLocator::Get", LOOKUPS, [&] {
+			for (std::size_t i = 0; i < LOOKUPS; ++i) keep(Lunatic::ServiceLocator::Get<BenchService>("BenchService7"));
+		});
+	}
+
+	void benchScripting(Bench& bench) {
+		for (std::size_t count : { 100, 1000, 10000 }) {
+			auto scripting = std::make_shared<Lunatic::Services::Scripting>();
+			scripting->setHotReloadEnabled(false);
+			for (std::size_t i = 0; i < count; ++i) {
+				scripting->loadScript(std::format("Waiter{}", i), "while true do wait(3600) end");
+			}
+			// The first update starts them, after that every one of them is waiting
+			scripting->update(1.0f / 60.0f);
+
+			constexpr std::size_t FRAMES = 60;
+			bench.run(std::format("scripting/update/{}waiting", count), FRAMES, [&] {
+				for (std::size_t frame = 0; frame < FRAMES; ++frame) scripting->update(1.0f / 60.0f);
+			});
+		}
+	}
+
+	void benchLogging(Bench& bench) {
+		constexpr std::size_t MESSAGES = 100000;
+
+		{
+			Lunatic::Services::ImGuiConsole console;
+			auto logger = std::make_shared<spdlog::logger>("bench", std::make_shared<Lunatic::Services::CustomSink>(&console));
+			logger->set_level(spdlog::level::trace);
+			bench.run("logging/consoleSink", MESSAGES, [&] {
+				for (std::size_t i = 0; i < MESSAGES; ++i) logger->info("Frame {} took {:.3f} ms", i, 16.6);
+			});
+		}
+
+		{
+			Lunatic::Services::ImGuiConsole console;
+			auto sink = std::make_shared<Lunatic::AsyncConsoleSink>([&console](spdlog::level::level_enum, std::string_view text) {
+				console.AddLog(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), text);
+				});
+			auto logger = std::make_shared<spdlog::logger>("bench", sink);
+			logger->set_level(spdlog::level::trace);
+			// Drained well before the ring fills, like Debug does once per frame
+			bench.run("logging/asyncConsoleSink", MESSAGES, [&] {
+				for (std::size_t i = 0; i < MESSAGES; ++i) {
+					logger->info("Frame {} took {:.3f} ms", i, 16.6);
+					if ((i & 1023) == 1023) sink->drain();
+				}
+				sink->drain();
+			});
+
+			// LUN_LOG queues the raw arguments, formatting moves into drain()
+			Lunatic::AsyncConsoleSink::SetActive(sink.get());
+			bench.run("logging/asyncConsoleSink/deferred", MESSAGES, [&] {
+				for (std::size_t i = 0; i < MESSAGES; ++i) {
+					LUN_INFO("Frame {} took {:.3f} ms", i, 16.6);
+					if ((i & 1023) == 1023) sink->drain();
+				}
+				sink->drain();
+			});
+			Lunatic::AsyncConsoleSink::SetActive(nullptr);
+		}
+
+		{
+			const std::filesystem::path path = std::filesystem::temp_directory_path() / "lunatic_bench.lbl";
+			std::unique_ptr<Lunatic::BinaryLog> capture;
+			bench.run("logging/binaryLog", MESSAGES,
+				[&] {
+					Lunatic::BinaryLog::SetActive(nullptr);
+					capture.reset();
+					capture = std::make_unique<Lunatic::BinaryLog>(path);
+					Lunatic::BinaryLog::SetActive(capture.get());
+				},
+				[&] {
+					for (std::size_t i = 0; i < MESSAGES; ++i) LUN_INFO("Frame {} took {:.3f} ms", i, 16.6);
+				});
+			Lunatic::BinaryLog::SetActive(nullptr);
+			capture.reset();
+			std::error_code error;
+			std::filesystem::remove(path, error);
+		}
+	}
+
+	void benchShader(Bench& bench) {
+		Lunatic::Shader shader;
+		shader.use();
+		const glm::mat4 model(1.0f);
+		const glm::vec3 color(1.0f, 0.5f, 0.25f);
+
+		constexpr std::size_t CALLS = 100000;
+		bench.run("shader/set/mat4", CALLS, [&] {
+			for (std::size_t i = 0; i < CALLS; ++i) shader.set("u_model", model);
+		});
+		bench.run("shader/set/vec3", CALLS, [&] {
+			for (std::size_t i = 0; i < CALLS; ++i) shader.set("u_color", color);
+		});
+		glFinish();
+	}
+
+	// Plain Instances draw nothing, so this is the Renderer's tree walk and RenderQueue setup
+	void benchRenderer(Bench& bench, Lunatic::Engine& engine) {
+		auto workspace = engine.getService<Lunatic::Services::Workspace>("Workspace");
+		auto renderer = engine.getService<Lunatic::Services::Renderer>("Renderer");
+
+		struct Shape {
+			std::string_view name;
+			std::size_t breadth;
+			std::size_t depth;
+		};
+		// breadth children per instance, depth levels below each root
+		const std::array<Shape, 4> shapes = { {
+			{ "empty", 0, 0 },
+			{ "flat10000", 10000, 1 },
+			{ "chain1000", 1, 1000 },
+			{ "fanout10x4", 10, 4 },
+		} };
+
+		for (const Shape& shape : shapes) {
+			workspace->clearAllChildren();
+			std::function<void(const std::shared_ptr<Lunatic::Instance>&, std::size_t)> grow;
+			grow = [&](const std::shared_ptr<Lunatic::Instance>& parent, std::size_t level) {
+				if (level == shape.depth) return;
+				for (std::size_t i = 0; i < shape.breadth; ++i) {
+					auto child = std::make_shared<Lunatic::Instance>(std::format("Part{}", i));
+					child->position = glm::vec3(0.1f, 0.0f, 0.0f);
+					child->rotation = glm::vec3(0.0f, 1.0f, 0.0f);
+					parent->addChild(child);
+					grow(child, level + 1);
+				}
+			};
+			grow(workspace, 0);
+			Lunatic::HierarchyEvents::Dispatch();
+
+			constexpr std::size_t FRAMES = 20;
+			bench.run(std::format("renderer/render/{}", shape.name), FRAMES, [&] {
+				for (std::size_t frame = 0; frame < FRAMES; ++frame) renderer->render();
+				glFinish();
+			});
+		}
+		workspace->clearAllChildren();
+		Lunatic::HierarchyEvents::Dispatch();
+	}
+}
+
+int main(int argc, char** argv) {
+	std::size_t repetitions = 10;
+	std::string filter;
+	std::filesystem::path output = "bench.json";
+	bool windowed = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--repetitions" && hasValue) repetitions = std::max<std::size_t>(std::stoull(argv[++i]), 1);
+		else if (arg == "--filter" && hasValue) filter = argv[++i];
+		else if (arg == "--out" && hasValue) output = argv[++i];
+		else if (arg == "--window") windowed = true;
+		else {
+			std::cerr << "Usage: LunaticBench [--repetitions N] [--filter substring] [--out bench.json] [--window]\n"
+				"  GL benchmarks run on a headless context unless --window is given\n";
+			return 1;
+		}
+	}
+
+	// Engine logging would only get in the way of the numbers
+	spdlog::set_level(spdlog::level::warn);
+
+	Bench bench(repetitions, filter);
+	benchHierarchy(bench);
+	benchServiceLocator(bench);
+	benchScripting(bench);
+	benchLogging(bench);
+
+	// Everything below needs a GL context
+	std::unique_ptr<Lunatic::Engine> engine;
+	try {
+		engine = std::make_unique<Lunatic::Engine>(256, 256, "LunaticBench",
+			Lunatic::EngineOptions{ .headless = !windowed, .vsync = false });
+	}
+	catch (const std::exception& e) {
+		const std::string reason = std::format("no GL context: {}", e.what());
+		for (std::string_view name : { "shader/set", "renderer/render" }) bench.skip(std::string(name), reason);
+	}
+
+	if (engine) {
+		engine->registerService<Lunatic::Services::Workspace>("Workspace");
+		engine->registerService<Lunatic::Services::MeshCache>("MeshCache");
+		engine->registerService<Lunatic::Services::Renderer>("Renderer");
+		benchShader(bench);
+		benchRenderer(bench, *engine);
+	}
+
+	if (!bench.writeJson(output)) {
+		std::cerr << "Could not write " << output.string() << '\n';
+		return 1;
+	}
+	std::cout << "Results written to " << output.string() << '\n';
+	return 0;
+}
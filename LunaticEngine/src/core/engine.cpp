@@ -4,35 +4,30 @@
 
 #include "hierarchy/services/renderer.h"
 #include "hierarchy/services/debug.h"
+#include "hierarchy/objects/cube.h"
+#include "hierarchy/objects/model.h"
 
 using namespace Lunatic;
 
 Engine* Lunatic::Engine::s_instance = nullptr;
-Engine::Engine(std::uint32_t width, std::uint32_t height, std::string_view title)
-	: m_windowSize(width, height), m_mousePos(0.0f, 0.0f) {
+Engine::Engine(std::uint32_t width, std::uint32_t height, std::string_view title, const EngineOptions& options)
+	: m_windowSize(width, height), m_mousePos(0.0f, 0.0f), m_options(options) {
 	
 	LUN_ASSERT(s_instance == nullptr, "Engine instance already exists, did you forget to destroy it?")
 	s_instance = this;
 
-	if (!glfwInit()) throw std::runtime_error("Failed to initialize GLFW");
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-#ifdef _DEBUG
-    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
-#endif
-
-	m_window = glfwCreateWindow(width, height, title.data(), nullptr, nullptr);
-	if (!m_window) throw std::runtime_error("Failed to create GLFW window");
+	createWindow(width, height, title);
 	glfwMakeContextCurrent(m_window);
-	glfwSwapInterval(1); // TODO: option for this
+	glfwSwapInterval(m_options.vsync && !m_options.headless ? 1 : 0);
 
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 		throw std::runtime_error("Failed to initialize GLAD");
 
+	if (m_options.headless) {
+		spdlog::info("[Engine] Headless on {} ({})", reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+			reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+	}
+
 	glfwSetWindowUserPointer(m_window, this);
 
 	// Set GLFW callbacks
@@ -82,6 +77,49 @@ Engine::Engine(std::uint32_t width, std::uint32_t height, std::string_view title
 
 	ImGui_ImplGlfw_InitForOpenGL(m_window, true);
 	ImGui_ImplOpenGL3_Init("#version 460");
+
+	// Built-in classes, scene files create their instances through the registry. Registered
+	// here rather than at static init in their own .cpp, the linker drops objects of the
+	// static library that nothing references and their registrars with them.
+	InstanceRegistry::Register<Instance>("Instance");
+	InstanceRegistry::Register<Cube>("Cube");
+	InstanceRegistry::Register<Model>("Model");
+}
+
+void Engine::createWindow(std::uint32_t width, std::uint32_t height, std::string_view title) {
+	if (m_options.headless) {
+#ifdef GLFW_PLATFORM_NULL
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+		throw std::runtime_error("Headless mode needs GLFW 3.4 or newer for its null platform");
+#endif
+	}
+
+	if (!glfwInit()) throw std::runtime_error("Failed to initialize GLFW");
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+#ifdef _DEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+
+	if (!m_options.headless) {
+		m_window = glfwCreateWindow(width, height, title.data(), nullptr, nullptr);
+		if (!m_window) throw std::runtime_error("Failed to create GLFW window");
+		return;
+	}
+
+	// Surfaceless EGL where the driver has it, OSMesa otherwise
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	for (int api : { GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API }) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+		m_window = glfwCreateWindow(width, height, title.data(), nullptr, nullptr);
+		if (m_window) return;
+	}
+	throw std::runtime_error("Failed to create a headless GL 4.6 context, neither EGL nor OSMesa worked");
 }
 
 void Engine::run() {
@@ -96,23 +134,66 @@ void Engine::run() {
 	renderer->resize(static_cast<int>(m_windowSize.x), static_cast<int>(m_windowSize.y));
 
 	while (!glfwWindowShouldClose(m_window)) {
+		auto frameStart = std::chrono::steady_clock::now();
+		FrameTimings timings;
+
 		glfwPollEvents();
 
+		if (m_frameCallback) {
+			m_frameCallback(m_frameCount);
+		}
+
 		ImGui_ImplOpenGL3_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
 
+		// Deliver last frame's hierarchy changes before anyone updates
+		HierarchyEvents::Dispatch();
+
 		// Call update and render on every single service
 		for (const auto& [name, service] : m_services) {
 			constexpr float fakeDt = 1.0f / 60.0f;
+			auto start = std::chrono::steady_clock::now();
 			service->update(fakeDt);
+			auto updated = std::chrono::steady_clock::now();
 			service->render();
+			timings.update += std::chrono::duration<double, std::milli>(updated - start).count();
+			timings.render += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updated).count();
 		}
 
+		auto renderStart = std::chrono::steady_clock::now();
 		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		// There is no window to draw the UI into when headless
+		if (!m_options.headless) {
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
+		auto presentStart = std::chrono::steady_clock::now();
+		timings.render += std::chrono::duration<double, std::milli>(presentStart - renderStart).count();
+
+		if (m_options.headless) {
+			// Frame times should include the GPU's work, as a swap with vsync off would
+			glFinish();
+		}
+		else {
+			glfwSwapBuffers(m_window);
+		}
+		timings.present = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - presentStart).count();
 
-		glfwSwapBuffers(m_window);
+		if (m_timeToFirstFrameMs < 0.0) {
+			m_timeToFirstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_createdAt).count();
+			spdlog::info("[Engine] Time to first frame: {:.1f} ms", m_timeToFirstFrameMs);
+		}
+
+		for (const auto& [name, service] : m_services) {
+			service->endFrame();
+		}
+
+		timings.total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+		m_lastFrameTimings = timings;
+		++m_frameCount;
+		if (m_options.frameLimit != 0 && m_frameCount >= m_options.frameLimit) {
+			glfwSetWindowShouldClose(m_window, true);
+		}
 	}
 
 	m_running = false;
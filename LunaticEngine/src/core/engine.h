@@ -11,9 +11,29 @@
 #include "render/shader.h"
 
 namespace Lunatic {
+	struct EngineOptions {
+		// No window: a surfaceless EGL context, or OSMesa, on GLFW's null platform, which runs on
+		// Mesa's llvmpipe without a GPU. The scene is only drawn into the Renderer's Framebuffer.
+		bool headless = false;
+		bool vsync = true;
+		// run() returns after this many frames, 0 runs until the window is closed
+		std::uint64_t frameLimit = 0;
+	};
+
 	class Engine {
 public:
-	Engine(std::uint32_t width, std::uint32_t height, std::string_view title);
+	// Milliseconds spent in each part of a frame, over all services
+	struct FrameTimings {
+		double update = 0.0;
+		double render = 0.0;  // Service::render, ImGui included
+		double present = 0.0; // swapping buffers, or waiting for the GPU to finish when headless
+		double total = 0.0;
+	};
+
+	// Called at the start of every frame before any service updates, with its index
+	using FrameCallback = std::function<void(std::uint64_t frame)>;
+
+	Engine(std::uint32_t width, std::uint32_t height, std::string_view title, const EngineOptions& options = {});
 	~Engine();
 
 	static Engine& GetInstance() {
@@ -24,6 +44,12 @@ public:
 	void run();
 	void stop();
 
+	void setFrameLimit(std::uint64_t frames) { m_options.frameLimit = frames; }
+	void setFrameCallback(FrameCallback callback) { m_frameCallback = std::move(callback); }
+	bool isHeadless() const { return m_options.headless; }
+	std::uint64_t getFrameCount() const { return m_frameCount; }
+	const FrameTimings& getLastFrameTimings() const { return m_lastFrameTimings; }
+
 	template <typename T, typename... Args>
 	void registerService(std::string_view name, Args&&... args) {
 		LUN_ASSERT(m_services.find(name.data()) == m_services.end(), "Service already registered")
@@ -67,12 +93,23 @@ public:
 	glm::vec2 getWindowSize() const { return m_windowSize; }
 	bool isWindowFocused() const { return m_windowFocused; }
 
+	// From construction until the first frame was presented, negative until then
+	double getTimeToFirstFrame() const { return m_timeToFirstFrameMs; }
+
 private:
 	// Entire engine is architected around services (e.g. workspace, lighting, environment, etc.)
 	std::unordered_map<std::string, std::shared_ptr<Service>> m_services;
 
 	GLFWwindow* m_window;
 	bool m_running = false;
+	EngineOptions m_options;
+
+	FrameCallback m_frameCallback;
+	std::uint64_t m_frameCount = 0;
+	FrameTimings m_lastFrameTimings;
+
+	std::chrono::steady_clock::time_point m_createdAt = std::chrono::steady_clock::now();
+	double m_timeToFirstFrameMs = -1.0;
 
 	glm::vec2 m_windowPos = { 0.0f, 0.0f };
 	glm::vec2 m_windowSize = { 800.0f, 600.0f };
@@ -116,6 +153,9 @@ private:
 	static void CB_Drop(GLFWwindow* window, int count, const char** paths);
 	static void CB_Error(int error, const char* description);
 
+	// Creates m_window, hidden and without a display when headless
+	void createWindow(std::uint32_t width, std::uint32_t height, std::string_view title);
+
 	Engine(const Engine&) = delete;
 	Engine& operator=(const Engine&) = delete;
 	Engine(Engine&&) = delete;
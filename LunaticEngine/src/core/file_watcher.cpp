@@ -0,0 +1,184 @@
+#include "pch.h"
+
+#include "file_watcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace Lunatic;
+
+#ifdef __linux__
+static constexpr std::uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+static constexpr int WAIT_TIMEOUT_MS = 50;
+#else
+static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(250);
+#endif
+
+FileWatcher::FileWatcher(Callback onChanged, std::chrono::milliseconds debounce)
+	: m_onChanged(std::move(onChanged)), m_debounce(debounce) {
+#ifdef __linux__
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0) {
+		spdlog::error("[FileWatcher] inotify_init1 failed: {}", std::strerror(errno));
+		return;
+	}
+#endif
+
+	m_worker = std::thread(&FileWatcher::workerLoop, this);
+}
+
+FileWatcher::~FileWatcher() {
+	m_stopRequested = true;
+	if (m_worker.joinable()) {
+		m_worker.join();
+	}
+
+#ifdef __linux__
+	if (m_inotify >= 0) {
+		close(m_inotify);
+	}
+#endif
+}
+
+std::filesystem::path FileWatcher::normalize(const std::filesystem::path& path) {
+	std::error_code ec;
+	auto normalized = std::filesystem::weakly_canonical(path, ec);
+	return ec ? path.lexically_normal() : normalized;
+}
+
+void FileWatcher::watch(const std::filesystem::path& path) {
+	auto file = normalize(path);
+	std::lock_guard lock(m_mutex);
+
+	auto& watched = m_files[file.string()];
+	if (watched.refCount++ > 0) return;
+
+#ifdef __linux__
+	if (m_inotify < 0) return;
+
+	// inotify watches the directory, saves that replace the file would orphan a file watch
+	auto dir = file.parent_path();
+	auto it = m_watchByDir.find(dir.string());
+	if (it == m_watchByDir.end()) {
+		int wd = inotify_add_watch(m_inotify, dir.c_str(), WATCH_MASK);
+		if (wd < 0) {
+			spdlog::warn("[FileWatcher] Cannot watch {}: {}", dir.string(), std::strerror(errno));
+			return;
+		}
+		it = m_watchByDir.emplace(dir.string(), wd).first;
+		m_dirByWatch[wd] = dir;
+	}
+	++m_filesPerWatch[it->second];
+#else
+	std::error_code ec;
+	watched.lastWrite = std::filesystem::last_write_time(file, ec);
+#endif
+}
+
+void FileWatcher::unwatch(const std::filesystem::path& path) {
+	auto file = normalize(path);
+	std::lock_guard lock(m_mutex);
+
+	auto it = m_files.find(file.string());
+	if (it == m_files.end()) return;
+	if (--it->second.refCount > 0) return;
+
+	m_files.erase(it);
+	m_pending.erase(file.string());
+
+#ifdef __linux__
+	auto dir = m_watchByDir.find(file.parent_path().string());
+	if (dir == m_watchByDir.end()) return;
+
+	int wd = dir->second;
+	if (--m_filesPerWatch[wd] == 0) {
+		inotify_rm_watch(m_inotify, wd);
+		m_filesPerWatch.erase(wd);
+		m_dirByWatch.erase(wd);
+		m_watchByDir.erase(dir);
+	}
+#endif
+}
+
+void FileWatcher::workerLoop() {
+	while (!m_stopRequested) {
+#ifdef __linux__
+		pollfd fd{ .fd = m_inotify, .events = POLLIN, .revents = 0 };
+		if (poll(&fd, 1, WAIT_TIMEOUT_MS) > 0 && (fd.revents & POLLIN)) {
+			readEvents();
+		}
+#else
+		std::this_thread::sleep_for(POLL_INTERVAL);
+		pollFiles();
+#endif
+		flushPending();
+	}
+}
+
+#ifdef __linux__
+void FileWatcher::readEvents() {
+	alignas(inotify_event) char buffer[4096];
+	auto now = Clock::now();
+
+	for (;;) {
+		ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+		if (length <= 0) break;
+
+		std::lock_guard lock(m_mutex);
+		for (char* ptr = buffer; ptr < buffer + length; ) {
+			auto* event = reinterpret_cast<inotify_event*>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+
+			if (event->len == 0) continue;
+
+			auto dir = m_dirByWatch.find(event->wd);
+			if (dir == m_dirByWatch.end()) continue;
+
+			std::string file = (dir->second / event->name).string();
+			if (m_files.contains(file)) {
+				m_pending[file] = now;
+			}
+		}
+	}
+}
+#else
+void FileWatcher::pollFiles() {
+	auto now = Clock::now();
+	std::lock_guard lock(m_mutex);
+
+	for (auto& [file, watched] : m_files) {
+		std::error_code ec;
+		auto lastWrite = std::filesystem::last_write_time(file, ec);
+		if (ec || lastWrite == watched.lastWrite) continue;
+
+		watched.lastWrite = lastWrite;
+		m_pending[file] = now;
+	}
+}
+#endif
+
+void FileWatcher::flushPending() {
+	std::vector<std::filesystem::path> ready;
+	{
+		auto now = Clock::now();
+		std::lock_guard lock(m_mutex);
+
+		// Editors often write a file in several steps, wait for it to settle
+		for (auto it = m_pending.begin(); it != m_pending.end(); ) {
+			if (now - it->second >= m_debounce) {
+				ready.emplace_back(it->first);
+				it = m_pending.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	for (const auto& file : ready) {
+		m_onChanged(file);
+	}
+}
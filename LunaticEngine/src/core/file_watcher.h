@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Watches individual files for modification on a background thread. On Linux this uses
+	/// inotify on the parent directories (so editors that save through a rename are caught),
+	/// elsewhere it falls back to polling modification times. Bursts of events for the same
+	/// file are debounced into a single callback, which runs on the watcher thread.
+	/// </summary>
+	class FileWatcher {
+	public:
+		using Callback = std::function<void(const std::filesystem::path& path)>;
+
+		explicit FileWatcher(Callback onChanged,
+			std::chrono::milliseconds debounce = std::chrono::milliseconds(100));
+		~FileWatcher();
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		// Watches are reference counted, every watch() needs a matching unwatch()
+		void watch(const std::filesystem::path& path);
+		void unwatch(const std::filesystem::path& path);
+
+		// Paths are compared in this form, callbacks receive it too
+		static std::filesystem::path normalize(const std::filesystem::path& path);
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct WatchedFile {
+			std::size_t refCount = 0;
+			std::filesystem::file_time_type lastWrite{}; // polling fallback only
+		};
+
+		Callback m_onChanged;
+		std::chrono::milliseconds m_debounce;
+
+		std::mutex m_mutex;
+		std::unordered_map<std::string, WatchedFile> m_files;
+		std::unordered_map<std::string, Clock::time_point> m_pending; // path -> last event
+
+		std::atomic<bool> m_stopRequested = false;
+		std::thread m_worker;
+
+#ifdef __linux__
+		int m_inotify = -1;
+		std::unordered_map<int, std::filesystem::path> m_dirByWatch;
+		std::unordered_map<std::string, int> m_watchByDir;
+		std::unordered_map<int, std::size_t> m_filesPerWatch;
+
+		void readEvents();
+#else
+		void pollFiles();
+#endif
+
+		void workerLoop();
+		void flushPending();
+	};
+} // namespace Lunatic
@@ -0,0 +1,134 @@
+#include "pch.h"
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Lunatic;
+
+MappedFile::MappedFile(const std::filesystem::path& path, Mode mode, std::size_t size) {
+	const bool writable = mode == Mode::ReadWrite;
+	LUN_ASSERT(!writable || size > 0, "Writable mappings need a size")
+
+#ifdef _WIN32
+	m_file = CreateFileW(path.c_str(),
+		writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+		// Delete sharing lets a file be renamed over while it is mapped somewhere else
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+		writable ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		m_file = nullptr;
+		throw std::runtime_error(std::format("Cannot open {}", path.string()));
+	}
+
+	if (!writable) {
+		LARGE_INTEGER fileSize{};
+		GetFileSizeEx(m_file, &fileSize);
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+	}
+
+	// Windows cannot map an empty file, leave it unmapped
+	if (size == 0) return;
+
+	// For writable files this also grows the file to the requested size
+	const auto size64 = static_cast<std::uint64_t>(size);
+	m_mapping = CreateFileMappingW(m_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+		static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), nullptr);
+	if (!m_mapping) {
+		close();
+		throw std::runtime_error(std::format("Cannot map {}", path.string()));
+	}
+
+	m_data = static_cast<std::byte*>(MapViewOfFile(m_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+#else
+	m_fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+	if (m_fd < 0) {
+		throw std::runtime_error(std::format("Cannot open {}: {}", path.string(), std::strerror(errno)));
+	}
+
+	if (writable) {
+		if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+			close();
+			throw std::runtime_error(std::format("Cannot resize {}: {}", path.string(), std::strerror(errno)));
+		}
+	}
+	else {
+		struct stat info {};
+		fstat(m_fd, &info);
+		size = static_cast<std::size_t>(info.st_size);
+	}
+
+	if (size == 0) return;
+
+	void* data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_fd, 0);
+	m_data = data == MAP_FAILED ? nullptr : static_cast<std::byte*>(data);
+#endif
+
+	if (!m_data) {
+		close();
+		throw std::runtime_error(std::format("Cannot map {}", path.string()));
+	}
+	m_size = size;
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+		m_file = std::exchange(other.m_file, nullptr);
+		m_mapping = std::exchange(other.m_mapping, nullptr);
+#else
+		m_fd = std::exchange(other.m_fd, -1);
+#endif
+	}
+	return *this;
+}
+
+void MappedFile::flush() {
+	if (!m_data) return;
+
+#ifdef _WIN32
+	FlushViewOfFile(m_data, m_size);
+#else
+	msync(m_data, m_size, MS_ASYNC);
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file) CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_data) munmap(m_data, m_size);
+	if (m_fd >= 0) ::close(m_fd);
+	m_fd = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
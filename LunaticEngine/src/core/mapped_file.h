@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Memory-mapped view of a whole file. Writable mappings create (or truncate) the file
+	/// at a fixed size up front, read-only mappings cover the file as it is on disk.
+	/// </summary>
+	class MappedFile {
+	public:
+		enum class Mode {
+			Read,
+			ReadWrite
+		};
+
+		MappedFile() = default;
+		// Throws std::runtime_error if the file cannot be opened or mapped
+		MappedFile(const std::filesystem::path& path, Mode mode, std::size_t size = 0);
+		~MappedFile();
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		std::byte* data() { return m_data; }
+		const std::byte* data() const { return m_data; }
+		std::size_t size() const { return m_size; }
+		bool isOpen() const { return m_data != nullptr; }
+
+		void flush();
+		void close();
+
+	private:
+		std::byte* m_data = nullptr;
+		std::size_t m_size = 0;
+
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_fd = -1;
+#endif
+	};
+} // namespace Lunatic
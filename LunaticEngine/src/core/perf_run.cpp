@@ -0,0 +1,179 @@
+#include "pch.h"
+
+#include "perf_run.h"
+
+#include "hierarchy/services/renderer.h"
+
+using namespace Lunatic;
+
+// Nearest rank, sorted has to be sorted
+static double percentile(const std::vector<double>& sorted, double fraction) {
+	if (sorted.empty()) return 0.0;
+	const auto rank = static_cast<std::size_t>(std::ceil(fraction * double(sorted.size())));
+	return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static PerfRun::Distribution distribution(const std::vector<Engine::FrameTimings>& timings, double Engine::FrameTimings::* field) {
+	PerfRun::Distribution result;
+	if (timings.empty()) return result;
+
+	std::vector<double> sorted;
+	sorted.reserve(timings.size());
+	for (const Engine::FrameTimings& frame : timings) {
+		sorted.push_back(frame.*field);
+		result.mean += frame.*field;
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	result.mean /= double(sorted.size());
+	result.p50 = percentile(sorted, 0.50);
+	result.p95 = percentile(sorted, 0.95);
+	result.p99 = percentile(sorted, 0.99);
+	result.max = sorted.back();
+	return result;
+}
+
+PerfRun::PerfRun(Engine& engine, Config config) : m_engine(engine), m_config(std::move(config)) {
+	LUN_ASSERT(m_config.frames > m_config.warmupFrames, "A perf run needs more frames than warmup frames")
+}
+
+PerfRun::Report PerfRun::run() {
+	auto renderer = ServiceLocator::Get<Services::Renderer>("Renderer");
+
+	std::vector<Engine::FrameTimings> timings;
+	std::vector<RenderQueue::Stats> stats;
+	timings.reserve(m_config.frames - m_config.warmupFrames);
+	stats.reserve(m_config.frames - m_config.warmupFrames);
+
+	const bool wantsCapture = !m_config.golden.empty() || !m_config.capture.empty();
+	const std::uint64_t captureFrame = m_config.frames - std::min(m_config.frames, CAPTURE_LEAD_FRAMES);
+	// Shared with the capture callback, which outlives run() if the readback never lands
+	auto captured = std::make_shared<std::optional<Image>>();
+
+	// Last frame's numbers are final once the next one starts
+	auto record = [&](std::uint64_t frame) {
+		if (frame < m_config.warmupFrames) return;
+		timings.push_back(m_engine.getLastFrameTimings());
+		stats.push_back(renderer->getQueue().getStats());
+	};
+
+	m_engine.setFrameLimit(m_config.frames);
+	m_engine.setFrameCallback([&](std::uint64_t frame) {
+		if (frame > 0) record(frame - 1);
+		m_config.cameraPath.apply(renderer->getCamera(), static_cast<float>(frame) * m_config.timeStep);
+
+		if (wantsCapture && frame == captureFrame) {
+			renderer->requestCapture([captured](const Framebuffer::Capture& capture) { *captured = Image::FromCapture(capture); });
+		}
+	});
+
+	m_engine.run();
+	record(m_config.frames - 1);
+	m_engine.setFrameCallback(nullptr);
+
+	if (wantsCapture && !*captured) {
+		// Only a few frames were left for the readback, wait for it now that timing is over
+		glFinish();
+		renderer->endFrame();
+	}
+
+	Report report;
+	report.frames = timings.size();
+	report.total = distribution(timings, &Engine::FrameTimings::total);
+	report.update = distribution(timings, &Engine::FrameTimings::update);
+	report.render = distribution(timings, &Engine::FrameTimings::render);
+	report.present = distribution(timings, &Engine::FrameTimings::present);
+	for (const RenderQueue::Stats& frame : stats) {
+		report.meanDraws += double(frame.draws);
+		report.meanMultiDraws += double(frame.multiDraws);
+	}
+	if (!stats.empty()) {
+		report.meanDraws /= double(stats.size());
+		report.meanMultiDraws /= double(stats.size());
+	}
+
+	if (!m_config.csv.empty()) {
+		writeCsv(timings, stats, report);
+	}
+
+	if (!wantsCapture) return report;
+	if (!*captured) {
+		spdlog::error("[PerfRun] The captured frame was never read back");
+		report.passed = false;
+		return report;
+	}
+
+	if (!m_config.capture.empty()) {
+		(*captured)->savePpm(m_config.capture);
+	}
+	if (m_config.golden.empty()) return report;
+
+	if (!std::filesystem::exists(m_config.golden)) {
+		(*captured)->savePpm(m_config.golden);
+		report.goldenWritten = true;
+		spdlog::info("[PerfRun] No golden image yet, wrote {}", m_config.golden.string());
+		return report;
+	}
+
+	report.difference = Image::Compare(Image::LoadPpm(m_config.golden), **captured, m_config.tolerance);
+	report.passed = !report.difference->sizeMismatch && report.difference->mismatchedFraction <= m_config.maxMismatchedFraction;
+	return report;
+}
+
+void PerfRun::writeCsv(const std::vector<Engine::FrameTimings>& timings, const std::vector<RenderQueue::Stats>& stats, const Report& report) const {
+	std::ofstream file(m_config.csv);
+	if (!file) {
+		spdlog::error("[PerfRun] Failed to open {} for the frame timings", m_config.csv.string());
+		return;
+	}
+
+	// Measured frames by their index in the run, every column stays numeric
+	file << "frame,update_ms,render_ms,present_ms,total_ms,draws\n";
+	for (std::size_t i = 0; i < timings.size(); ++i) {
+		file << std::format("{},{:.4f},{:.4f},{:.4f},{:.4f},{}\n", m_config.warmupFrames + i,
+			timings[i].update, timings[i].render, timings[i].present, timings[i].total, stats[i].draws);
+	}
+
+	// One row per statistic in a file of its own
+	const std::filesystem::path summaryPath = m_config.csv.parent_path()
+		/ (m_config.csv.stem().string() + "_summary" + m_config.csv.extension().string());
+	std::ofstream summary(summaryPath);
+	if (!summary) {
+		spdlog::error("[PerfRun] Failed to open {} for the timing summary", summaryPath.string());
+		return;
+	}
+
+	// Draw counts barely move, only their mean goes in the last column
+	summary << "statistic,update_ms,render_ms,present_ms,total_ms,draws\n";
+	auto row = [&](std::string_view name, double Distribution::* field) {
+		summary << std::format("{},{:.4f},{:.4f},{:.4f},{:.4f},", name, report.update.*field,
+			report.render.*field, report.present.*field, report.total.*field);
+		summary << (field == &Distribution::mean ? std::format("{:.1f}\n", report.meanDraws) : "\n");
+	};
+	row("mean", &Distribution::mean);
+	row("p50", &Distribution::p50);
+	row("p95", &Distribution::p95);
+	row("p99", &Distribution::p99);
+	row("max", &Distribution::max);
+}
+
+std::string PerfRun::Report::summary() const {
+	std::string text = std::format("{} frames: mean {:.3f} ms, p50 {:.3f}, p95 {:.3f}, p99 {:.3f}, max {:.3f} "
+		"(p95 update {:.3f}, render {:.3f}, present {:.3f}), {:.1f} draws in {:.1f} multi-draws",
+		frames, total.mean, total.p50, total.p95, total.p99, total.max, update.p95, render.p95, present.p95,
+		meanDraws, meanMultiDraws);
+
+	if (goldenWritten) {
+		text += ", golden image written";
+	}
+	else if (difference) {
+		if (difference->sizeMismatch) {
+			text += ", image size differs from the golden";
+		}
+		else {
+			text += std::format(", image {} ({} pixels off, {:.4f}%, max error {}, PSNR {:.2f} dB)", passed ? "matches" : "DIFFERS",
+				difference->mismatched, difference->mismatchedFraction * 100.0, difference->maxError, difference->psnr);
+		}
+	}
+	return text;
+}
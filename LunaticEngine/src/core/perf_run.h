@@ -0,0 +1,76 @@
+#pragma once
+
+#include "pch.h"
+
+#include "core/engine.h"
+#include "render/camera_path.h"
+#include "render/image.h"
+#include "render/render_queue.h"
+
+#include <optional>
+
+namespace Lunatic {
+	/// <summary>
+	/// Drives Engine::run for a fixed number of frames, optionally flying the Renderer's camera
+	/// along a CameraPath on fixed time steps, and collects frame times and RenderQueue draw
+	/// counts. These can be written out per frame as CSV, their percentiles go to a second file.
+	/// A frame near the end, CAPTURE_LEAD_FRAMES before it so the readback can land, can be
+	/// captured and compared against a golden image, which is written instead when it does
+	/// not exist yet.
+	/// Meant for headless runs on CI, where the same scene and path give the same image and
+	/// comparable numbers.
+	/// </summary>
+	class PerfRun {
+	public:
+		// The frame compared against the golden image is this many before the end
+		static constexpr std::uint64_t CAPTURE_LEAD_FRAMES = 4;
+
+		struct Config {
+			std::uint64_t frames = 600;
+			std::uint64_t warmupFrames = 60;  // run but left out of the report
+			float timeStep = 1.0f / 60.0f;    // camera path seconds per frame, whatever the frame took
+			CameraPath cameraPath;            // empty leaves the camera alone
+			std::filesystem::path golden;     // empty skips the image check
+			std::filesystem::path capture;    // where the captured frame is saved, empty for nowhere
+			std::filesystem::path csv;        // per-frame timings, empty for none. Percentiles go next to it in <stem>_summary.csv
+			std::uint8_t tolerance = 8;       // per channel
+			double maxMismatchedFraction = 0.001;
+		};
+
+		// Milliseconds over the measured frames
+		struct Distribution {
+			double mean = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		struct Report {
+			std::uint64_t frames = 0;  // measured ones, warmup excluded
+			Distribution total;
+			Distribution update;
+			Distribution render;
+			Distribution present;
+			double meanDraws = 0.0;
+			double meanMultiDraws = 0.0;
+
+			std::optional<Image::Difference> difference; // when compared against a golden image
+			bool goldenWritten = false;
+			bool passed = true;
+
+			std::string summary() const;
+		};
+
+		PerfRun(Engine& engine, Config config);
+
+		// Runs the engine to the end, it has to have its services registered
+		Report run();
+
+	private:
+		Engine& m_engine;
+		Config m_config;
+
+		void writeCsv(const std::vector<Engine::FrameTimings>& timings, const std::vector<RenderQueue::Stats>& stats, const Report& report) const;
+	};
+} // namespace Lunatic
@@ -0,0 +1,67 @@
+#include "pch.h"
+
+#include "thread_pool.h"
+
+using namespace Lunatic;
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+	if (threadCount == 0) {
+		unsigned int hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	m_workers.reserve(threadCount);
+	for (std::size_t i = 0; i < threadCount; ++i) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopRequested = true;
+		m_jobs.clear();
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::submit(Job job) {
+	{
+		std::lock_guard lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_wake.notify_one();
+}
+
+std::size_t ThreadPool::getPendingCount() const {
+	std::lock_guard lock(m_mutex);
+	return m_jobs.size() + m_running;
+}
+
+void ThreadPool::workerLoop() {
+	std::unique_lock lock(m_mutex);
+	for (;;) {
+		m_wake.wait(lock, [this] { return m_stopRequested || !m_jobs.empty(); });
+		if (m_stopRequested) return;
+
+		Job job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		++m_running;
+
+		lock.unlock();
+		try {
+			job();
+		}
+		catch (const std::exception& e) {
+			spdlog::error("[ThreadPool] Job threw: {}", e.what());
+		}
+		job = nullptr; // Whatever the job captured is released off the main thread too
+		lock.lock();
+
+		--m_running;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Fixed set of worker threads draining one FIFO job queue. Jobs must not touch the
+	/// hierarchy that is live on the main thread or call into OpenGL, hand results back
+	/// to the main thread instead.
+	/// </summary>
+	class ThreadPool {
+	public:
+		using Job = std::function<void()>;
+
+		// 0 threads = one less than the hardware has, but at least one
+		explicit ThreadPool(std::size_t threadCount = 0);
+		// Jobs that haven't started yet are dropped, running ones are waited for
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void submit(Job job);
+
+		std::size_t getThreadCount() const { return m_workers.size(); }
+		// Queued plus running
+		std::size_t getPendingCount() const;
+
+	private:
+		mutable std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::deque<Job> m_jobs;
+		std::size_t m_running = 0;
+		bool m_stopRequested = false;
+
+		std::vector<std::thread> m_workers;
+
+		void workerLoop();
+	};
+} // namespace Lunatic
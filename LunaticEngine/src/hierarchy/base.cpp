@@ -2,25 +2,86 @@
 
 #include "base.h"
 
+#include "core/utils.h"
+
 namespace Lunatic {
 
 	// ----- Instance ----- //
 
 	Instance::Instance(std::string_view name, std::string_view className)
-		: name(name), className(className) {}
+		: name(name), className(className), m_id(sm_nextId.fetch_add(1, std::memory_order_relaxed)) {}
+
+	Instance::~Instance() {
+		// A chain thousands deep would otherwise be freed through one nested destructor per
+		// level. Children nobody else holds on to give up their own children first.
+		std::vector<std::shared_ptr<Instance>> pending = std::move(children);
+		while (!pending.empty()) {
+			auto node = std::move(pending.back());
+			pending.pop_back();
+			if (node.use_count() != 1) continue;
 
-	Instance::~Instance() = default;
+			for (auto& child : node->children) {
+				pending.push_back(std::move(child));
+			}
+			node->children.clear();
+		}
+	}
+
+	static std::uint64_t idOf(const std::shared_ptr<Instance>& instance) {
+		return instance ? instance->getId() : 0;
+	}
+
+	// Removed events don't hold on to the instance, a detached subtree is freed right away
+	static void recordRemoved(const Instance& instance, std::uint64_t parentId) {
+		if (!HierarchyEvents::IsObserved(HierarchyEventType::Removed, instance.getClassName())) return;
+		HierarchyEvents::Record({ HierarchyEventType::Removed, instance.getId(), parentId, 0, nullptr, std::string(instance.getClassName()) });
+	}
+
+	void Instance::detachFromParent(Instance& currentParent) {
+		auto& siblings = currentParent.children;
+		std::size_t index = m_indexInParent;
+		LUN_ASSERT(index < siblings.size() && siblings[index].get() == this, "Child index out of sync, was children modified directly?")
+
+		// The caller holds a reference, the slot's one may be the last
+		if (currentParent.m_stableChildOrder) {
+			siblings.erase(siblings.begin() + static_cast<std::ptrdiff_t>(index));
+			for (std::size_t i = index; i < siblings.size(); ++i) {
+				siblings[i]->m_indexInParent = i;
+			}
+		}
+		else {
+			if (index + 1 != siblings.size()) {
+				siblings[index] = std::move(siblings.back());
+				siblings[index]->m_indexInParent = index;
+			}
+			siblings.pop_back();
+		}
+
+		parent.reset();
+	}
 
 	void Instance::setParent(std::shared_ptr<Instance> newParent) {
-		if (auto currentParent = parent.lock()) {
-			auto& siblings = currentParent->children;
-			siblings.erase(std::remove(siblings.begin(), siblings.end(), shared_from_this()), siblings.end());
+		auto currentParent = parent.lock();
+		if (currentParent == newParent) return;
+
+		auto self = shared_from_this();
+		if (currentParent) {
+			detachFromParent(*currentParent);
 		}
 
 		parent = newParent;
 		if (newParent) {
-			newParent->children.push_back(shared_from_this());
+			m_indexInParent = newParent->children.size();
+			newParent->children.push_back(self);
+		}
+
+		if (!newParent) {
+			recordRemoved(*this, idOf(currentParent));
+			return;
 		}
+
+		HierarchyEventType type = currentParent ? HierarchyEventType::Reparented : HierarchyEventType::Added;
+		HierarchyEvents::Record({ type, m_id, idOf(currentParent), idOf(newParent), self });
 	}
 
 	std::shared_ptr<Instance> Instance::getParent() const {
@@ -32,8 +93,42 @@ namespace Lunatic {
 	}
 
 	void Instance::removeChild(std::shared_ptr<Instance> child) {
-		children.erase(std::remove(children.begin(), children.end(), child), children.end());
-		child->parent.reset();
+		if (!child || child->parent.lock().get() != this) return;
+
+		child->detachFromParent(*this);
+		recordRemoved(*child, m_id);
+	}
+
+	void Instance::clearAllChildren() {
+		auto detached = std::move(children);
+		children.clear();
+
+		for (auto& child : detached) {
+			child->parent.reset();
+			recordRemoved(*child, m_id);
+		}
+	}
+
+	void Instance::destroy() {
+		auto self = shared_from_this();
+		if (auto currentParent = parent.lock()) {
+			detachFromParent(*currentParent);
+			recordRemoved(*this, currentParent->m_id);
+		}
+
+		// Deep trees would otherwise be freed through one nested destructor call per level
+		std::vector<std::shared_ptr<Instance>> stack{ std::move(self) };
+		while (!stack.empty()) {
+			auto node = std::move(stack.back());
+			stack.pop_back();
+
+			for (auto& child : node->children) {
+				child->parent.reset();
+				recordRemoved(*child, node->m_id);
+				stack.push_back(std::move(child));
+			}
+			node->children.clear();
+		}
 	}
 
 	std::shared_ptr<Instance> Instance::find(std::string_view name) {
@@ -55,35 +150,120 @@ namespace Lunatic {
 		return matches;
 	}
 
-	std::string_view Instance::getName() {
+	std::string_view Instance::getName() const {
 		return name;
 	}
 
 	void Instance::setName(std::string_view newName) {
 		name = newName;
+
+		auto currentParent = idOf(parent.lock());
+		HierarchyEvents::Record({ HierarchyEventType::Renamed, m_id, currentParent, currentParent, weak_from_this().lock() });
 	}
 
-	std::string_view Instance::getClassName() {
+	std::string_view Instance::getClassName() const {
 		return className;
 	}
 
+	void Instance::setPosition(const glm::vec3& newPosition) {
+		position = newPosition;
+		markTransformDirty();
+	}
+
+	void Instance::setRotation(const glm::vec3& newRotation) {
+		rotation = newRotation;
+		markTransformDirty();
+	}
+
+	void Instance::markTransformDirty() {
+		if (m_transformEventQueued || !HierarchyEvents::IsObserved(HierarchyEventType::TransformDirty, className)) return;
+
+		// Without an owner there is nothing a subscriber could look at yet
+		auto self = weak_from_this().lock();
+		if (!self) return;
+
+		m_transformEventQueued = true;
+		auto currentParent = idOf(parent.lock());
+		HierarchyEvents::Record({ HierarchyEventType::TransformDirty, m_id, currentParent, currentParent, std::move(self) });
+	}
+
 	// ----- InstanceRegistry ----- //
 
-	static std::unordered_map<std::string, InstanceRegistry::Factory>& getRegistry() {
-		static std::unordered_map<std::string, InstanceRegistry::Factory> registry;
+	namespace {
+		struct ClassInfo {
+			std::string name;
+			InstanceRegistry::Factory create = nullptr;
+			InstanceRegistry::BatchFactory createMany = nullptr;
+		};
+
+		struct Registry {
+			std::vector<ClassInfo> classes; // indexed by ClassId
+			Utils::unordered_string_map<InstanceRegistry::ClassId> ids;
+		};
+	}
+
+	static Registry& getRegistry() {
+		static Registry registry;
 		return registry;
 	}
 
-	void InstanceRegistry::Register(std::string_view name, Factory factory) {
-		getRegistry()[std::string(name)] = std::move(factory);
+	InstanceRegistry::ClassId InstanceRegistry::add(std::string_view name, Factory create, BatchFactory createMany) {
+		auto& registry = getRegistry();
+
+		auto it = registry.ids.find(name);
+		if (it == registry.ids.end()) {
+			it = registry.ids.emplace(std::string(name), static_cast<ClassId>(registry.classes.size())).first;
+			registry.classes.push_back(ClassInfo{ .name = std::string(name) });
+		}
+
+		auto& info = registry.classes[it->second];
+		info.create = create;
+		info.createMany = createMany;
+		return it->second;
+	}
+
+	InstanceRegistry::ClassId InstanceRegistry::Register(std::string_view name, Factory factory) {
+		return add(name, factory, nullptr);
+	}
+
+	InstanceRegistry::ClassId InstanceRegistry::GetClassId(std::string_view name) {
+		auto& ids = getRegistry().ids;
+		auto it = ids.find(name);
+		return it != ids.end() ? it->second : INVALID_CLASS;
+	}
+
+	std::string_view InstanceRegistry::GetClassName(ClassId id) {
+		auto& classes = getRegistry().classes;
+		return id < classes.size() ? std::string_view(classes[id].name) : std::string_view{};
+	}
+
+	std::size_t InstanceRegistry::GetClassCount() {
+		return getRegistry().classes.size();
+	}
+
+	std::shared_ptr<Instance> InstanceRegistry::Create(ClassId id) {
+		auto& classes = getRegistry().classes;
+		return id < classes.size() ? classes[id].create() : nullptr;
 	}
 
 	std::shared_ptr<Instance> InstanceRegistry::Create(std::string_view name) {
-		auto it = getRegistry().find(std::string(name));
-		if (it != getRegistry().end()) {
-			return it->second();
+		return Create(GetClassId(name));
+	}
+
+	void InstanceRegistry::CreateMany(ClassId id, std::size_t count, std::vector<std::shared_ptr<Instance>>& out) {
+		auto& classes = getRegistry().classes;
+		if (id >= classes.size()) return;
+
+		const auto& info = classes[id];
+		if (info.createMany) {
+			info.createMany(count, out);
+			return;
+		}
+
+		out.reserve(out.size() + count);
+		for (std::size_t i = 0; i < count; ++i) {
+			out.push_back(info.create());
 		}
-		return nullptr;
 	}
 
 	// ----- Service ----- //
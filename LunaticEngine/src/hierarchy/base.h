@@ -2,7 +2,12 @@
 
 #include "pch.h"
 
+#include "events.h"
+#include "instance_pool.h"
+
 namespace Lunatic {
+	class RenderQueue;
+
 	class Instance : public std::enable_shared_from_this<Instance> {
 	protected:
 		std::string name;
@@ -10,6 +15,7 @@ namespace Lunatic {
 
 	public:
 		std::weak_ptr<Instance> parent;
+		// Read-only outside of Instance, every child knows its own index in here
 		std::vector<std::shared_ptr<Instance>> children;
 
 		explicit Instance(std::string_view name = "", std::string_view className = "Instance");
@@ -20,27 +26,117 @@ namespace Lunatic {
 
 		void addChild(std::shared_ptr<Instance> child);
 		void removeChild(std::shared_ptr<Instance> child);
+
+		// Detaches every child at once, their own subtrees are left intact
+		void clearAllChildren();
+		// Detaches this instance and takes its whole subtree apart, without recursion
+		void destroy();
+
+		// Children are detached by swapping the last one into the hole, which is O(1) but
+		// reorders them. Stable mode keeps insertion order at O(n) per removal.
+		void setStableChildOrder(bool stable) { m_stableChildOrder = stable; }
+		bool hasStableChildOrder() const { return m_stableChildOrder; }
 		std::shared_ptr<Instance> find(std::string_view name);
 		std::vector<std::shared_ptr<Instance>> findAll(std::string_view name);
 
-		std::string_view getName();
+		std::string_view getName() const;
 		void setName(std::string_view name);
 
-		std::string_view getClassName();
+		std::string_view getClassName() const;
 
-		virtual void render() { /* No-op by default */ }
+		// Unique for the lifetime of the process, safe to keep after the instance is gone
+		std::uint64_t getId() const { return m_id; }
+
+		// Writing position/rotation directly is fine, but call markTransformDirty() afterwards
+		// so HierarchyEvents subscribers hear about it
+		void setPosition(const glm::vec3& newPosition);
+		void setRotation(const glm::vec3& newRotation);
+		void markTransformDirty();
+
+		// The file an instance draws from, saved with scenes. Empty for instances without one.
+		virtual std::string getAssetPath() const { return {}; }
+		virtual void setAssetPath(std::string_view path) { /* Nothing to load by default */ }
+		// Pushes this instance's draws, model is its world transform. The Renderer calls it
+		// for every instance in the Workspace each frame.
+		virtual void enqueue(RenderQueue& queue, const glm::mat4& model) { /* Nothing to draw by default */ }
 
 	public:
 		glm::vec3 position{ 0.0f, 0.0f, 0.0f };
 		glm::vec3 rotation{ 0.0f, 0.0f, 0.0f };
+
+	private:
+		friend class HierarchyEvents;
+		friend class Scene;
+
+		std::uint64_t m_id;
+		std::size_t m_indexInParent = 0;
+		bool m_stableChildOrder = false;
+		bool m_transformEventQueued = false;
+
+		void detachFromParent(Instance& currentParent);
+
+		static inline std::atomic<std::uint64_t> sm_nextId = 1;
 	};
 
+	/// <summary>
+	/// Creates instances by class. Every registered class gets a dense ClassId, resolve the
+	/// name once and create by id afterwards. Classes registered through Register<T> (or
+	/// LUN_REGISTER_INSTANCE) are allocated from an InstancePool, CreateMany carves a whole
+	/// batch out of one contiguous region. Register at static init or startup, before any
+	/// other thread creates instances.
+	/// </summary>
 	class InstanceRegistry {
 	public:
-		using Factory = std::function<std::shared_ptr<Instance>()>;
+		using ClassId = std::uint32_t;
+		using Factory = std::shared_ptr<Instance>(*)();
+		using BatchFactory = void(*)(std::size_t count, std::vector<std::shared_ptr<Instance>>& out);
+
+		static constexpr ClassId INVALID_CLASS = 0xFFFFFFFF;
+
+		// Pooled construction, T has to be default constructible. Registering a name again
+		// replaces the factories and keeps the id.
+		template<typename T>
+		static ClassId Register(std::string_view name) {
+			static_assert(std::is_base_of_v<Instance, T>);
+			ClassId id = add(name, &createPooled<T>, &createManyPooled<T>);
+			sm_classIdOf<T> = id;
+			return id;
+		}
+		// For classes that need a custom factory, CreateMany calls it once per instance
+		static ClassId Register(std::string_view name, Factory factory);
 
-		static void Register(std::string_view name, Factory factory);
+		// INVALID_CLASS if the name isn't registered
+		static ClassId GetClassId(std::string_view name);
+		template<typename T>
+		static ClassId GetClassId() { return sm_classIdOf<T>; }
+		static std::string_view GetClassName(ClassId id);
+		static std::size_t GetClassCount();
+
+		// Null if the class isn't registered
+		static std::shared_ptr<Instance> Create(ClassId id);
 		static std::shared_ptr<Instance> Create(std::string_view name);
+		// Appends count new instances of the class to out
+		static void CreateMany(ClassId id, std::size_t count, std::vector<std::shared_ptr<Instance>>& out);
+
+	private:
+		template<typename T>
+		static inline ClassId sm_classIdOf = INVALID_CLASS;
+
+		static ClassId add(std::string_view name, Factory create, BatchFactory createMany);
+
+		template<typename T>
+		static std::shared_ptr<Instance> createPooled() {
+			return std::allocate_shared<T>(InstanceAllocator<T>{});
+		}
+
+		template<typename T>
+		static void createManyPooled(std::size_t count, std::vector<std::shared_ptr<Instance>>& out) {
+			out.reserve(out.size() + count);
+			InstancePool::BatchScope batch(count);
+			for (std::size_t i = 0; i < count; ++i) {
+				out.push_back(std::allocate_shared<T>(InstanceAllocator<T>{}));
+			}
+		}
 	};
 
 	class Service : public Instance {
@@ -48,6 +144,10 @@ namespace Lunatic {
 		using Ptr = std::shared_ptr<Service>;
 		explicit Service(std::string_view name);
 		virtual void update(float deltaTime) = 0;
+		virtual void render() { /* No-op by default */ }
+
+		// Called once per frame after the buffers have been swapped, for deferrable work
+		virtual void endFrame() { /* No-op by default */ }
 	};
 
 	class ServiceLocator {
@@ -73,3 +173,10 @@ namespace Lunatic {
 		}
 	};
 } // namespace Lunatic
+
+// Registers a default constructible Instance subclass under its own name during static init.
+// Put it in the class' .cpp, at namespace scope. Only for code linked into the executable
+// directly, LunaticEngine's own classes are registered by Engine.
+#define LUN_REGISTER_INSTANCE(Type) \
+	static const ::Lunatic::InstanceRegistry::ClassId lunRegistered##Type##_ = \
+		::Lunatic::InstanceRegistry::Register<Type>(#Type)
@@ -0,0 +1,146 @@
+#include "pch.h"
+
+#include "events.h"
+#include "base.h"
+
+namespace Lunatic {
+	struct Subscription {
+		HierarchyEvents::SubscriptionId id;
+		HierarchyEvents::Callback callback;
+		std::uint32_t typeMask;
+		std::string className;
+		bool active = true; // cleared by Unsubscribe during a dispatch, swept afterwards
+	};
+
+	struct EventBus {
+		std::vector<HierarchyEvent> pending;
+		std::vector<HierarchyEvent> dispatching;
+		std::vector<HierarchyEvent> filtered;
+		std::vector<Subscription> subscriptions;
+		std::vector<Subscription> added; // subscribed during a dispatch, joins after it
+		HierarchyEvents::SubscriptionId nextId = 1;
+		bool inDispatch = false;
+
+		// What Record checks before queueing, kept up to date with the subscriptions
+		std::uint32_t anyClassMask = 0; // types some subscription wants for every class
+		bool classFilters = false;      // some subscription only wants one class
+	};
+
+	static EventBus& getBus() {
+		static EventBus bus;
+		return bus;
+	}
+
+	static std::string_view classOf(const HierarchyEvent& event) {
+		return event.instance ? event.instance->getClassName() : std::string_view(event.className);
+	}
+
+	static void updateObserved(EventBus& bus) {
+		bus.anyClassMask = 0;
+		bus.classFilters = false;
+
+		// Subscriptions made during a dispatch receive the batch recorded meanwhile
+		auto add = [&bus](const Subscription& sub) {
+			if (!sub.active) return;
+			if (sub.className.empty()) bus.anyClassMask |= sub.typeMask;
+			else bus.classFilters = true;
+			};
+		std::ranges::for_each(bus.subscriptions, add);
+		std::ranges::for_each(bus.added, add);
+	}
+
+	HierarchyEvents::SubscriptionId HierarchyEvents::Subscribe(Callback callback, std::uint32_t typeMask, std::string_view className) {
+		auto& bus = getBus();
+		SubscriptionId id = bus.nextId++;
+
+		// Growing subscriptions would move the callback that is running right now
+		auto& target = bus.inDispatch ? bus.added : bus.subscriptions;
+		target.push_back(Subscription{ id, std::move(callback), typeMask, std::string(className) });
+		updateObserved(bus);
+		return id;
+	}
+
+	void HierarchyEvents::Unsubscribe(SubscriptionId id) {
+		auto& bus = getBus();
+		auto matches = [id](const Subscription& sub) { return sub.id == id; };
+		std::erase_if(bus.added, matches);
+
+		if (!bus.inDispatch) {
+			std::erase_if(bus.subscriptions, matches);
+		}
+		else if (auto it = std::ranges::find_if(bus.subscriptions, matches); it != bus.subscriptions.end()) {
+			it->active = false;
+		}
+		updateObserved(bus);
+	}
+
+	bool HierarchyEvents::IsObserved(HierarchyEventType type, std::string_view className) {
+		const auto& bus = getBus();
+		const std::uint32_t bit = hierarchyEventBit(type);
+		if (bus.anyClassMask & bit) return true;
+		if (!bus.classFilters) return false;
+
+		auto wants = [&](const Subscription& sub) {
+			return sub.active && (sub.typeMask & bit) && sub.className == className;
+			};
+		return std::ranges::any_of(bus.subscriptions, wants) || std::ranges::any_of(bus.added, wants);
+	}
+
+	void HierarchyEvents::Record(HierarchyEvent event) {
+		if (!IsObserved(event.type, classOf(event))) return;
+		getBus().pending.push_back(std::move(event));
+	}
+
+	std::size_t HierarchyEvents::GetPendingCount() {
+		return getBus().pending.size();
+	}
+
+	void HierarchyEvents::Dispatch() {
+		auto& bus = getBus();
+		if (bus.pending.empty()) return;
+		LUN_ASSERT(!bus.inDispatch, "HierarchyEvents::Dispatch called from a subscriber")
+
+		std::swap(bus.pending, bus.dispatching);
+
+		// Transform changes can be queued again from here on
+		for (const auto& event : bus.dispatching) {
+			if (event.type == HierarchyEventType::TransformDirty && event.instance) {
+				event.instance->m_transformEventQueued = false;
+			}
+		}
+
+		// Subscribers may subscribe or unsubscribe while being called, both are applied once
+		// everyone got the batch
+		bus.inDispatch = true;
+		for (std::size_t i = 0; i < bus.subscriptions.size(); ++i) {
+			const Subscription& sub = bus.subscriptions[i];
+			if (!sub.active) continue;
+
+			if (sub.typeMask == ALL_EVENTS && sub.className.empty()) {
+				sub.callback(bus.dispatching);
+				continue;
+			}
+
+			bus.filtered.clear();
+			for (const auto& event : bus.dispatching) {
+				if (!(sub.typeMask & hierarchyEventBit(event.type))) continue;
+				if (!sub.className.empty() && classOf(event) != sub.className) continue;
+				bus.filtered.push_back(event);
+			}
+
+			if (!bus.filtered.empty()) {
+				sub.callback(bus.filtered);
+			}
+		}
+
+		bus.inDispatch = false;
+		std::erase_if(bus.subscriptions, [](const Subscription& sub) { return !sub.active; });
+		std::ranges::move(bus.added, std::back_inserter(bus.subscriptions));
+		bus.added.clear();
+		updateObserved(bus);
+
+		// Drop the references now instead of holding removed instances for another frame
+		bus.filtered.clear();
+		bus.dispatching.clear();
+	}
+} // namespace Lunatic
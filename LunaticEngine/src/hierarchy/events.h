@@ -0,0 +1,57 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Lunatic {
+	class Instance;
+
+	enum class HierarchyEventType : std::uint8_t {
+		Added,          // Parented into the tree from nowhere
+		Removed,        // Detached from its parent
+		Reparented,
+		Renamed,
+		TransformDirty  // Position or rotation changed, at most once per instance per batch
+	};
+
+	constexpr std::uint32_t hierarchyEventBit(HierarchyEventType type) {
+		return 1u << static_cast<std::uint32_t>(type);
+	}
+
+	struct HierarchyEvent {
+		HierarchyEventType type;
+		std::uint64_t instanceId = 0;
+		std::uint64_t oldParentId = 0; // 0 = no parent
+		std::uint64_t newParentId = 0;
+		std::shared_ptr<Instance> instance; // Kept alive until the batch has been dispatched, null for Removed
+		std::string className;              // Removed only, so detached subtrees aren't kept alive
+	};
+
+	/// <summary>
+	/// Hierarchy change bus. Instance records changes into a contiguous per-frame buffer,
+	/// Engine dispatches the batch once per frame so systems can process deltas instead of
+	/// rescanning the tree. Events no subscription wants are not recorded at all.
+	/// Main thread only, like the hierarchy itself.
+	/// </summary>
+	class HierarchyEvents {
+	public:
+		using Callback = std::function<void(std::span<const HierarchyEvent> events)>;
+		using SubscriptionId = std::uint32_t;
+
+		static constexpr std::uint32_t ALL_EVENTS = 0xFFFFFFFF;
+		static constexpr std::uint32_t STRUCTURE_EVENTS =
+			hierarchyEventBit(HierarchyEventType::Added) | hierarchyEventBit(HierarchyEventType::Removed) |
+			hierarchyEventBit(HierarchyEventType::Reparented) | hierarchyEventBit(HierarchyEventType::Renamed);
+
+		// typeMask is a combination of hierarchyEventBit(), an empty className receives events for every class
+		static SubscriptionId Subscribe(Callback callback, std::uint32_t typeMask = ALL_EVENTS, std::string_view className = "");
+		static void Unsubscribe(SubscriptionId id);
+
+		// Whether any subscription would receive an event of this type and class
+		static bool IsObserved(HierarchyEventType type, std::string_view className);
+		static void Record(HierarchyEvent event);
+		// Changes made by subscribers during dispatch go into the next batch
+		static void Dispatch();
+
+		static std::size_t GetPendingCount();
+	};
+} // namespace Lunatic
@@ -0,0 +1,92 @@
+#include "pch.h"
+
+#include "instance_pool.h"
+
+using namespace Lunatic;
+
+// The batch this thread is allocating, see BatchScope. It belongs to the first pool used in it.
+static thread_local std::size_t t_batchSlots = 0;
+static thread_local InstancePool* t_batchPool = nullptr;
+
+InstancePool& InstancePool::ForSize(std::size_t size, std::size_t alignment) {
+	LUN_ASSERT(alignment <= SLOT_ALIGNMENT, "Over-aligned types can't be pooled")
+
+	static std::mutex mutex;
+	static auto* pools = new std::unordered_map<std::size_t, InstancePool*>(); // Leaked on purpose, see the class comment
+
+	std::size_t slotSize = (std::max(size, sizeof(FreeSlot)) + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+
+	std::lock_guard lock(mutex);
+	auto& pool = (*pools)[slotSize];
+	if (!pool) pool = new InstancePool(slotSize);
+	return *pool;
+}
+
+InstancePool::InstancePool(std::size_t slotSize)
+	: m_slotSize(slotSize) {}
+
+InstancePool::BatchScope::BatchScope(std::size_t count)
+	: m_previousSlots(std::exchange(t_batchSlots, count)), m_previousPool(std::exchange(t_batchPool, nullptr)) {}
+
+InstancePool::BatchScope::~BatchScope() {
+	t_batchSlots = m_previousSlots;
+	t_batchPool = m_previousPool;
+}
+
+void InstancePool::grow(std::size_t slots) {
+	// What is left of the old bump region would be lost otherwise
+	for (; m_cursor && m_cursor + m_slotSize <= m_end; m_cursor += m_slotSize) {
+		m_freeList = new (m_cursor) FreeSlot{ m_freeList };
+	}
+
+	slots = std::max(slots, CHUNK_SLOTS);
+	m_cursor = static_cast<std::byte*>(::operator new(slots * m_slotSize));
+	m_end = m_cursor + slots * m_slotSize;
+	m_reserved += slots;
+}
+
+void* InstancePool::allocate() {
+	std::lock_guard lock(m_mutex);
+	++m_live;
+
+	// A batch is served from the bump region so its slots end up next to each other
+	bool batched = t_batchSlots > 0 && (!t_batchPool || t_batchPool == this);
+	if (batched) {
+		if (!t_batchPool) {
+			t_batchPool = this;
+			if (static_cast<std::size_t>(m_end - m_cursor) < t_batchSlots * m_slotSize) {
+				grow(t_batchSlots);
+			}
+		}
+		--t_batchSlots;
+	}
+	else if (m_freeList) {
+		FreeSlot* slot = m_freeList;
+		m_freeList = slot->next;
+		return slot;
+	}
+
+	if (m_cursor == m_end) {
+		grow(CHUNK_SLOTS);
+	}
+
+	void* slot = m_cursor;
+	m_cursor += m_slotSize;
+	return slot;
+}
+
+void InstancePool::deallocate(void* slot) {
+	std::lock_guard lock(m_mutex);
+	--m_live;
+	m_freeList = new (slot) FreeSlot{ m_freeList };
+}
+
+std::size_t InstancePool::getLiveCount() const {
+	std::lock_guard lock(m_mutex);
+	return m_live;
+}
+
+std::size_t InstancePool::getReservedCount() const {
+	std::lock_guard lock(m_mutex);
+	return m_reserved;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Fixed-size slots carved from large chunks, one pool per slot size. Together with
+	/// InstanceAllocator, std::allocate_shared puts an instance and its control block in one
+	/// slot, so instances keep normal shared_ptr ownership (shared_from_this included) while
+	/// creating one costs a free-list pop instead of a heap allocation. Thread-safe, scene
+	/// loaders create instances off the main thread. Pools are never destroyed, instances held
+	/// by statics may outlive any other destruction order.
+	/// </summary>
+	class InstancePool {
+	public:
+		// Every type whose slot rounds up to the same size shares a pool
+		static InstancePool& ForSize(std::size_t size, std::size_t alignment);
+
+		void* allocate();
+		void deallocate(void* slot);
+
+		// While alive, the first pool this thread allocates from makes room for count slots
+		// in one go, so a batch ends up contiguous instead of spread over the free list
+		class BatchScope {
+		public:
+			explicit BatchScope(std::size_t count);
+			~BatchScope();
+
+			BatchScope(const BatchScope&) = delete;
+			BatchScope& operator=(const BatchScope&) = delete;
+
+		private:
+			std::size_t m_previousSlots;
+			InstancePool* m_previousPool;
+		};
+
+		std::size_t getSlotSize() const { return m_slotSize; }
+		std::size_t getLiveCount() const;
+		std::size_t getReservedCount() const;
+
+	private:
+		struct FreeSlot {
+			FreeSlot* next;
+		};
+
+		static constexpr std::size_t SLOT_ALIGNMENT = alignof(std::max_align_t);
+		static constexpr std::size_t CHUNK_SLOTS = 256;
+
+		explicit InstancePool(std::size_t slotSize);
+
+		mutable std::mutex m_mutex;
+		std::size_t m_slotSize;
+		FreeSlot* m_freeList = nullptr;
+		std::byte* m_cursor = nullptr; // bump region in the newest chunk
+		std::byte* m_end = nullptr;
+		std::size_t m_live = 0;
+		std::size_t m_reserved = 0;
+
+		void grow(std::size_t slots);
+	};
+
+	// Allocator for std::allocate_shared, single objects come from InstancePool
+	template<typename T>
+	class InstanceAllocator {
+	public:
+		using value_type = T;
+
+		InstanceAllocator() noexcept = default;
+		template<typename U>
+		InstanceAllocator(const InstanceAllocator<U>&) noexcept {}
+
+		T* allocate(std::size_t n) {
+			if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+			return static_cast<T*>(pool().allocate());
+		}
+
+		void deallocate(T* ptr, std::size_t n) noexcept {
+			if (n != 1) ::operator delete(ptr);
+			else pool().deallocate(ptr);
+		}
+
+		template<typename U>
+		bool operator==(const InstanceAllocator<U>&) const noexcept { return true; }
+
+	private:
+		static InstancePool& pool() {
+			static InstancePool& instance = InstancePool::ForSize(sizeof(T), alignof(T));
+			return instance;
+		}
+	};
+} // namespace Lunatic
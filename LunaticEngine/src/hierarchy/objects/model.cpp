@@ -0,0 +1,26 @@
+#include "pch.h"
+
+#include "model.h"
+
+#include "render/render_queue.h"
+
+using namespace Lunatic;
+
+Model::Model(std::string_view name) : Instance(name, "Model") {}
+
+void Model::setSource(const std::filesystem::path& source) {
+	if (source == m_source) return;
+
+	m_source = source;
+	m_mesh.reset();
+}
+
+void Model::enqueue(RenderQueue& queue, const glm::mat4& model) {
+	if (m_source.empty()) return;
+
+	static auto meshCache = ServiceLocator::Get<Services::MeshCache>("MeshCache");
+	if (!m_mesh) {
+		m_mesh = meshCache->load(m_source);
+	}
+	queue.push(m_mesh, model);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "pch.h"
+
+#include "hierarchy/base.h"
+#include "hierarchy/services/mesh_cache.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Draws a mesh file, imported and cooked by the MeshCache in the background.
+	/// Draws nothing until the mesh arrived.
+	/// </summary>
+	class Model : public Instance {
+	public:
+		Model(std::string_view name = "");
+		~Model() override = default;
+
+		void enqueue(RenderQueue& queue, const glm::mat4& model) override;
+
+		void setSource(const std::filesystem::path& source);
+		const std::filesystem::path& getSource() const { return m_source; }
+
+		std::string getAssetPath() const override { return m_source.generic_string(); }
+		void setAssetPath(std::string_view path) override { setSource(std::filesystem::path(path)); }
+
+	private:
+		std::filesystem::path m_source;
+		MeshHandle m_mesh; // requested on first render, models may be constructed on a loader thread
+	};
+} // namespace Lunatic
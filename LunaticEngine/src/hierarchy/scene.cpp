@@ -0,0 +1,537 @@
+#include "pch.h"
+
+#include "scene.h"
+
+#include "core/mapped_file.h"
+
+#include <charconv>
+
+using namespace Lunatic;
+
+namespace {
+	// The flattened tree, what Save writes and what the text loader parses into
+	struct SceneData {
+		std::vector<std::string_view> strings;
+		std::deque<std::string> storage; // backs strings when they don't live in instances
+		std::vector<std::uint32_t> classNames;
+		std::vector<std::uint32_t> classes;
+		std::vector<std::uint32_t> names;
+		std::vector<std::uint32_t> parents;
+		std::vector<std::uint32_t> assets;
+		std::array<std::vector<float>, 6> transforms;
+	};
+}
+
+namespace Lunatic {
+	// What instances are built from, either SceneData or the arrays of a mapped file
+	struct SceneView {
+		std::vector<std::string_view> strings;
+		std::span<const std::uint32_t> classNames;
+		std::span<const std::uint32_t> classes;
+		std::span<const std::uint32_t> names;
+		std::span<const std::uint32_t> parents;
+		std::span<const std::uint32_t> assets; // empty for version 1 files
+		std::array<std::span<const float>, 6> transforms;
+	};
+}
+
+static SceneView viewOf(const SceneData& data) {
+	SceneView view{ data.strings, data.classNames, data.classes, data.names, data.parents, data.assets };
+	for (std::size_t i = 0; i < 6; ++i) {
+		view.transforms[i] = data.transforms[i];
+	}
+	return view;
+}
+
+static std::uint64_t alignTo8(std::uint64_t offset) {
+	return (offset + 7) & ~std::uint64_t(7);
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ----- Saving ----- //
+
+static SceneData flatten(std::span<const std::shared_ptr<Instance>> roots) {
+	SceneData data;
+	std::unordered_map<std::string_view, std::uint32_t> stringIds;
+	std::unordered_map<std::uint32_t, std::uint32_t> classIds; // class name string -> class index
+
+	auto intern = [&](std::string_view text) {
+		auto [it, inserted] = stringIds.try_emplace(text, static_cast<std::uint32_t>(data.strings.size()));
+		if (inserted) data.strings.push_back(text);
+		return it->second;
+		};
+
+	// Depth-first so every parent is written before its children
+	std::vector<std::pair<const Instance*, std::uint32_t>> stack;
+	for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+		stack.emplace_back(it->get(), Scene::NO_PARENT);
+	}
+
+	while (!stack.empty()) {
+		auto [node, parentIndex] = stack.back();
+		stack.pop_back();
+
+		auto [classIt, newClass] = classIds.try_emplace(intern(node->getClassName()), static_cast<std::uint32_t>(data.classNames.size()));
+		if (newClass) data.classNames.push_back(classIt->first);
+
+		auto index = static_cast<std::uint32_t>(data.classes.size());
+		data.classes.push_back(classIt->second);
+		data.names.push_back(intern(node->getName()));
+		data.parents.push_back(parentIndex);
+
+		std::string asset = node->getAssetPath();
+		if (asset.empty()) {
+			data.assets.push_back(Scene::NO_ASSET);
+		}
+		else {
+			data.assets.push_back(intern(data.storage.emplace_back(std::move(asset))));
+		}
+
+		for (int axis = 0; axis < 3; ++axis) {
+			data.transforms[axis].push_back(node->position[axis]);
+			data.transforms[3 + axis].push_back(node->rotation[axis]);
+		}
+
+		for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+			stack.emplace_back(it->get(), index);
+		}
+	}
+
+	LUN_ASSERT(data.classes.size() < Scene::NO_PARENT, "Too many instances for one scene")
+	return data;
+}
+
+static void writeBinary(const SceneData& data, const std::filesystem::path& path) {
+	const auto count = static_cast<std::uint32_t>(data.classes.size());
+
+	Scene::FileHeader header{};
+	header.magic = Scene::MAGIC;
+	header.version = Scene::VERSION;
+	header.instanceCount = count;
+	header.classCount = static_cast<std::uint32_t>(data.classNames.size());
+	header.stringCount = static_cast<std::uint32_t>(data.strings.size());
+
+	std::vector<std::uint32_t> stringOffsets;
+	stringOffsets.reserve(data.strings.size() + 1);
+	std::uint64_t stringBytes = 0;
+	for (std::string_view text : data.strings) {
+		stringOffsets.push_back(static_cast<std::uint32_t>(stringBytes));
+		stringBytes += text.size();
+	}
+	stringOffsets.push_back(static_cast<std::uint32_t>(stringBytes));
+	LUN_ASSERT(stringBytes <= 0xFFFFFFFF, "Scene string table is too large")
+
+	auto place = [](std::uint64_t& offset, std::uint64_t bytes) {
+		std::uint64_t start = offset;
+		offset = alignTo8(offset + bytes);
+		return start;
+		};
+
+	std::uint64_t offset = alignTo8(sizeof(Scene::FileHeader));
+	header.stringOffsetsOffset = place(offset, stringOffsets.size() * sizeof(std::uint32_t));
+	header.stringDataOffset = place(offset, stringBytes);
+	header.classNamesOffset = place(offset, data.classNames.size() * sizeof(std::uint32_t));
+	header.classesOffset = place(offset, count * sizeof(std::uint32_t));
+	header.namesOffset = place(offset, count * sizeof(std::uint32_t));
+	header.parentsOffset = place(offset, count * sizeof(std::uint32_t));
+	header.transformsOffset = place(offset, 6 * std::uint64_t(count) * sizeof(float));
+	header.assetsOffset = place(offset, count * sizeof(std::uint32_t));
+	header.fileSize = offset;
+
+	MappedFile file(path, MappedFile::Mode::ReadWrite, static_cast<std::size_t>(header.fileSize));
+	std::byte* base = file.data();
+
+	auto copyArray = [base](std::uint64_t at, const auto& values) {
+		if (!values.empty()) {
+			std::memcpy(base + at, values.data(), values.size() * sizeof(values[0]));
+		}
+		};
+
+	std::memcpy(base, &header, sizeof(header));
+	copyArray(header.stringOffsetsOffset, stringOffsets);
+	for (std::size_t i = 0; i < data.strings.size(); ++i) {
+		std::memcpy(base + header.stringDataOffset + stringOffsets[i], data.strings[i].data(), data.strings[i].size());
+	}
+	copyArray(header.classNamesOffset, data.classNames);
+	copyArray(header.classesOffset, data.classes);
+	copyArray(header.namesOffset, data.names);
+	copyArray(header.parentsOffset, data.parents);
+	for (std::size_t i = 0; i < 6; ++i) {
+		copyArray(header.transformsOffset + i * count * sizeof(float), data.transforms[i]);
+	}
+	copyArray(header.assetsOffset, data.assets);
+
+	file.flush();
+}
+
+static void writeEscaped(std::string& out, std::string_view text) {
+	for (char c : text) {
+		if (c == '\\') out += "\\\\";
+		else if (c == '\n') out += "\\n";
+		else if (c == '\r') out += "\\r";
+		else out += c;
+	}
+}
+
+static void writeText(const SceneData& data, const std::filesystem::path& path) {
+	// One line per instance: parent class px py pz rx ry rz name, floats in shortest round-trip form
+	std::string out = std::format("{} {}\nclasses {}\n", Scene::TEXT_MAGIC, Scene::VERSION, data.classNames.size());
+	for (std::uint32_t className : data.classNames) {
+		writeEscaped(out, data.strings[className]);
+		out += '\n';
+	}
+
+	out += std::format("instances {}\n", data.classes.size());
+	for (std::size_t i = 0; i < data.classes.size(); ++i) {
+		if (data.parents[i] == Scene::NO_PARENT) out += '-';
+		else out += std::format("{}", data.parents[i]);
+
+		out += std::format(" {} {} {} {} {} {} {} ", data.classes[i],
+			data.transforms[0][i], data.transforms[1][i], data.transforms[2][i],
+			data.transforms[3][i], data.transforms[4][i], data.transforms[5][i]);
+		writeEscaped(out, data.strings[data.names[i]]);
+		out += '\n';
+	}
+
+	// Asset paths only for the instances that have one: index path
+	auto assetCount = std::ranges::count_if(data.assets, [](std::uint32_t asset) { return asset != Scene::NO_ASSET; });
+	out += std::format("assets {}\n", assetCount);
+	for (std::size_t i = 0; i < data.assets.size(); ++i) {
+		if (data.assets[i] == Scene::NO_ASSET) continue;
+
+		out += std::format("{} ", i);
+		writeEscaped(out, data.strings[data.assets[i]]);
+		out += '\n';
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		throw std::runtime_error(std::format("Cannot open {} for writing", path.string()));
+	}
+	file.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+void Scene::Save(const Instance& root, const std::filesystem::path& path, Format format) {
+	Save(root.children, path, format);
+}
+
+void Scene::Save(std::span<const std::shared_ptr<Instance>> roots, const std::filesystem::path& path, Format format) {
+	SceneData data = flatten(roots);
+	if (format == Format::Binary) {
+		writeBinary(data, path);
+	}
+	else {
+		writeText(data, path);
+	}
+}
+
+// ----- Loading ----- //
+
+template<typename T>
+static std::span<const T> arrayAt(const MappedFile& file, std::uint64_t offset, std::uint64_t count) {
+	const std::uint64_t size = file.size();
+	LUN_ASSERT(offset % alignof(T) == 0 && offset <= size && count <= (size - offset) / sizeof(T), "Scene array out of bounds")
+	return std::span<const T>(reinterpret_cast<const T*>(file.data() + offset), static_cast<std::size_t>(count));
+}
+
+static SceneView viewBinary(const MappedFile& file) {
+	const std::byte* base = file.data();
+	const std::uint64_t size = file.size();
+	LUN_ASSERT(size >= sizeof(Scene::FileHeader), "Scene file is truncated")
+
+	Scene::FileHeader header;
+	std::memcpy(&header, base, sizeof(header));
+	LUN_ASSERT(header.magic == Scene::MAGIC, "Not a binary scene file")
+	LUN_ASSERT(header.version >= Scene::MIN_VERSION && header.version <= Scene::VERSION, "Unsupported scene version")
+	LUN_ASSERT(header.fileSize <= size, "Scene file is truncated")
+
+	const std::uint32_t count = header.instanceCount;
+	auto stringOffsets = arrayAt<std::uint32_t>(file, header.stringOffsetsOffset, std::uint64_t(header.stringCount) + 1);
+	LUN_ASSERT(header.stringDataOffset <= size && stringOffsets.back() <= size - header.stringDataOffset, "Scene string data out of bounds")
+
+	SceneView view;
+	view.strings.reserve(header.stringCount);
+	const char* stringData = reinterpret_cast<const char*>(base + header.stringDataOffset);
+	for (std::uint32_t i = 0; i < header.stringCount; ++i) {
+		LUN_ASSERT(stringOffsets[i] <= stringOffsets[i + 1], "Scene string table is corrupt")
+		view.strings.emplace_back(stringData + stringOffsets[i], stringOffsets[i + 1] - stringOffsets[i]);
+	}
+
+	view.classNames = arrayAt<std::uint32_t>(file, header.classNamesOffset, header.classCount);
+	view.classes = arrayAt<std::uint32_t>(file, header.classesOffset, count);
+	view.names = arrayAt<std::uint32_t>(file, header.namesOffset, count);
+	view.parents = arrayAt<std::uint32_t>(file, header.parentsOffset, count);
+	auto transforms = arrayAt<float>(file, header.transformsOffset, 6 * std::uint64_t(count));
+	for (std::size_t i = 0; i < 6; ++i) {
+		view.transforms[i] = transforms.subspan(i * count, count);
+	}
+
+	// Version 1 headers end before assetsOffset, what was read there belongs to the arrays
+	if (header.version >= 2) {
+		view.assets = arrayAt<std::uint32_t>(file, header.assetsOffset, count);
+	}
+	return view;
+}
+
+static std::string unescape(std::string_view text) {
+	std::string out;
+	out.reserve(text.size());
+	for (std::size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == '\\' && i + 1 < text.size()) {
+			char next = text[++i];
+			out += next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+		}
+		else {
+			out += text[i];
+		}
+	}
+	return out;
+}
+
+static SceneData parseText(std::string_view text) {
+	std::size_t lineNumber = 0;
+	auto nextLine = [&]() {
+		LUN_ASSERT(!text.empty(), "Scene file ends early")
+		std::size_t end = text.find('\n');
+		std::string_view line = text.substr(0, end);
+		text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+		++lineNumber;
+		if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+		return line;
+		};
+
+	// Reads a whitespace separated field off the front of line
+	auto parseField = [&]<typename T>(std::string_view& line, T& value) {
+		std::size_t start = line.find_first_not_of(' ');
+		line = start == std::string_view::npos ? std::string_view{} : line.substr(start);
+		auto [ptr, ec] = std::from_chars(line.data(), line.data() + line.size(), value);
+		if (ec != std::errc() || (ptr != line.data() + line.size() && *ptr != ' ')) {
+			throw std::runtime_error(std::format("Malformed scene file at line {}", lineNumber));
+		}
+		line.remove_prefix(static_cast<std::size_t>(ptr - line.data()));
+		};
+
+	auto parseCount = [&](std::string_view keyword) {
+		std::string_view line = nextLine();
+		if (!line.starts_with(keyword)) {
+			throw std::runtime_error(std::format("Expected '{}' at line {} of the scene file", keyword, lineNumber));
+		}
+		line.remove_prefix(keyword.size());
+		std::uint32_t count = 0;
+		parseField(line, count);
+		return count;
+		};
+
+	std::string_view header = nextLine();
+	LUN_ASSERT(header.starts_with(Scene::TEXT_MAGIC), "Not a scene file")
+	header.remove_prefix(Scene::TEXT_MAGIC.size());
+	std::uint32_t version = 0;
+	parseField(header, version);
+	LUN_ASSERT(version >= Scene::MIN_VERSION && version <= Scene::VERSION, "Unsupported scene version")
+
+	SceneData data;
+	const std::uint32_t classCount = parseCount("classes");
+	for (std::uint32_t i = 0; i < classCount; ++i) {
+		data.classNames.push_back(static_cast<std::uint32_t>(data.storage.size()));
+		data.storage.push_back(unescape(nextLine()));
+	}
+
+	const std::uint32_t count = parseCount("instances");
+	LUN_ASSERT(count < Scene::NO_PARENT, "Too many instances for one scene")
+	data.classes.reserve(count);
+	data.names.reserve(count);
+	data.parents.reserve(count);
+	for (auto& values : data.transforms) {
+		values.reserve(count);
+	}
+
+	for (std::uint32_t i = 0; i < count; ++i) {
+		std::string_view line = nextLine();
+
+		std::uint32_t parentIndex = Scene::NO_PARENT;
+		if (line.starts_with('-')) line.remove_prefix(1);
+		else parseField(line, parentIndex);
+		data.parents.push_back(parentIndex);
+
+		std::uint32_t classIndex = 0;
+		parseField(line, classIndex);
+		data.classes.push_back(classIndex);
+
+		for (auto& values : data.transforms) {
+			float value = 0.0f;
+			parseField(line, value);
+			values.push_back(value);
+		}
+
+		// The name is the rest of the line after a single separator
+		if (!line.empty()) line.remove_prefix(1);
+		data.names.push_back(static_cast<std::uint32_t>(data.storage.size()));
+		data.storage.push_back(unescape(line));
+	}
+
+	if (version >= 2) {
+		data.assets.assign(count, Scene::NO_ASSET);
+		const std::uint32_t assetCount = parseCount("assets");
+		for (std::uint32_t i = 0; i < assetCount; ++i) {
+			std::string_view line = nextLine();
+
+			std::uint32_t instanceIndex = 0;
+			parseField(line, instanceIndex);
+			if (instanceIndex >= count) {
+				throw std::runtime_error(std::format("Asset for unknown instance at line {} of the scene file", lineNumber));
+			}
+
+			if (!line.empty()) line.remove_prefix(1);
+			data.assets[instanceIndex] = static_cast<std::uint32_t>(data.storage.size());
+			data.storage.push_back(unescape(line));
+		}
+	}
+
+	// Only now that storage is complete
+	data.strings.assign(data.storage.begin(), data.storage.end());
+	return data;
+}
+
+void Scene::attach(Instance& parent, std::shared_ptr<Instance> child) {
+	child->parent = parent.weak_from_this();
+	child->m_indexInParent = parent.children.size();
+	parent.children.push_back(std::move(child));
+}
+
+std::vector<std::shared_ptr<Instance>> Scene::build(const SceneView& view, const std::shared_ptr<Instance>& target, bool announce) {
+	const std::size_t count = view.classes.size();
+
+	// Class names are resolved once per class, not per instance
+	std::vector<InstanceRegistry::ClassId> classIds;
+	classIds.reserve(view.classNames.size());
+	for (std::uint32_t className : view.classNames) {
+		LUN_ASSERT(className < view.strings.size(), "Scene class table is corrupt")
+		InstanceRegistry::ClassId id = InstanceRegistry::GetClassId(view.strings[className]);
+		if (id == InstanceRegistry::INVALID_CLASS) {
+			throw std::runtime_error(std::format("Unknown class '{}' in scene", view.strings[className]));
+		}
+		classIds.push_back(id);
+	}
+
+	// Children vectors are sized up front, parents always precede their children
+	std::vector<std::uint32_t> childCounts(count, 0);
+	std::vector<std::size_t> classCounts(classIds.size(), 0);
+	std::size_t topLevelCount = 0;
+	for (std::size_t i = 0; i < count; ++i) {
+		LUN_ASSERT(view.classes[i] < classIds.size() && view.names[i] < view.strings.size(), "Scene instance is corrupt")
+		LUN_ASSERT(view.assets.empty() || view.assets[i] == NO_ASSET || view.assets[i] < view.strings.size(), "Scene asset path is corrupt")
+		++classCounts[view.classes[i]];
+
+		std::uint32_t parentIndex = view.parents[i];
+		if (parentIndex == NO_PARENT) {
+			++topLevelCount;
+			continue;
+		}
+		LUN_ASSERT(parentIndex < i, "Scene parent index is out of order")
+		++childCounts[parentIndex];
+	}
+
+	// Every class is created in one batch, then handed out in file order
+	std::vector<std::vector<std::shared_ptr<Instance>>> created(classIds.size());
+	std::vector<std::size_t> nextOfClass(classIds.size(), 0);
+	for (std::size_t c = 0; c < classIds.size(); ++c) {
+		InstanceRegistry::CreateMany(classIds[c], classCounts[c], created[c]);
+		LUN_ASSERT(created[c].size() == classCounts[c], "Instance factory failed")
+	}
+
+	std::vector<std::shared_ptr<Instance>> instances(count);
+	std::vector<std::shared_ptr<Instance>> topLevel;
+	topLevel.reserve(topLevelCount);
+
+	for (std::size_t i = 0; i < count; ++i) {
+		const std::uint32_t classIndex = view.classes[i];
+		auto instance = std::move(created[classIndex][nextOfClass[classIndex]++]);
+		LUN_ASSERT(instance, "Instance factory returned null")
+
+		instance->name = view.strings[view.names[i]];
+		instance->position = { view.transforms[0][i], view.transforms[1][i], view.transforms[2][i] };
+		instance->rotation = { view.transforms[3][i], view.transforms[4][i], view.transforms[5][i] };
+		instance->children.reserve(childCounts[i]);
+		if (!view.assets.empty() && view.assets[i] != NO_ASSET) {
+			instance->setAssetPath(view.strings[view.assets[i]]);
+		}
+
+		if (view.parents[i] == NO_PARENT) {
+			topLevel.push_back(instance);
+		}
+		else {
+			attach(*instances[view.parents[i]], instance);
+		}
+		instances[i] = std::move(instance);
+	}
+
+	// Nothing touches the live tree until the whole scene was built
+	target->children.reserve(target->children.size() + topLevel.size());
+	for (const auto& instance : topLevel) {
+		attach(*target, instance);
+		if (announce) {
+			HierarchyEvents::Record({ HierarchyEventType::Added, instance->getId(), 0, target->getId(), instance });
+		}
+	}
+	return topLevel;
+}
+
+std::vector<std::shared_ptr<Instance>> Scene::Load(const std::filesystem::path& path, const std::shared_ptr<Instance>& parent, bool announce) {
+	LUN_ASSERT(parent, "Scenes have to be loaded under an instance")
+
+	MappedFile file(path, MappedFile::Mode::Read);
+	const bool binary = file.size() >= MAGIC.size() && std::memcmp(file.data(), MAGIC.data(), MAGIC.size()) == 0;
+
+	if (binary) {
+		return build(viewBinary(file), parent, announce);
+	}
+
+	std::string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+	SceneData data = parseText(text);
+	return build(viewOf(data), parent, announce);
+}
+
+// ----- Benchmark ----- //
+
+Scene::BenchmarkResult Scene::Benchmark(std::size_t instanceCount, const std::filesystem::path& directory) {
+	LUN_ASSERT(instanceCount < NO_PARENT, "Too many instances for one scene")
+
+	// A wide forest, 64 roots and then 8 children per instance
+	constexpr std::size_t ROOTS = 64;
+	auto source = std::make_shared<Instance>("BenchmarkSource");
+	std::vector<std::shared_ptr<Instance>> generated;
+	InstanceRegistry::CreateMany(InstanceRegistry::GetClassId<Instance>(), instanceCount, generated);
+	for (std::size_t i = 0; i < instanceCount; ++i) {
+		auto& instance = generated[i];
+		instance->name = std::format("Instance{}", i);
+		instance->position = glm::vec3(static_cast<float>(i % 100), static_cast<float>(i / 100 % 100), static_cast<float>(i / 10000));
+		attach(i < ROOTS ? *source : *generated[(i - ROOTS) / 8], instance);
+	}
+	generated.clear();
+
+	BenchmarkResult result;
+	result.instanceCount = instanceCount;
+
+	auto run = [&](Format format, const std::filesystem::path& path, double& saveMs, double& loadMs, std::uintmax_t& bytes) {
+		auto start = std::chrono::steady_clock::now();
+		Save(*source, path, format);
+		saveMs = millisecondsSince(start);
+		bytes = std::filesystem::file_size(path);
+
+		// Loaded quietly, the benchmark trees never join the live hierarchy
+		auto target = std::make_shared<Instance>("BenchmarkTarget");
+		start = std::chrono::steady_clock::now();
+		Load(path, target, false);
+		loadMs = millisecondsSince(start);
+
+		std::filesystem::remove(path);
+		};
+
+	run(Format::Text, directory / "lunatic_scene_benchmark.txt", result.textSaveMs, result.textLoadMs, result.textBytes);
+	run(Format::Binary, directory / "lunatic_scene_benchmark.lscene", result.binarySaveMs, result.binaryLoadMs, result.binaryBytes);
+
+	return result;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "pch.h"
+
+#include "base.h"
+
+namespace Lunatic {
+	struct SceneView;
+
+	/// <summary>
+	/// Scene files. Both formats store the same flattened tree: a string table shared by
+	/// class and instance names, a class table resolved once per class through
+	/// InstanceRegistry, and per instance a class index, name index, parent index, asset
+	/// path index and SoA transform blocks. Instances are stored depth-first, so parents
+	/// always come first. Version 1 files have no asset paths and still load.
+	///
+	/// The text format is line based for diffing, the binary one is memory-mapped and
+	/// loaded with a single pass over its arrays.
+	/// </summary>
+	class Scene {
+	public:
+		enum class Format {
+			Text,
+			Binary
+		};
+
+		static constexpr std::uint32_t VERSION = 2;
+		static constexpr std::uint32_t MIN_VERSION = 1;
+		static constexpr std::uint32_t NO_PARENT = 0xFFFFFFFF;
+		static constexpr std::uint32_t NO_ASSET = 0xFFFFFFFF;
+		static constexpr std::array<char, 8> MAGIC = { 'L', 'U', 'N', 'S', 'C', 'E', 'N', 'E' };
+		static constexpr std::string_view TEXT_MAGIC = "LunaticScene";
+
+		// Every array is 8-byte aligned and sits at its offset from the start of the file
+		struct FileHeader {
+			std::array<char, 8> magic;
+			std::uint32_t version;
+			std::uint32_t instanceCount;
+			std::uint32_t classCount;
+			std::uint32_t stringCount;
+			std::uint64_t stringOffsetsOffset; // uint32[stringCount + 1], into the string data
+			std::uint64_t stringDataOffset;
+			std::uint64_t classNamesOffset;    // uint32[classCount], string indices
+			std::uint64_t classesOffset;       // uint32[instanceCount], class indices
+			std::uint64_t namesOffset;         // uint32[instanceCount], string indices
+			std::uint64_t parentsOffset;       // uint32[instanceCount], instance index or NO_PARENT
+			std::uint64_t transformsOffset;    // float[6][instanceCount], position xyz then rotation xyz
+			std::uint64_t fileSize;
+			std::uint64_t assetsOffset;        // uint32[instanceCount], string indices or NO_ASSET, version 2+
+		};
+
+		struct BenchmarkResult {
+			std::size_t instanceCount = 0;
+			double textSaveMs = 0.0;
+			double textLoadMs = 0.0;
+			std::uintmax_t textBytes = 0;
+			double binarySaveMs = 0.0;
+			double binaryLoadMs = 0.0;
+			std::uintmax_t binaryBytes = 0;
+		};
+
+		// Saves every descendant of root, root itself is not part of the scene
+		static void Save(const Instance& root, const std::filesystem::path& path, Format format);
+		// Saves the given instances and their subtrees as the top level of a scene
+		static void Save(std::span<const std::shared_ptr<Instance>> roots, const std::filesystem::path& path, Format format);
+
+		// Loads a scene under parent, the format is detected from the file. Throws
+		// std::runtime_error on a malformed file or a class InstanceRegistry doesn't know.
+		// With announce, the top-level instances are recorded to HierarchyEvents as Added.
+		// Without it nothing global is touched, so a worker thread can load under a parent
+		// that isn't part of the live tree yet. Factories never get a GL context for that reason.
+		static std::vector<std::shared_ptr<Instance>> Load(const std::filesystem::path& path, const std::shared_ptr<Instance>& parent, bool announce = true);
+
+		// Round-trips a generated tree of plain Instances through both formats in directory
+		static BenchmarkResult Benchmark(std::size_t instanceCount, const std::filesystem::path& directory);
+
+	private:
+		static std::vector<std::shared_ptr<Instance>> build(const SceneView& view, const std::shared_ptr<Instance>& target, bool announce);
+
+		// Bulk construction links instances directly, setParent would record an event for every one
+		static void attach(Instance& parent, std::shared_ptr<Instance> child);
+	};
+} // namespace Lunatic
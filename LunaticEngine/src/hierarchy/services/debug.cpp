@@ -2,18 +2,28 @@
 #include "debug.h"
 #include "renderer.h"
 #include "../../core/engine.h"
+#include "../../logging/binary_log_reader.h"
+#include "../../render/image.h"
+#include "../scene.h"
+#include <spdlog/pattern_formatter.h>
 #include <spdlog/spdlog.h>
 #include <fmt/format.h>
 
 using namespace Lunatic::Services;
 
 // ImGuiConsole Implementation
-ImGuiConsole::ImGuiConsole() : auto_scroll_(true), scroll_to_bottom_(false) {
+ImGuiConsole::ImGuiConsole(std::size_t maxLines, std::size_t textCapacity)
+	: text_(std::max<std::size_t>(textCapacity, 1)), lines_(std::max<std::size_t>(maxLines, 1)),
+	auto_scroll_(true), scroll_to_bottom_(false) {
 	Clear();
 }
 
 void ImGuiConsole::Clear() {
-	logs_.clear();
+	text_end_ = 0;
+	first_line_ = 0;
+	next_line_ = 0;
+	filtered_.clear();
+	filter_scanned_ = 0;
 	filter_.Clear();
 }
 
@@ -24,12 +34,90 @@ void ImGuiConsole::AddLog(const ImVec4& col, const char* fmt, ...) {
 	std::vsnprintf(buf, sizeof(buf), fmt, args);
 	va_end(args);
 
-	logs_.push_back({ std::string(buf), col });
+	AddLog(col, std::string_view(buf));
+}
+
+void ImGuiConsole::AddLog(const ImVec4& col, std::string_view message) {
+	// One record per line keeps every row the same height for the clipper
+	while (!message.empty()) {
+		std::size_t newline = message.find('\n');
+		PushLine(col, message.substr(0, newline));
+		if (newline == std::string_view::npos) break;
+		message.remove_prefix(newline + 1);
+	}
+
 	if (auto_scroll_) {
 		scroll_to_bottom_ = true;
 	}
 }
 
+void ImGuiConsole::PushLine(const ImVec4& col, std::string_view line) {
+	const std::size_t capacity = text_.size();
+	line = line.substr(0, capacity);
+
+	// Lines never straddle the end of the arena, skip ahead to its start instead
+	std::uint64_t start = text_end_;
+	std::size_t wrapped = static_cast<std::size_t>(start % capacity);
+	if (wrapped + line.size() > capacity) {
+		start += capacity - wrapped;
+		wrapped = 0;
+	}
+	std::uint64_t end = start + line.size();
+
+	while (first_line_ != next_line_ &&
+		(next_line_ - first_line_ == lines_.size() || end - lines_[first_line_ % lines_.size()].offset > capacity)) {
+		PopLine();
+	}
+
+	std::memcpy(text_.data() + wrapped, line.data(), line.size());
+	lines_[next_line_ % lines_.size()] = LogLine{
+		.offset = start,
+		.length = static_cast<std::uint32_t>(line.size()),
+		.color = col
+	};
+	++next_line_;
+	text_end_ = end;
+}
+
+void ImGuiConsole::PopLine() {
+	if (!filtered_.empty() && filtered_.front() == first_line_) {
+		filtered_.pop_front();
+	}
+	++first_line_;
+	filter_scanned_ = std::max(filter_scanned_, first_line_);
+}
+
+std::string_view ImGuiConsole::LineText(std::uint64_t index) const {
+	const LogLine& line = lines_[index % lines_.size()];
+	return { text_.data() + line.offset % text_.size(), line.length };
+}
+
+void ImGuiConsole::UpdateFilterIndex() {
+	for (; filter_scanned_ < next_line_; ++filter_scanned_) {
+		std::string_view text = LineText(filter_scanned_);
+		if (filter_.PassFilter(text.data(), text.data() + text.size())) {
+			filtered_.push_back(filter_scanned_);
+		}
+	}
+}
+
+void ImGuiConsole::CopyToClipboard() const {
+	std::string contents;
+	auto append = [&](std::uint64_t index) {
+		contents += LineText(index);
+		contents += '\n';
+		};
+
+	if (filter_.IsActive()) {
+		for (std::uint64_t index : filtered_) append(index);
+	}
+	else {
+		for (std::uint64_t index = first_line_; index < next_line_; ++index) append(index);
+	}
+
+	ImGui::SetClipboardText(contents.c_str());
+}
+
 void ImGuiConsole::Draw(const char* title, bool* p_open) {
 	if (!ImGui::Begin(title, p_open)) {
 		ImGui::End();
@@ -41,12 +129,17 @@ void ImGuiConsole::Draw(const char* title, bool* p_open) {
 	ImGui::SameLine();
 	if (ImGui::Button("Clear")) Clear();
 	ImGui::SameLine();
-	if (ImGui::Button("Copy")) ImGui::LogToClipboard();
+	if (ImGui::Button("Copy")) CopyToClipboard();
 	ImGui::SameLine();
-	filter_.Draw("Filter (inc,-exc)");
+	if (filter_.Draw("Filter (inc,-exc)")) {
+		// Filter text changed, rebuild the index from the oldest line
+		filtered_.clear();
+		filter_scanned_ = first_line_;
+	}
 
 	if (ImGui::BeginPopup("ConsoleOptions")) {
 		ImGui::Checkbox("Auto-scroll", &auto_scroll_);
+		ImGui::Text("%zu / %zu lines", GetLineCount(), lines_.size());
 		ImGui::EndPopup();
 	}
 
@@ -57,13 +150,26 @@ void ImGuiConsole::Draw(const char* title, bool* p_open) {
 		"ScrollingRegion", ImVec2(0, -ImGui::GetFrameHeightWithSpacing()),
 		false, ImGuiWindowFlags_HorizontalScrollbar);
 
-	for (const auto& entry : logs_) {
-		if (!filter_.IsActive() || filter_.PassFilter(entry.message.c_str())) {
-			ImGui::PushStyleColor(ImGuiCol_Text, entry.color);
-			ImGui::TextUnformatted(entry.message.c_str());
+	const bool filtering = filter_.IsActive();
+	if (filtering) {
+		UpdateFilterIndex();
+	}
+
+	std::size_t count = filtering ? filtered_.size() : GetLineCount();
+
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(count));
+	while (clipper.Step()) {
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+			std::uint64_t index = filtering ? filtered_[row] : first_line_ + row;
+			std::string_view text = LineText(index);
+
+			ImGui::PushStyleColor(ImGuiCol_Text, lines_[index % lines_.size()].color);
+			ImGui::TextUnformatted(text.data(), text.data() + text.size());
 			ImGui::PopStyleColor();
 		}
 	}
+	clipper.End();
 
 	if (scroll_to_bottom_ && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) {
 		ImGui::SetScrollHereY(1.0f);
@@ -76,14 +182,9 @@ void ImGuiConsole::Draw(const char* title, bool* p_open) {
 	ImGui::End();
 }
 
-CustomSink::CustomSink(ImGuiConsole* console) : console_(console) {}
-
-void CustomSink::sink_it_(const spdlog::details::log_msg& msg) {
-	spdlog::memory_buf_t formatted;
-	formatter_->format(msg, formatted);
-	std::string formattedMessage = fmt::to_string(formatted);
+static ImVec4 levelColor(spdlog::level::level_enum level) {
 	auto color = ImVec4(1.0f, 1.0f, 1.0f, 1.0f); // default white
-	switch (msg.level) {
+	switch (level) {
 		// gray (trace)
 	case spdlog::level::trace:
 		color = ImVec4(0.5f, 0.5f, 0.5f, 1.0f);
@@ -102,21 +203,46 @@ void CustomSink::sink_it_(const spdlog::details::log_msg& msg) {
 		color = ImVec4(1.0f, 0.0f, 0.0f, 1.0f);
 		break;
 	}
+	return color;
+}
+
+CustomSink::CustomSink(ImGuiConsole* console) : console_(console) {}
 
-	console_->AddLog(color, "%s", formattedMessage.c_str());
+void CustomSink::sink_it_(const spdlog::details::log_msg& msg) {
+	spdlog::memory_buf_t formatted;
+	formatter_->format(msg, formatted);
+	console_->AddLog(levelColor(msg.level), std::string_view(formatted.data(), formatted.size()));
 }
 
 void CustomSink::flush_() { /* No-op for ImGui console */ }
 
-Debug::Debug() : Service("Debug") {
-	// Set up spdlog with our custom sink
-	m_customSink = std::make_shared<CustomSink>(&m_console);
-	spdlog::sinks_init_list sinks = { m_customSink };
+Debug::Debug(bool asyncLogging) : Service("Debug") {
+	// Set up spdlog with our console sink
+	if (asyncLogging) {
+		m_asyncSink = std::make_shared<AsyncConsoleSink>([this](spdlog::level::level_enum level, std::string_view text) {
+			m_console.AddLog(levelColor(level), text);
+			});
+		m_consoleSink = m_asyncSink;
+		AsyncConsoleSink::SetActive(m_asyncSink.get());
+	}
+	else {
+		m_consoleSink = std::make_shared<CustomSink>(&m_console);
+	}
+
+	spdlog::sinks_init_list sinks = { m_consoleSink };
 	spdlog::set_default_logger(std::make_shared<spdlog::logger>("Lunatic", sinks));
 	spdlog::set_level(spdlog::level::trace);
 }
 
 void Debug::update(float deltaTime) {
+	++m_frameIndex;
+	if (m_asyncSink) {
+		m_asyncSink->drain();
+	}
+
+	// Writers that read the active capture before it stopped are long done by now
+	std::erase_if(m_retiredCaptures, [this](const auto& retired) { return retired.second + 1 < m_frameIndex; });
+
 	auto& engine = Engine::GetInstance();
 	for (const auto& [name, service] : engine.getServicesMap()) {
 		if (m_autoUpdateMap[name]) {
@@ -125,6 +251,80 @@ void Debug::update(float deltaTime) {
 	}
 }
 
+void Debug::startCapture(const std::filesystem::path& path) {
+	stopCapture();
+	if (m_capture) {
+		m_retiredCaptures.emplace_back(std::move(m_capture), m_captureStoppedFrame);
+	}
+
+	try {
+		m_capture = std::make_unique<BinaryLog>(path);
+	}
+	catch (const std::exception& e) {
+		spdlog::error("[Debug] Could not start binary log capture: {}", e.what());
+		return;
+	}
+
+	BinaryLog::SetActive(m_capture.get());
+	spdlog::info("[Debug] Capturing binary log to {}", path.string());
+}
+
+void Debug::stopCapture() {
+	if (!isCapturing()) return;
+
+	BinaryLog::SetActive(nullptr);
+	m_captureStoppedFrame = m_frameIndex;
+	m_capture->flush();
+	spdlog::info("[Debug] Binary log capture stopped, {} bytes used, {} records dropped",
+		m_capture->getUsedBytes(), m_capture->getDroppedCount());
+}
+
+void Debug::replayCapture(const std::filesystem::path& path) {
+	std::unique_ptr<BinaryLogReader> reader;
+	try {
+		reader = std::make_unique<BinaryLogReader>(path);
+	}
+	catch (const std::exception& e) {
+		spdlog::error("[Debug] Could not open binary log {}: {}", path.string(), e.what());
+		return;
+	}
+
+	// Same layout as live console output
+	auto formatter = std::make_unique<spdlog::pattern_formatter>();
+	spdlog::memory_buf_t formatted;
+	BinaryLogReader::Entry entry;
+
+	while (reader->next(entry)) {
+		spdlog::details::log_msg msg(entry.time, spdlog::source_loc{}, "Lunatic", entry.level,
+			spdlog::string_view_t(entry.text.data(), entry.text.size()));
+		msg.thread_id = entry.threadId;
+
+		formatted.clear();
+		formatter->format(msg, formatted);
+		m_console.AddLog(levelColor(entry.level), std::string_view(formatted.data(), formatted.size()));
+	}
+
+	if (reader->getDroppedCount() > 0) {
+		m_console.AddLog(levelColor(spdlog::level::warn),
+			std::format("[Debug] The capture dropped {} record(s) after filling up", reader->getDroppedCount()));
+	}
+}
+
+void Debug::runSceneBenchmark() {
+	for (std::size_t count : { std::size_t(10'000), std::size_t(1'000'000) }) {
+		try {
+			auto result = Scene::Benchmark(count, std::filesystem::temp_directory_path());
+			spdlog::info("[Debug] Scene benchmark, {} instances: text save {:.1f} ms, load {:.1f} ms, {} KiB | binary save {:.1f} ms, load {:.1f} ms, {} KiB",
+				result.instanceCount, result.textSaveMs, result.textLoadMs, result.textBytes / 1024,
+				result.binarySaveMs, result.binaryLoadMs, result.binaryBytes / 1024);
+		}
+		catch (const std::exception& e) {
+			spdlog::error("[Debug] Scene benchmark with {} instances failed: {}", count, e.what());
+			return;
+		}
+	}
+}
+
 void Debug::render() {
 	if (m_showServices) {
 		renderServicesWindow();
@@ -138,6 +338,8 @@ void Debug::render() {
 		renderCameraWindow();
 	}
 	
+	renderSceneWindow();
+
 	if (m_showScripting) {
 		static auto scripting = ServiceLocator::Get<Lunatic::Services::Scripting>("Scripting");
 		scripting->drawImGuiWindow();
@@ -148,7 +350,25 @@ void Debug::render() {
 			ImGui::MenuItem("Services", nullptr, &m_showServices);
 			ImGui::MenuItem("Console", nullptr, &m_showConsole);
 			ImGui::MenuItem("Camera", nullptr, &m_showCamera);
+			ImGui::MenuItem("Scene View", nullptr, &m_showScene);
 			ImGui::MenuItem("Scripting", nullptr, &m_showScripting);
+			ImGui::Separator();
+
+			bool capturing = isCapturing();
+			if (ImGui::MenuItem("Capture Binary Log", nullptr, capturing)) {
+				if (capturing) stopCapture();
+				else startCapture(m_capturePath);
+			}
+			if (ImGui::MenuItem("Replay Capture", nullptr, false, !capturing && m_capture != nullptr)) {
+				replayCapture(m_capturePath);
+			}
+			ImGui::Separator();
+			if (ImGui::MenuItem("Save Screenshot")) {
+				saveScreenshot("lunatic_screenshot.ppm");
+			}
+			if (ImGui::MenuItem("Scene Load Benchmark")) {
+				runSceneBenchmark();
+			}
 			ImGui::EndMenu();
 		}
 		ImGui::Text("FPS: %.2f", ImGui::GetIO().Framerate);
@@ -156,6 +376,63 @@ void Debug::render() {
 	}
 }
 
+void Debug::saveScreenshot(const std::filesystem::path& path) {
+	static auto renderer = ServiceLocator::Get<Lunatic::Services::Renderer>("Renderer");
+	renderer->requestCapture([path](const Framebuffer::Capture& capture) {
+		try {
+			Image::FromCapture(capture).savePpm(path);
+			spdlog::info("[Debug] Saved a {}x{} screenshot to {}", capture.size.x, capture.size.y, path.string());
+		}
+		catch (const std::exception& e) {
+			spdlog::error("[Debug] Screenshot failed: {}", e.what());
+		}
+	});
+}
+
+void Debug::renderSceneWindow() {
+	static auto renderer = ServiceLocator::Get<Lunatic::Services::Renderer>("Renderer");
+
+	// The close button clears m_showScene inside Begin, End is still owed
+	const bool began = m_showScene;
+	bool visible = false;
+	if (began) {
+		ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
+		visible = ImGui::Begin("Scene", &m_showScene);
+		ImGui::PopStyleVar();
+	}
+	renderer->setPresentToWindow(!visible);
+
+	if (visible) {
+		// The scene is rendered at the panel's size, it takes effect next frame. Until then
+		// the last frame is scaled to fit, GL textures start at the bottom row.
+		const Framebuffer& framebuffer = renderer->getFramebuffer();
+		const ImVec2 available = ImGui::GetContentRegionAvail();
+		const glm::ivec2 panelSize(static_cast<int>(available.x), static_cast<int>(available.y));
+		if (panelSize.x > 0 && panelSize.y > 0 && panelSize != framebuffer.getSize()) {
+			renderer->resize(panelSize.x, panelSize.y);
+		}
+		m_sceneSizedToPanel = true;
+
+		const glm::vec2 size(framebuffer.getSize());
+		const float scale = std::min(available.x / size.x, available.y / size.y);
+		if (scale > 0.0f) {
+			const ImVec2 image(size.x * scale, size.y * scale);
+			ImGui::SetCursorPos(ImGui::GetCursorPos() + (available - image) * 0.5f);
+			ImGui::Image((ImTextureID)(std::intptr_t)framebuffer.getColorTexture(), image, ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+		}
+	}
+	else if (m_sceneSizedToPanel) {
+		// Back to covering the window
+		const glm::ivec2 windowSize(Engine::GetInstance().getWindowSize());
+		renderer->resize(windowSize.x, windowSize.y);
+		m_sceneSizedToPanel = false;
+	}
+
+	if (began) {
+		ImGui::End();
+	}
+}
+
 void Debug::renderServicesWindow() {
 	return; // TODO: Review if this is even necessary anymore
 
@@ -262,5 +539,33 @@ void Debug::renderCameraWindow() {
 		ImGui::Text("FOV: %.1f°", fov);
 	}
 
+	if (ImGui::CollapsingHeader("Render Queue")) {
+		bool multiDraw = renderer->isMultiDraw();
+		if (ImGui::Checkbox("Multi-draw indirect", &multiDraw)) {
+			renderer->setMultiDraw(multiDraw);
+		}
+
+		RenderQueue& queue = renderer->getQueue();
+		bool gpuCulling = queue.isGpuCulling();
+		if (ImGui::Checkbox("GPU culling", &gpuCulling)) {
+			queue.setGpuCulling(gpuCulling);
+		}
+		ImGui::BeginDisabled(!gpuCulling || !multiDraw);
+		bool hiZ = queue.getCuller().isHiZ();
+		if (ImGui::Checkbox("Hi-Z occlusion", &hiZ)) {
+			queue.getCuller().setHiZ(hiZ);
+		}
+		ImGui::EndDisabled();
+
+		const RenderQueue::Stats& stats = queue.getStats();
+		ImGui::Text("Draws: %zu", stats.draws);
+		ImGui::Text("Multi-draws: %zu (%zu commands)", stats.multiDraws, stats.indirectCommands);
+		ImGui::Text("GPU cull tests: %zu", stats.gpuCullTested);
+		ImGui::Text("Program binds: %zu (%zu saved)", stats.programBinds, stats.programBindsSaved);
+		ImGui::Text("VAO binds: %zu (%zu saved)", stats.vaoBinds, stats.vaoBindsSaved);
+		ImGui::Text("Uniform uploads: %zu (%zu saved)", stats.uniformUploads, stats.uniformUploadsSaved);
+		ImGui::Text("Sort: %.3f ms, submit: %.3f ms", stats.sortMs, stats.submitMs);
+	}
+
 	ImGui::End();
 }
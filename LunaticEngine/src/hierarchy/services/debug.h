@@ -2,29 +2,59 @@
 
 #include "../base.h"
 #include "../../render/camera.h"
+#include "../../logging/binary_log.h"
+#include "../../logging/async_console_sink.h"
 #include <spdlog/sinks/base_sink.h>
 #include <spdlog/details/log_msg.h>
 #include <imgui.h>
 #include <unordered_map>
+#include <deque>
 
 namespace Lunatic::Services {
-	struct LogContainer {
-		std::string message;
-		ImVec4 color;
-	};
-
+	/// <summary>
+	/// Log window with bounded memory. Lines live in a fixed-size ring of records pointing
+	/// into one contiguous text arena, the oldest lines are evicted once either is full.
+	/// Only visible lines are submitted, and the filter result is kept as an index that is
+	/// extended with new lines instead of re-testing the whole log every frame.
+	/// </summary>
 	class ImGuiConsole {
 	public:
-		ImGuiConsole();
+		static constexpr std::size_t DEFAULT_MAX_LINES = 16384;
+		static constexpr std::size_t DEFAULT_TEXT_CAPACITY = 2 * 1024 * 1024;
+
+		ImGuiConsole(std::size_t maxLines = DEFAULT_MAX_LINES, std::size_t textCapacity = DEFAULT_TEXT_CAPACITY);
 		void Clear();
 		void AddLog(const ImVec4& col, const char* fmt, ...) IM_FMTARGS(3);
+		void AddLog(const ImVec4& col, std::string_view message);
 		void Draw(const char* title, bool* p_open = nullptr);
 
+		std::size_t GetLineCount() const { return static_cast<std::size_t>(next_line_ - first_line_); }
+
 	private:
-		std::vector<LogContainer> logs_;
+		struct LogLine {
+			std::uint64_t offset = 0; // absolute position in the arena, wraps by text_.size()
+			std::uint32_t length = 0;
+			ImVec4 color;
+		};
+
+		std::vector<char> text_;
+		std::vector<LogLine> lines_;
+		std::uint64_t text_end_ = 0;   // absolute write position
+		std::uint64_t first_line_ = 0; // absolute indices, line i lives in lines_[i % lines_.size()]
+		std::uint64_t next_line_ = 0;
+
 		ImGuiTextFilter filter_;
+		std::deque<std::uint64_t> filtered_; // absolute indices of lines passing filter_
+		std::uint64_t filter_scanned_ = 0;   // first line not yet tested against filter_
+
 		bool auto_scroll_;
 		bool scroll_to_bottom_;
+
+		void PushLine(const ImVec4& col, std::string_view line);
+		void PopLine();
+		std::string_view LineText(std::uint64_t index) const;
+		void UpdateFilterIndex();
+		void CopyToClipboard() const;
 	};
 
 	class CustomSink : public spdlog::sinks::base_sink<std::mutex> {
@@ -41,20 +71,45 @@ namespace Lunatic::Services {
 
 	class Debug : public Service {
 	public:
-		Debug();
+		// Async logging defers console formatting to update(), sync logging formats on the calling thread
+		explicit Debug(bool asyncLogging = true);
 
 		void update(float deltaTime) override;
 		void render() override;
 
 		// Console access
 		ImGuiConsole& getConsole() { return m_console; }
+
+		// Binary capture of everything logged through LUN_LOG, see BinaryLog
+		void startCapture(const std::filesystem::path& path);
+		void stopCapture();
+		bool isCapturing() const { return m_capture && BinaryLog::GetActive() == m_capture.get(); }
+		// Decodes a capture into the console
+		void replayCapture(const std::filesystem::path& path);
+
+		// Scene save/load timings at 10k and 1M instances for both formats, logged. Blocks.
+		void runSceneBenchmark();
+
+		// Writes the next rendered frame to a binary PPM once the Renderer has read it back
+		void saveScreenshot(const std::filesystem::path& path);
 	private:
 		void renderServicesWindow();
 		void renderConsoleWindow();
 		void renderCameraWindow();
+		// Shows the Renderer's framebuffer in a dockable window instead of behind everything
+		void renderSceneWindow();
 
 		ImGuiConsole m_console;
-		std::shared_ptr<CustomSink> m_customSink;
+		std::shared_ptr<spdlog::sinks::sink> m_consoleSink;
+		std::shared_ptr<AsyncConsoleSink> m_asyncSink; // null in sync mode
+
+		// Kept alive after stopping, a thread may still be finishing a write into it. Replaced
+		// captures are retired and only freed once a whole frame has passed since they stopped.
+		std::unique_ptr<BinaryLog> m_capture;
+		std::vector<std::pair<std::unique_ptr<BinaryLog>, std::uint64_t>> m_retiredCaptures; // and the frame they stopped in
+		std::uint64_t m_captureStoppedFrame = 0;
+		std::uint64_t m_frameIndex = 0;
+		std::string m_capturePath = "lunatic_capture.lbl";
 		
 		// Service debug controls
 		std::unordered_map<std::string, bool> m_autoUpdateMap;
@@ -65,5 +120,7 @@ namespace Lunatic::Services {
 		bool m_showConsole = true;
 		bool m_showScripting = false;
 		bool m_showCamera = false;
+		bool m_showScene = false;
+		bool m_sceneSizedToPanel = false; // the Renderer draws at the Scene panel's size
 	};
 } // namespace Lunatic::Services
@@ -0,0 +1,432 @@
+#include "pch.h"
+
+#include "mesh_cache.h"
+
+using namespace Lunatic;
+using namespace Lunatic::Services;
+
+std::atomic<MeshCache*> MeshCache::sm_active = nullptr;
+
+static constexpr std::uint32_t INITIAL_VERTEX_CAPACITY = 64 * 1024;
+static constexpr std::uint32_t INITIAL_INDEX_CAPACITY = 192 * 1024;
+
+// MeshHandle
+
+MeshHandle::MeshHandle(const MeshHandle& other) : m_id(other.m_id) {
+	if (m_id != INVALID_ID) Services::MeshCache::AddRef(m_id);
+}
+
+MeshHandle::MeshHandle(MeshHandle&& other) noexcept : m_id(std::exchange(other.m_id, INVALID_ID)) {}
+
+MeshHandle& MeshHandle::operator=(const MeshHandle& other) {
+	if (this != &other) {
+		if (other.m_id != INVALID_ID) Services::MeshCache::AddRef(other.m_id);
+		reset();
+		m_id = other.m_id;
+	}
+	return *this;
+}
+
+MeshHandle& MeshHandle::operator=(MeshHandle&& other) noexcept {
+	if (this != &other) {
+		reset();
+		m_id = std::exchange(other.m_id, INVALID_ID);
+	}
+	return *this;
+}
+
+MeshHandle::~MeshHandle() {
+	reset();
+}
+
+void MeshHandle::reset() {
+	if (m_id != INVALID_ID) Services::MeshCache::Release(std::exchange(m_id, INVALID_ID));
+}
+
+// RangeAllocator
+
+std::optional<std::uint32_t> MeshCache::RangeAllocator::allocate(std::uint32_t count) {
+	for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+		auto [offset, available] = *it;
+		if (available < count) continue;
+
+		m_free.erase(it);
+		if (available > count) m_free.emplace(offset + count, available - count);
+		return offset;
+	}
+	return std::nullopt;
+}
+
+void MeshCache::RangeAllocator::free(std::uint32_t offset, std::uint32_t count) {
+	auto next = m_free.lower_bound(offset);
+
+	// Merge with the range right after
+	if (next != m_free.end() && offset + count == next->first) {
+		count += next->second;
+		next = m_free.erase(next);
+	}
+
+	// And with the range right before
+	if (next != m_free.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			previous->second += count;
+			return;
+		}
+	}
+
+	m_free.emplace_hint(next, offset, count);
+}
+
+void MeshCache::RangeAllocator::extend(std::uint32_t oldCapacity, std::uint32_t newCapacity) {
+	free(oldCapacity, newCapacity - oldCapacity);
+}
+
+// MeshCache
+
+MeshCache::MeshCache() : Service("MeshCache"), m_refCounts(std::make_unique<std::atomic<std::uint32_t>[]>(MAX_MESHES)) {
+	LUN_ASSERT(sm_active.load() == nullptr, "Only one MeshCache may exist")
+
+	growIndices(INITIAL_INDEX_CAPACITY);
+	arenaFor(VertexLayout::Standard());
+
+	sm_active.store(this, std::memory_order_release);
+}
+
+MeshCache::~MeshCache() {
+	// Handles held by statics outlive the cache, their releases become no-ops from here on
+	sm_active.store(nullptr, std::memory_order_release);
+
+	for (VertexArena& arena : m_arenas) {
+		glDeleteVertexArrays(1, &arena.vao);
+		glDeleteBuffers(1, &arena.vbo);
+	}
+	glDeleteBuffers(1, &m_ebo);
+}
+
+void MeshCache::update(float deltaTime) {
+	commitLoaded();
+}
+
+void MeshCache::endFrame() {
+	std::vector<std::uint32_t> released;
+	{
+		std::lock_guard lock(m_releasedMutex);
+		released.swap(m_released);
+	}
+
+	for (std::uint32_t id : released) {
+		// create() may have handed the mesh out again since it dropped to zero
+		if (m_meshes[id].live && m_refCounts[id].load(std::memory_order_acquire) == 0) {
+			destroyMesh(id);
+		}
+	}
+}
+
+void MeshCache::AddRef(std::uint32_t id) {
+	if (MeshCache* cache = sm_active.load(std::memory_order_acquire)) {
+		cache->m_refCounts[id].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void MeshCache::Release(std::uint32_t id) {
+	MeshCache* cache = sm_active.load(std::memory_order_acquire);
+	if (!cache) return;
+
+	if (cache->m_refCounts[id].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		std::lock_guard lock(cache->m_releasedMutex);
+		cache->m_released.push_back(id);
+	}
+}
+
+std::uint64_t MeshCache::hashContent(const VertexLayout& layout, std::span<const std::byte> vertices, std::span<const std::uint32_t> indices) {
+	std::hash<std::string_view> hasher;
+	std::uint64_t hash = layout.getKey();
+	auto combine = [&hash](std::uint64_t value) {
+		hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+		};
+	combine(hasher({ reinterpret_cast<const char*>(vertices.data()), vertices.size_bytes() }));
+	combine(hasher({ reinterpret_cast<const char*>(indices.data()), indices.size_bytes() }));
+	return hash;
+}
+
+glm::vec4 MeshCache::computeBounds(const VertexLayout& layout, std::span<const std::byte> vertices) {
+	const VertexAttribute* position = layout.find(0);
+	if (!position) return glm::vec4(0.0f);
+
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(std::numeric_limits<float>::lowest());
+	for (std::size_t offset = position->offset; offset < vertices.size(); offset += layout.getStride()) {
+		glm::vec3 point(0.0f);
+		VertexLayout::Decode(position->format, vertices.data() + offset, &point.x);
+		minimum = glm::min(minimum, point);
+		maximum = glm::max(maximum, point);
+	}
+
+	return glm::vec4((minimum + maximum) * 0.5f, glm::length(maximum - minimum) * 0.5f);
+}
+
+std::uint32_t MeshCache::arenaFor(const VertexLayout& layout) {
+	for (std::uint32_t i = 0; i < m_arenas.size(); ++i) {
+		if (m_arenas[i].layout == layout) return i;
+	}
+
+	VertexArena& arena = m_arenas.emplace_back();
+	arena.layout = layout;
+	glCreateVertexArrays(1, &arena.vao);
+	layout.apply(arena.vao, 0);
+	glVertexArrayElementBuffer(arena.vao, m_ebo);
+	growVertices(arena, INITIAL_VERTEX_CAPACITY);
+
+	m_stats.layoutCount = m_arenas.size();
+	return static_cast<std::uint32_t>(m_arenas.size() - 1);
+}
+
+std::uint32_t MeshCache::allocateId() {
+	if (!m_freeIds.empty()) {
+		std::uint32_t id = m_freeIds.back();
+		m_freeIds.pop_back();
+		return id;
+	}
+
+	LUN_ASSERT(m_meshes.size() < MAX_MESHES, "Too many meshes")
+	m_meshes.emplace_back();
+	return static_cast<std::uint32_t>(m_meshes.size() - 1);
+}
+
+void MeshCache::upload(std::uint32_t id, std::uint32_t arenaIndex, std::span<const std::byte> vertices, std::span<const std::uint32_t> indices) {
+	VertexArena& arena = m_arenas[arenaIndex];
+	const std::uint32_t stride = arena.layout.getStride();
+	auto vertexCount = static_cast<std::uint32_t>(vertices.size() / stride);
+	auto indexCount = static_cast<std::uint32_t>(indices.size());
+
+	auto baseVertex = arena.ranges.allocate(vertexCount);
+	if (!baseVertex) {
+		growVertices(arena, vertexCount);
+		baseVertex = arena.ranges.allocate(vertexCount);
+	}
+	auto firstIndex = m_indexRanges.allocate(indexCount);
+	if (!firstIndex) {
+		growIndices(indexCount);
+		firstIndex = m_indexRanges.allocate(indexCount);
+	}
+
+	glNamedBufferSubData(arena.vbo, GLintptr(*baseVertex) * stride, vertices.size_bytes(), vertices.data());
+	glNamedBufferSubData(m_ebo, *firstIndex * sizeof(std::uint32_t), indices.size_bytes(), indices.data());
+
+	Mesh& mesh = m_meshes[id];
+	mesh.arena = arenaIndex;
+	mesh.baseVertex = *baseVertex;
+	mesh.vertexCount = vertexCount;
+	mesh.firstIndex = *firstIndex;
+	mesh.indexCount = indexCount;
+	mesh.bounds = computeBounds(arena.layout, vertices);
+
+	m_stats.vertexCount += vertexCount;
+	m_stats.vertexBytes += vertices.size_bytes();
+	m_stats.indexCount += indexCount;
+}
+
+MeshHandle MeshCache::create(std::span<const float> vertices, std::span<const std::uint32_t> indices) {
+	return create(VertexLayout::Standard(), std::as_bytes(vertices), indices);
+}
+
+MeshHandle MeshCache::create(const VertexLayout& layout, std::span<const std::byte> vertices, std::span<const std::uint32_t> indices) {
+	LUN_ASSERT(layout.getStride() > 0 && vertices.size() % layout.getStride() == 0, "Vertex data must be whole vertices")
+	LUN_ASSERT(!vertices.empty() && !indices.empty(), "Meshes can't be empty")
+
+	// A 64-bit hash colliding on geometry of the exact same size is not worth a readback
+	std::uint64_t hash = hashContent(layout, vertices, indices);
+	if (auto it = m_byHash.find(hash); it != m_byHash.end()) {
+		const Mesh& mesh = m_meshes[it->second];
+		if (m_arenas[mesh.arena].layout == layout && mesh.vertexCount == vertices.size() / layout.getStride() && mesh.indexCount == indices.size()) {
+			m_refCounts[it->second].fetch_add(1, std::memory_order_relaxed);
+			++m_stats.dedupHits;
+			return MeshHandle(it->second);
+		}
+	}
+
+	std::uint32_t arena = arenaFor(layout);
+	std::uint32_t id = allocateId();
+	upload(id, arena, vertices, indices);
+	m_meshes[id].hash = hash;
+	m_meshes[id].live = true;
+	m_byHash[hash] = id;
+	m_refCounts[id].store(1, std::memory_order_relaxed);
+	++m_stats.meshCount;
+
+	return MeshHandle(id);
+}
+
+MeshHandle MeshCache::load(const std::filesystem::path& source) {
+	std::string key = source.lexically_normal().generic_string();
+	if (auto it = m_bySource.find(key); it != m_bySource.end()) {
+		m_refCounts[it->second].fetch_add(1, std::memory_order_relaxed);
+		return MeshHandle(it->second);
+	}
+
+	std::uint32_t id = allocateId();
+	std::uint64_t ticket = m_nextTicket++;
+	Mesh& mesh = m_meshes[id];
+	mesh.live = true;
+	mesh.ticket = ticket;
+	mesh.source = key;
+	m_bySource.emplace(std::move(key), id);
+	m_refCounts[id].store(1, std::memory_order_relaxed);
+	++m_stats.meshCount;
+	++m_stats.pendingLoads;
+
+	m_pool.submit([this, id, ticket, source] {
+		LoadedMesh loaded{ .id = id, .ticket = ticket };
+		auto start = std::chrono::steady_clock::now();
+		try {
+			loaded.cooked = MeshAsset::Load(source);
+		}
+		catch (const std::exception& e) {
+			loaded.error = e.what();
+		}
+		loaded.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard lock(m_loadedMutex);
+		m_loaded.push_back(std::move(loaded));
+		});
+
+	return MeshHandle(id);
+}
+
+void MeshCache::commitLoaded() {
+	std::vector<LoadedMesh> loaded;
+	{
+		std::lock_guard lock(m_loadedMutex);
+		loaded.swap(m_loaded);
+	}
+
+	for (LoadedMesh& result : loaded) {
+		--m_stats.pendingLoads;
+
+		// Every handle may have been dropped meanwhile, and the id handed out again
+		Mesh& mesh = m_meshes[result.id];
+		if (!mesh.live || mesh.ticket != result.ticket) continue;
+		mesh.ticket = 0;
+
+		if (!result.error.empty()) {
+			spdlog::error("[MeshCache] Failed to load {}: {}", mesh.source, result.error);
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		upload(result.id, arenaFor(result.cooked.layout), result.cooked.vertices, result.cooked.indices);
+		m_stats.lastLoadMs = result.loadMs;
+		m_stats.lastUploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		spdlog::info("[MeshCache] Loaded {} ({} vertices, {} triangles) in {:.2f} ms, upload {:.2f} ms",
+			mesh.source, mesh.vertexCount, mesh.indexCount / 3, m_stats.lastLoadMs, m_stats.lastUploadMs);
+	}
+}
+
+void MeshCache::destroyMesh(std::uint32_t id) {
+	Mesh& mesh = m_meshes[id];
+
+	// Meshes still loading have no ranges yet
+	if (mesh.vertexCount > 0) {
+		m_arenas[mesh.arena].ranges.free(mesh.baseVertex, mesh.vertexCount);
+		m_indexRanges.free(mesh.firstIndex, mesh.indexCount);
+	}
+	if (!mesh.source.empty()) {
+		m_bySource.erase(mesh.source);
+	}
+	else if (auto it = m_byHash.find(mesh.hash); it != m_byHash.end() && it->second == id) {
+		m_byHash.erase(it);
+	}
+
+	--m_stats.meshCount;
+	m_stats.vertexCount -= mesh.vertexCount;
+	m_stats.vertexBytes -= std::size_t(mesh.vertexCount) * m_arenas[mesh.arena].layout.getStride();
+	m_stats.indexCount -= mesh.indexCount;
+
+	mesh = Mesh{};
+	m_freeIds.push_back(id);
+}
+
+void MeshCache::growVertices(VertexArena& arena, std::uint32_t required) {
+	const GLsizeiptr stride = arena.layout.getStride();
+	std::uint32_t oldCapacity = arena.capacity;
+	std::uint32_t newCapacity = std::max(oldCapacity * 2, oldCapacity + required);
+
+	GLuint buffer;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferData(buffer, newCapacity * stride, nullptr, GL_STATIC_DRAW);
+	if (arena.vbo) {
+		glCopyNamedBufferSubData(arena.vbo, buffer, 0, 0, oldCapacity * stride);
+		glDeleteBuffers(1, &arena.vbo);
+		++m_stats.arenaGrowths;
+	}
+
+	arena.vbo = buffer;
+	arena.capacity = newCapacity;
+	arena.ranges.extend(oldCapacity, newCapacity);
+	m_stats.vertexCapacityBytes += (newCapacity - oldCapacity) * stride;
+	glVertexArrayVertexBuffer(arena.vao, 0, arena.vbo, 0, static_cast<GLsizei>(stride));
+}
+
+void MeshCache::growIndices(std::uint32_t required) {
+	std::uint32_t oldCapacity = m_indexCapacity;
+	std::uint32_t newCapacity = std::max(oldCapacity * 2, oldCapacity + required);
+
+	GLuint buffer;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferData(buffer, newCapacity * sizeof(std::uint32_t), nullptr, GL_STATIC_DRAW);
+	if (m_ebo) {
+		glCopyNamedBufferSubData(m_ebo, buffer, 0, 0, oldCapacity * sizeof(std::uint32_t));
+		glDeleteBuffers(1, &m_ebo);
+		++m_stats.arenaGrowths;
+	}
+
+	m_ebo = buffer;
+	m_indexCapacity = newCapacity;
+	m_stats.indexCapacity = newCapacity;
+	m_indexRanges.extend(oldCapacity, newCapacity);
+	for (VertexArena& arena : m_arenas) {
+		glVertexArrayElementBuffer(arena.vao, m_ebo);
+	}
+}
+
+void MeshCache::bind() const {
+	bind(0);
+}
+
+void MeshCache::bind(std::uint32_t arena) const {
+	glBindVertexArray(m_arenas[arena].vao);
+	m_boundArena = arena;
+}
+
+void MeshCache::draw(const MeshHandle& mesh) const {
+	draw(mesh.getId());
+}
+
+void MeshCache::draw(std::uint32_t id) const {
+	const Mesh& entry = m_meshes[id];
+	if (entry.indexCount == 0) return; // Still loading, or the load failed
+
+	if (entry.arena != m_boundArena) {
+		glBindVertexArray(m_arenas[entry.arena].vao);
+		m_boundArena = entry.arena;
+	}
+
+	glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(entry.indexCount), GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>(static_cast<std::uintptr_t>(entry.firstIndex) * sizeof(std::uint32_t)),
+		static_cast<GLint>(entry.baseVertex));
+}
+
+std::uint32_t MeshCache::getIndexCount(const MeshHandle& mesh) const {
+	return m_meshes[mesh.getId()].indexCount;
+}
+
+std::uint32_t MeshCache::getArena(const MeshHandle& mesh) const {
+	return m_meshes[mesh.getId()].arena;
+}
+
+MeshCache::DrawRange MeshCache::getDrawRange(std::uint32_t id) const {
+	const Mesh& entry = m_meshes[id];
+	return DrawRange{ entry.indexCount, entry.firstIndex, entry.baseVertex, entry.bounds };
+}
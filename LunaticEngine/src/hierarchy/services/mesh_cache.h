@@ -0,0 +1,202 @@
+#pragma once
+
+#include "../base.h"
+
+#include "core/thread_pool.h"
+#include "render/mesh_asset.h"
+#include "render/vertex_layout.h"
+
+#include <map>
+#include <optional>
+
+namespace Lunatic {
+	namespace Services { class MeshCache; }
+
+	/// <summary>
+	/// Counted reference to a mesh in the MeshCache, empty by default. The mesh stays resident
+	/// while any handle to it exists. Handles can be copied and dropped on any thread, the
+	/// geometry itself is freed on the main thread at the end of the frame.
+	/// </summary>
+	class MeshHandle {
+	public:
+		static constexpr std::uint32_t INVALID_ID = std::numeric_limits<std::uint32_t>::max();
+
+		MeshHandle() = default;
+		MeshHandle(const MeshHandle& other);
+		MeshHandle(MeshHandle&& other) noexcept;
+		MeshHandle& operator=(const MeshHandle& other);
+		MeshHandle& operator=(MeshHandle&& other) noexcept;
+		~MeshHandle();
+
+		explicit operator bool() const { return m_id != INVALID_ID; }
+		std::uint32_t getId() const { return m_id; }
+		void reset();
+
+	private:
+		friend class Services::MeshCache;
+
+		explicit MeshHandle(std::uint32_t id) : m_id(id) {} // Adopts a reference already counted
+
+		std::uint32_t m_id = INVALID_ID;
+	};
+} // namespace Lunatic
+
+namespace Lunatic::Services {
+	/// <summary>
+	/// Owns the geometry of every mesh. Meshes with the same VertexLayout share one vertex
+	/// arena and one VAO, all of them share one index arena. Each mesh is a range in both drawn
+	/// with a base vertex, so switching between meshes of a layout costs no binds. Identical
+	/// geometry is uploaded once, meshes are deduplicated by a hash of their content. Arenas
+	/// grow by copying on the GPU when a mesh doesn't fit.
+	///
+	/// Mesh files are imported or opened cooked on a worker and uploaded on the main thread.
+	/// Their handles are valid right away and draw nothing until the geometry arrived.
+	/// </summary>
+	class MeshCache : public Service {
+	public:
+		static constexpr std::size_t VERTEX_FLOATS = 8; // per vertex in VertexLayout::Standard()
+		static constexpr std::uint32_t MAX_MESHES = 65536;
+
+		struct Stats {
+			std::size_t meshCount = 0;
+			std::size_t vertexCount = 0;    // in use, over all meshes
+			std::size_t vertexBytes = 0;
+			std::size_t indexCount = 0;
+			std::size_t vertexCapacityBytes = 0; // of the arenas
+			std::size_t indexCapacity = 0;
+			std::size_t layoutCount = 0;
+			std::size_t dedupHits = 0;
+			std::size_t arenaGrowths = 0;
+			std::size_t pendingLoads = 0;
+			double lastLoadMs = 0.0;   // worker time for the latest file, import included if it was stale
+			double lastUploadMs = 0.0; // main thread time for it
+		};
+
+		MeshCache();
+		~MeshCache() override;
+
+		void update(float deltaTime) override;
+		void endFrame() override;
+
+		// Uploads the mesh, or returns another reference to identical geometry already cached.
+		// Main thread only, like everything touching GL here.
+		MeshHandle create(const VertexLayout& layout, std::span<const std::byte> vertices, std::span<const std::uint32_t> indices);
+		// Same in VertexLayout::Standard()
+		MeshHandle create(std::span<const float> vertices, std::span<const std::uint32_t> indices);
+		// Loads a mesh file through MeshAsset::Load, one mesh per file however often it's requested
+		MeshHandle load(const std::filesystem::path& source);
+
+		// Where a mesh lies in the arenas, for building indirect draws. Empty while loading.
+		struct DrawRange {
+			std::uint32_t indexCount = 0;
+			std::uint32_t firstIndex = 0;
+			std::uint32_t baseVertex = 0;
+			glm::vec4 bounds{ 0.0f }; // local bounding sphere, center and radius
+		};
+
+		// Binds the standard layout's VAO, once before drawing any number of meshes. Meshes in
+		// another layout bind theirs as needed, so nothing else may bind a VAO until the last draw.
+		void bind() const;
+		// Binds one arena's VAO, draw() keeps track of it like of bind()'s
+		void bind(std::uint32_t arena) const;
+		// Draws the whole mesh, after bind()
+		void draw(const MeshHandle& mesh) const;
+		// Same by MeshHandle::getId(), some handle has to keep the mesh alive until then
+		void draw(std::uint32_t id) const;
+
+		std::uint32_t getIndexCount(const MeshHandle& mesh) const;
+		// The vertex arena, and so the VAO, the mesh is drawn through. Arena 0 is bind()'s.
+		std::uint32_t getArena(const MeshHandle& mesh) const;
+		// By MeshHandle::getId(), like draw()
+		DrawRange getDrawRange(std::uint32_t id) const;
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		friend class Lunatic::MeshHandle;
+
+		// First-fit ranges of one arena, adjacent free ranges are merged
+		class RangeAllocator {
+		public:
+			std::optional<std::uint32_t> allocate(std::uint32_t count);
+			void free(std::uint32_t offset, std::uint32_t count);
+			// Appends [oldCapacity, newCapacity) as free space
+			void extend(std::uint32_t oldCapacity, std::uint32_t newCapacity);
+
+		private:
+			std::map<std::uint32_t, std::uint32_t> m_free; // offset -> count
+		};
+
+		// Vertices of one layout, drawn through its own VAO
+		struct VertexArena {
+			VertexLayout layout;
+			GLuint vao = 0;
+			GLuint vbo = 0;
+			std::uint32_t capacity = 0; // in vertices
+			RangeAllocator ranges;
+		};
+
+		struct Mesh {
+			std::uint64_t hash = 0;
+			std::uint32_t arena = 0;
+			std::uint32_t baseVertex = 0;
+			std::uint32_t vertexCount = 0;
+			std::uint32_t firstIndex = 0;
+			std::uint32_t indexCount = 0;
+			glm::vec4 bounds{ 0.0f };  // local bounding sphere, center and radius
+			bool live = false;
+			std::uint64_t ticket = 0; // of the file load filling it, 0 once resident
+			std::string source;       // for meshes loaded from a file
+		};
+
+		// Opened on a worker, waiting for the main thread
+		struct LoadedMesh {
+			std::uint32_t id = 0;
+			std::uint64_t ticket = 0;
+			MeshAsset::Cooked cooked;
+			double loadMs = 0.0;
+			std::string error;
+		};
+
+		static std::atomic<MeshCache*> sm_active; // what handles report to, null once destroyed
+
+		std::vector<VertexArena> m_arenas; // the standard layout first
+		mutable std::uint32_t m_boundArena = 0;
+		GLuint m_ebo = 0;
+		std::uint32_t m_indexCapacity = 0;
+		RangeAllocator m_indexRanges;
+
+		std::vector<Mesh> m_meshes; // main thread only
+		std::vector<std::uint32_t> m_freeIds;
+		std::unordered_map<std::uint64_t, std::uint32_t> m_byHash;
+		std::unordered_map<std::string, std::uint32_t> m_bySource;
+		std::uint64_t m_nextTicket = 1;
+
+		// Sized MAX_MESHES up front so handles on other threads never see it move
+		std::unique_ptr<std::atomic<std::uint32_t>[]> m_refCounts;
+
+		std::mutex m_releasedMutex;
+		std::vector<std::uint32_t> m_released; // dropped to zero references, freed in endFrame
+
+		std::mutex m_loadedMutex;
+		std::vector<LoadedMesh> m_loaded;
+
+		Stats m_stats;
+
+		ThreadPool m_pool; // last, so workers are joined before anything they touch is destroyed
+
+		static void AddRef(std::uint32_t id);
+		static void Release(std::uint32_t id);
+
+		// Sphere around the box of the positions at location 0
+		static glm::vec4 computeBounds(const VertexLayout& layout, std::span<const std::byte> vertices);
+		static std::uint64_t hashContent(const VertexLayout& layout, std::span<const std::byte> vertices, std::span<const std::uint32_t> indices);
+
+		std::uint32_t arenaFor(const VertexLayout& layout);
+		void growVertices(VertexArena& arena, std::uint32_t required);
+		void growIndices(std::uint32_t required);
+		std::uint32_t allocateId();
+		void upload(std::uint32_t id, std::uint32_t arena, std::span<const std::byte> vertices, std::span<const std::uint32_t> indices);
+		void commitLoaded();
+		void destroyMesh(std::uint32_t id);
+	};
+} // namespace Lunatic::Services
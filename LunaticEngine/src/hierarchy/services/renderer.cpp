@@ -2,6 +2,7 @@
 
 #include "renderer.h"
 #include "workspace.h"
+#include "mesh_cache.h"
 
 #include "core/engine.h"
 
@@ -16,21 +17,10 @@ void GLAPIENTRY openglDebugCallback(GLenum source, GLenum type, GLuint id, GLenu
 
 using namespace Lunatic::Services;
 
-// Quad vertices
-std::array<float, 12> quadVertices = {
-	-1.0f, -1.0f, 0.0f, // Bottom-left
-	 1.0f, -1.0f, 0.0f, // Bottom-right
-	-1.0f,  1.0f, 0.0f, // Top-left
-	 1.0f,  1.0f, 0.0f  // Top-right
-};
-
-// Quad indices
-std::array<unsigned int, 6> quadIndices = {
-	0, 1, 2, // First triangle
-	1, 3, 2  // Second triangle
-};
-
-Renderer::Renderer() : Service("Renderer") {
+static constexpr std::int32_t SCENE_SAMPLES = 4;
+
+Renderer::Renderer() : Service("Renderer"),
+	m_framebuffer({ .size = glm::ivec2(Engine::GetInstance().getWindowSize()), .samples = SCENE_SAMPLES }) {
 #ifdef _DEBUG
     GLint flags; glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
     if (flags & GL_CONTEXT_FLAG_DEBUG_BIT) {
@@ -49,10 +39,6 @@ Renderer::Renderer() : Service("Renderer") {
 	glDepthFunc(GL_LESS);
 
 	m_camera.setFOV(45.0f);
-	m_buffers.uploadData(std::span<float>(quadVertices.data(), quadVertices.size()),
-		std::span<unsigned int>(quadIndices.data(), quadIndices.size()));
-	m_buffers.bind(); // Ensure VAO is bound before setting attribute
-	m_buffers.setAttribute(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
 }
 
 void Renderer::update(float deltatime) {
@@ -60,45 +46,104 @@ void Renderer::update(float deltatime) {
 }
 
 void Renderer::render() {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (m_pendingSize) {
+		m_camera.resize(m_pendingSize->x, m_pendingSize->y);
+		m_framebuffer.resize(*m_pendingSize);
+		m_pendingSize.reset();
+	}
+
 	const auto& bgColor = m_camera.getBackgroundColor();
 	glClearColor(bgColor.r, bgColor.g, bgColor.b, 1.0f);
+	m_framebuffer.bind();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	m_shader.use();
-	m_shader.set("u_viewProjection", m_camera.getViewProjection());
 	static auto workspace = ServiceLocator::Get<Services::Workspace>("Workspace");
-	auto instances = workspace->getInstances();
-
-	std::function<void(std::shared_ptr<Instance>, glm::mat4)> renderInstance;
-	renderInstance = [&](std::shared_ptr<Instance> instance, glm::mat4 parentTransform) {
-		// Start with the parent's transformation matrix
-		glm::mat4 model = parentTransform;
-		
-		// Apply this instance's local transformations
-		model = glm::translate(model, instance->position);
+	static auto meshCache = ServiceLocator::Get<Services::MeshCache>("MeshCache");
+	const auto& instances = workspace->getInstances();
+
+	m_queue.begin(m_camera, m_multiDraw ? m_drawDataShader : m_shader, *meshCache);
+
+	// Depth first with an explicit stack, deep chains would overflow the call stack
+	m_traversal.clear();
+	for (auto it = instances.rbegin(); it != instances.rend(); ++it) {
+		m_traversal.push_back({ it->get(), glm::mat4(1.0f) });
+	}
+
+	while (!m_traversal.empty()) {
+		auto [instance, parentTransform] = m_traversal.back();
+		m_traversal.pop_back();
+
+		// Parent's transform first, then this instance's own
+		glm::mat4 model = glm::translate(parentTransform, instance->position);
 		model = glm::rotate(model, glm::radians(instance->rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
 		model = glm::rotate(model, glm::radians(instance->rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
 		model = glm::rotate(model, glm::radians(instance->rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
-		// Set model matrix and color for this instance
-		m_shader.set("u_model", model);
-		m_shader.set("u_color", glm::vec3(1.0f, 0.5f, 0.2f)); // Orange color for cubes
+		// The instance pushes its draws, nothing is drawn until the whole tree was visited
+		instance->enqueue(m_queue, model);
+
+		for (auto it = instance->children.rbegin(); it != instance->children.rend(); ++it) {
+			m_traversal.push_back({ it->get(), model });
+		}
+	}
+
+	// Sorted by shader, VAO, mesh and material. With multi-draw that is one call per VAO,
+	// otherwise only the model matrix changes between most draws.
+	m_queue.submit();
 
-		// Call the instance's render method (which will bind its own geometry and draw)
-		instance->render();
+	// Next frame's occlusion test runs against this frame's depth
+	if (m_queue.isGpuCulling()) {
+		m_queue.getCuller().captureDepth(m_framebuffer.getId(), m_framebuffer.getSize(), m_camera.getViewProjection());
+	}
 
-		// Render children recursively, passing the current transformation matrix
-		for (const auto& child : instance->children) {
-			renderInstance(child, model);
+	m_framebuffer.resolve();
+	for (CaptureCallback& callback : m_captureRequests) {
+		if (std::uint64_t request = m_framebuffer.requestReadback()) {
+			m_captures.emplace(request, std::move(callback));
 		}
-		};
+		else {
+			spdlog::warn("[Renderer] Too many captures in flight, one was dropped");
+		}
+	}
+	m_captureRequests.clear();
+
+	// A surfaceless context has no default framebuffer to draw into
+	if (Engine::GetInstance().isHeadless()) return;
+
+	// Everything after this, ImGui included, draws to the window
+	const glm::ivec2 windowSize(Engine::GetInstance().getWindowSize());
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, windowSize.x, windowSize.y);
+	if (m_presentToWindow) {
+		m_framebuffer.blitTo(0, windowSize);
+	}
+	else {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+}
+
+void Renderer::endFrame() {
+	while (auto capture = m_framebuffer.pollReadback()) {
+		auto it = m_captures.find(capture->request);
+		if (it == m_captures.end()) continue;
+
+		// Erased either way, a failed readback never comes back
+		CaptureCallback callback = std::move(it->second);
+		m_captures.erase(it);
+		if (capture->pixels.empty()) {
+			spdlog::warn("[Renderer] A capture could not be read back, it was dropped");
+			continue;
+		}
+		callback(*capture);
+	}
+}
 
-	for (const auto& instance : instances)
-		renderInstance(instance, glm::mat4(1.0f));
+void Renderer::requestCapture(CaptureCallback callback) {
+	m_captureRequests.push_back(std::move(callback));
 }
 
 void Renderer::resize(int width, int height) {
-	m_camera.resize(width, height);
+	m_pendingSize = glm::ivec2(width, height);
 }
 
 void Renderer::updateCameraControls(float deltaTime) {
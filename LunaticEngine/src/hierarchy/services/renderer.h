@@ -4,7 +4,10 @@
 
 #include "render/shader.h"
 #include "render/camera.h"
-#include "render/buffers.h"
+#include "render/render_queue.h"
+#include "render/framebuffer.h"
+
+#include <optional>
 
 namespace Lunatic::Services {	class Renderer : public Service {
 	public:
@@ -13,17 +16,47 @@ namespace Lunatic::Services {	class Renderer : public Service {
 
 		void update(float deltaTime) override;
 		void render() override;
+		void endFrame() override;
 
+		// Resizes the camera and the scene framebuffer when the next frame starts, so the
+		// current color texture stays valid for ImGui until then. The last call wins.
 		void resize(int width, int height);
 		// Camera access methods
 		Camera& getCamera() { return m_camera; }
 		const Camera& getCamera() const { return m_camera; }
+
+		// Draws through multi-draw indirect and the DrawData shader, on by default
+		void setMultiDraw(bool enabled) { m_multiDraw = enabled; }
+		bool isMultiDraw() const { return m_multiDraw; }
+
+		RenderQueue& getQueue() { return m_queue; }
+		const RenderQueue& getQueue() const { return m_queue; }
+
+		// The scene is drawn into this, its color texture can be shown in an ImGui window
+		const Framebuffer& getFramebuffer() const { return m_framebuffer; }
+		// Blits the scene to the window after drawing it, on by default. Off when a panel shows it.
+		void setPresentToWindow(bool enabled) { m_presentToWindow = enabled; }
+		bool isPresentToWindow() const { return m_presentToWindow; }
+
+		// Reads the next frame back without stalling, callback runs on the main thread a few
+		// frames later, from endFrame()
+		using CaptureCallback = std::function<void(const Framebuffer::Capture& capture)>;
+		void requestCapture(CaptureCallback callback);
 	private:
 		void updateCameraControls(float deltaTime);
 
 		Camera m_camera;
-		Buffers m_buffers;
 		Shader m_shader;
+		Shader m_drawDataShader{ Shader::Builtin::DrawData };
+		RenderQueue m_queue;
+		std::vector<std::pair<Instance*, glm::mat4>> m_traversal; // kept for its capacity
+		bool m_multiDraw = true;
+
+		Framebuffer m_framebuffer;
+		std::optional<glm::ivec2> m_pendingSize;
+		bool m_presentToWindow = true;
+		std::vector<CaptureCallback> m_captureRequests;                   // until the next frame is drawn
+		std::unordered_map<std::uint64_t, CaptureCallback> m_captures;    // by readback request
 
 		// Camera control state
 		bool m_cameraControlEnabled = false;
@@ -4,213 +4,170 @@
 
 using namespace Lunatic::Services;
 
-const char* LUA_COROUTINE_SYSTEM = R"CORO(
--- Script runner factory (always wraps the script, basically so that it is in a coroutine)
-function create_script_runner(script_code, name)
-    name = name or "Script"
-
-    -- Always wrap the code in a function, assume the user isn't stupid
-    local wrapped_code = "return function()\n" .. script_code .. "\nend"
-
-    -- Compile the wrapped code
-    local chunk, err = loadstring(wrapped_code, name)
-    if not chunk then
-        error("Compilation error: " .. err)
-    end
-
-    -- Execute to get the main function
-    local success, main_func = pcall(chunk)
-    if not success then
-        error("Execution error: " .. main_func)
-    end
-
-    if type(main_func) ~= "function" then
-        error("Script must return a function")
-    end
-
-    -- Create the coroutine
-    local co = coroutine.create(main_func)
-
-    -- Return the runner function
-    return function()
-        if coroutine.status(co) == "dead" then
-            return false, 0, nil
-        end
-
-        local status, waitTime = coroutine.resume(co)
-
-        if not status then
-            return false, 0, waitTime -- err
-        end
-
-        if coroutine.status(co) == "suspended" then
-            return true, waitTime or 0, nil
-        else
-            return false, 0, nil
-        end
-    end
-end
-
--- Standard wait function for use in scripts
-function wait(seconds)
-    return coroutine.yield(seconds or 0.01)
-end
-)CORO";
-
-Scripting::Scripting() : Service("Scripting") {
-	m_lua.open_libraries(
-		sol::lib::base,
-		sol::lib::math,
-		sol::lib::table,
-		sol::lib::string,
-		sol::lib::coroutine
-	);
-
-	// Initialize system time
-	m_currentTime = static_cast<float>(
+static float currentTimeSeconds() {
+	return static_cast<float>(
 		std::chrono::duration<double>(
 			std::chrono::steady_clock::now().time_since_epoch()
 		).count()
 		);
-
-	// Set up global logging functions
-	registerLogFuncsGlobal();
-
-	// Initialize coroutine runtime
-	initializeCoroutineRuntime();
 }
 
-void Scripting::initializeCoroutineRuntime() {
-	try {
-		// Load our coroutine system
-		sol::protected_function_result result = m_lua.safe_script(
-			LUA_COROUTINE_SYSTEM,
-			&sol::script_pass_on_error
-		);
+Scripting::Scripting(std::size_t workerVMs) : Service("Scripting") {
+	// Initialize system time
+	m_currentTime = currentTimeSeconds();
 
-		if (!result.valid()) {
-			sol::error err = result;
-			spdlog::error("[Scripting] Failed to initialize coroutine system: {}", err.what());
-		}
+	auto postToMain = [this](ScriptVM::MainThreadCall call) {
+		postToMainThread(std::move(call));
+		};
+
+	// VM 0 is ticked inline on the main thread, the rest get a worker each
+	m_vms.reserve(workerVMs + 1);
+	for (std::size_t i = 0; i <= workerVMs; ++i) {
+		m_vms.push_back(std::make_unique<ScriptVM>(i, i != 0, postToMain));
 	}
-	catch (const std::exception& e) {
-		spdlog::error("[Scripting] Exception during initialization: {}", e.what());
+
+	if (workerVMs > 0) {
+		spdlog::info("[Scripting] Sharding scripts across {} worker VMs", workerVMs);
 	}
+
+	m_watcher = std::make_unique<FileWatcher>([this](const std::filesystem::path& filepath) {
+		onFileChanged(filepath);
+		});
+}
+
+Scripting::~Scripting() {
+	// Join the watcher and the workers before anything they might post back to is torn down
+	m_watcher.reset();
+	m_vms.clear();
 }
 
 void Scripting::update(float deltaTime) {
 	try {
 		// Update current time
-		m_currentTime = static_cast<float>(
-			std::chrono::duration<double>(
-				std::chrono::steady_clock::now().time_since_epoch()
-			).count()
-			);
+		m_currentTime = currentTimeSeconds();
 
-		// Process each script
-		for (auto& [name, script] : m_scripts) {
-			// Skip scripts that are not running
-			if (!script.state.isRunning) continue;
+		// Run whatever the worker VMs handed back since the last frame
+		drainMainThreadCalls();
 
-			// Skip paused scripts
-			if (script.state.isPaused) continue;
+		// Swap in scripts that were saved since the last frame
+		applyPendingReloads();
 
-			// Skip scripts that are waiting
-			if (m_currentTime < script.state.waitUntil) continue;
+		ScriptFrame frame{
+			.time = m_currentTime,
+			.deltaTime = deltaTime,
+			.index = m_frameIndex++
+		};
 
-			// Skip invalid coroutines
-			if (!script.coroutine.valid()) {
-				script.state.isRunning = false;
-				script.state.error = "Invalid coroutine";
-				continue;
-			}
+		// Wake the workers first so they overlap with the inline VM
+		for (auto it = m_vms.rbegin(); it != m_vms.rend(); ++it) {
+			(*it)->kick(frame);
+		}
+	}
+	catch (std::exception& e) {
+		spdlog::error("[Scripting] Update error: {}", e.what());
+	}
+}
 
-			// Resume the coroutine
-			sol::protected_function_result result = script.coroutine();
+void Scripting::endFrame() {
+	// Idle time after the swap, this is where the main thread VM collects garbage
+	m_vms.front()->endFrame();
+}
 
-			if (!result.valid()) {
-				// Handle error
-				sol::error err = result;
-				script.state.isRunning = false;
-				script.state.error = err.what();
-				spdlog::error("[Scripting][{}] Error: {}", name, err.what());
-				continue;
-			}
+void Scripting::postToMainThread(ScriptVM::MainThreadCall call) {
+	std::lock_guard lock(m_mainThreadMutex);
+	m_mainThreadCalls.push_back(std::move(call));
+}
 
-			// Parse results (is_alive, wait_time, error_message)
-			bool isAlive = result[0];
-			float waitTime = result[1];
+void Scripting::drainMainThreadCalls() {
+	std::vector<ScriptVM::MainThreadCall> calls;
+	{
+		std::lock_guard lock(m_mainThreadMutex);
+		calls.swap(m_mainThreadCalls);
+	}
 
-			if (result[2].is<std::string>()) {
-				// Error occurred
-				script.state.isRunning = false;
-				script.state.error = result[2].get<std::string>();
-				spdlog::error("[Scripting][{}] Error: {}", name, script.state.error);
-				continue;
-			}
+	for (auto& call : calls) {
+		call();
+	}
+}
 
-			if (isAlive) {
-				// Script is still running, update wait time
-				script.state.waitUntil = m_currentTime + waitTime;
-			}
-			else {
-				// Script has finished
-				script.state.isRunning = false;
-				spdlog::info("[Scripting][{}] Script completed", name);
-			}
-		}
+void Scripting::onFileChanged(const std::filesystem::path& filepath) {
+	// Runs on the watcher thread, so the file is read here rather than in update()
+	if (!m_hotReload) return;
+
+	std::string code = loadFileToString(filepath.string());
+	if (code.empty()) return; // Mid-save truncation, the final write triggers another event
+
+	std::size_t codeHash = hashCode(code);
+
+	std::lock_guard lock(m_reloadMutex);
+	m_pendingReloads.push_back(PendingReload{
+		.filepath = filepath.string(),
+		.code = std::move(code),
+		.codeHash = codeHash
+		});
+}
+
+void Scripting::applyPendingReloads() {
+	std::vector<PendingReload> reloads;
+	{
+		std::lock_guard lock(m_reloadMutex);
+		reloads.swap(m_pendingReloads);
 	}
-	catch (std::exception& e) {
-		spdlog::error("[Scripting] Update error: {}", e.what());
+
+	if (!m_hotReload) return;
+
+	for (const auto& reload : reloads) {
+		reloadChanged(reload.filepath, reload.code, reload.codeHash);
 	}
 }
 
-void Scripting::runScript(const std::string& name, const std::string& code,
-	const std::string& filepath, bool fromFile) {
-	try {
-		// Create a new thread for this script
-		sol::thread scriptThread = sol::thread::create(m_lua.lua_state());
-		// Get a reference to the thread's state
-		sol::state_view threadState = scriptThread.state();
-		// Create an environment for the script
-		sol::environment env(threadState, sol::create, m_lua.globals());
-
-		// Add logging functions to the environment
-		registerLogFuncs(env);
-
-		// Create the script runner
-		sol::protected_function createRunner = m_lua["create_script_runner"];
-		sol::protected_function_result result = createRunner(code, name);
-
-		if (!result.valid()) {
-			sol::error err = result;
-			spdlog::error("[Scripting][{}] Failed to create script: {}", name, err.what());
-			return;
-		}
+void Scripting::reloadChanged(const std::string& filepath, const std::string& code, std::size_t codeHash) {
+	for (auto& [name, script] : m_scripts) {
+		if (!script.fromFile || script.codeHash == codeHash) continue;
+		if (FileWatcher::normalize(script.filepath) != filepath) continue;
 
-		sol::function runner = result;
-
-		// Store the script data
-		m_scripts[name] = ScriptData{
-			.thread = std::move(scriptThread),
-			.env = std::move(env),
-			.coroutine = sol::coroutine(threadState, runner),
-			.state = {
-				.isRunning = true,
-				.isPaused = false,
-				.waitUntil = 0.0f,
-				.error = ""
-			},
-			.code = code,
-			.filepath = filepath,
-			.fromFile = fromFile
-		};
+		spdlog::info("[Scripting][{}] Reloading changed file: {}", name, script.filepath);
+		runScript(name, code, script.filepath, true);
+	}
+}
 
-		spdlog::info("[Scripting] Successfully loaded script: {}", name);
+std::size_t Scripting::pickVM() const {
+	if (m_vms.size() == 1) return 0;
+
+	// Least loaded worker, VM 0 is kept free for the main thread
+	std::vector<std::size_t> load(m_vms.size(), 0);
+	for (const auto& [_, entry] : m_scripts) {
+		++load[entry.vm];
 	}
-	catch (const std::exception& e) {
-		spdlog::error("[Scripting][{}] Exception during script loading: {}", name, e.what());
+
+	std::size_t best = 1;
+	for (std::size_t i = 2; i < load.size(); ++i) {
+		if (load[i] < load[best]) best = i;
 	}
+	return best;
+}
+
+void Scripting::runScript(const std::string& name, const std::string& code,
+	const std::string& filepath, bool fromFile) {
+	// A script keeps its VM across updates, new scripts go to the least loaded one
+	auto it = m_scripts.find(name);
+	std::size_t vm = it != m_scripts.end() ? it->second.vm : pickVM();
+
+	// Watch the new source before dropping the old one, they are usually the same file
+	if (fromFile) m_watcher->watch(filepath);
+	if (it != m_scripts.end() && it->second.fromFile) m_watcher->unwatch(it->second.filepath);
+
+	m_scripts[name] = ScriptEntry{
+		.vm = vm,
+		.code = code,
+		.filepath = filepath,
+		.fromFile = fromFile,
+		.codeHash = hashCode(code)
+	};
+
+	m_vms[vm]->post([name, code](ScriptVM& target) {
+		target.runScript(name, code);
+		});
 }
 
 void Scripting::loadScript(const std::string& name, const std::string& code) {
@@ -227,11 +184,10 @@ void Scripting::loadScriptFile(const std::string& name, const std::string& filep
 }
 
 void Scripting::exec(const std::string& code) {
-	sol::protected_function_result result = m_lua.safe_script(code, &sol::script_pass_on_error);
-	if (!result.valid()) {
-		sol::error err = result;
-		spdlog::error("[Scripting] exec error: {}", err.what());
-	}
+	// VM 0 lives on the main thread, so the code runs before exec returns
+	m_vms.front()->runInline([&code](ScriptVM& target) {
+		target.exec(code);
+		});
 }
 
 void Scripting::execFile(const std::string& filepath) {
@@ -244,10 +200,10 @@ void Scripting::execFile(const std::string& filepath) {
 }
 
 void Scripting::reloadAll() {
-	auto backup = m_scripts;
-	m_scripts.clear();
+	// Restarts every script, file scripts are read from disk again first
+	for (const auto& name : getScriptNames()) {
+		ScriptEntry script = m_scripts.at(name);
 
-	for (const auto& [name, script] : backup) {
 		if (script.fromFile && !script.filepath.empty()) {
 			loadScriptFile(name, script.filepath);
 		}
@@ -257,112 +213,6 @@ void Scripting::reloadAll() {
 	}
 }
 
-std::string Scripting::luaValueToString(const sol::object& obj) {
-	switch (obj.get_type()) {
-	case sol::type::number:
-		return std::to_string(obj.as<double>());
-	case sol::type::string:
-		return obj.as<std::string>();
-	case sol::type::boolean:
-		return obj.as<bool>() ? "true" : "false";
-	case sol::type::nil:
-		return "nil";
-	case sol::type::userdata: {
-		auto ud = obj.as<sol::userdata>();
-		if (ud.is<glm::vec2>()) {
-			auto v = ud.as<glm::vec2>();
-			return fmt::format("vec2({}, {})", v.x, v.y);
-		}
-		else if (ud.is<glm::vec3>()) {
-			auto v = ud.as<glm::vec3>();
-			return fmt::format("vec3({}, {}, {})", v.x, v.y, v.z);
-		}
-		return "<userdata>";
-	}
-	case sol::type::table:
-		return "<table>";
-	default:
-		return "<unknown>";
-	}
-}
-
-std::string Scripting::formatLuaArgs(sol::variadic_args va) {
-	std::ostringstream oss;
-	for (size_t i = 0; i < va.size(); ++i) {
-		oss << luaValueToString(va[i]);
-		if (i < va.size() - 1) oss << ", ";
-	}
-	return oss.str();
-}
-
-void Scripting::registerLogFuncs(sol::environment& env) {
-	auto format = [this](sol::variadic_args va) -> std::string {
-		return formatLuaArgs(va);
-		};
-
-	env.set_function("trace", [format](sol::variadic_args va) {
-		spdlog::trace("[LUA] {}", format(va));
-		});
-
-	env.set_function("debug", [format](sol::variadic_args va) {
-		spdlog::debug("[LUA] {}", format(va));
-		});
-
-	env.set_function("info", [format](sol::variadic_args va) {
-		spdlog::info("[LUA] {}", format(va));
-		});
-
-	env.set_function("print", [format](sol::variadic_args va) {
-		spdlog::info("[LUA] {}", format(va));
-		});
-
-	env.set_function("warn", [format](sol::variadic_args va) {
-		spdlog::warn("[LUA] {}", format(va));
-		});
-
-	env.set_function("error", [format](sol::variadic_args va) {
-		spdlog::error("[LUA] {}", format(va));
-		});
-
-	env.set_function("critical", [format](sol::variadic_args va) {
-		spdlog::critical("[LUA] {}", format(va));
-		});
-}
-
-void Scripting::registerLogFuncsGlobal() {
-	auto format = [this](sol::variadic_args va) -> std::string {
-		return formatLuaArgs(va);
-		};
-
-	m_lua.set_function("trace", [format](sol::variadic_args va) {
-		spdlog::trace("[LUA] {}", format(va));
-		});
-
-	m_lua.set_function("debug", [format](sol::variadic_args va) {
-		spdlog::debug("[LUA] {}", format(va));
-		});
-
-	m_lua.set_function("info", [format](sol::variadic_args va) {
-		spdlog::info("[LUA] {}", format(va));
-		});
-
-	m_lua.set_function("print", [format](sol::variadic_args va) {
-		spdlog::info("[LUA] {}", format(va));
-		});
-
-	m_lua.set_function("warn", [format](sol::variadic_args va) {
-		spdlog::warn("[LUA] {}", format(va));
-		});
-
-	m_lua.set_function("error", [format](sol::variadic_args va) {
-		spdlog::error("[LUA] {}", format(va));
-		});
-
-	m_lua.set_function("critical", [format](sol::variadic_args va) {
-		spdlog::critical("[LUA] {}", format(va));
-		});
-}
-
 std::string Scripting::loadFileToString(const std::string& filepath) {
 	std::ifstream file(filepath, std::ios::in | std::ios::binary);
 	if (!file) return {};
@@ -371,6 +221,10 @@ std::string Scripting::loadFileToString(const std::string& filepath) {
 	return contents.str();
 }
 
+std::size_t Scripting::hashCode(std::string_view code) {
+	return std::hash<std::string_view>{}(code);
+}
+
 std::vector<std::string> Scripting::getScriptNames() const {
 	std::vector<std::string> names;
 	names.reserve(m_scripts.size());
@@ -383,7 +237,15 @@ std::vector<std::string> Scripting::getScriptNames() const {
 }
 
 bool Scripting::deleteScript(const std::string& name) {
-	return m_scripts.erase(name) > 0;
+	auto it = m_scripts.find(name);
+	if (it == m_scripts.end()) return false;
+
+	m_vms[it->second.vm]->post([name](ScriptVM& target) {
+		target.deleteScript(name);
+		});
+	if (it->second.fromFile) m_watcher->unwatch(it->second.filepath);
+	m_scripts.erase(it);
+	return true;
 }
 
 void Scripting::updateScript(const std::string& name, const std::string& code) {
@@ -393,10 +255,7 @@ void Scripting::updateScript(const std::string& name, const std::string& code) {
 		bool fromFile = it->second.fromFile;
 		std::string filepath = it->second.filepath;
 
-		// Delete the old script
-		m_scripts.erase(it);
-
-		// Run the updated script
+		// Run the updated script, the VM replaces the old one
 		runScript(name, code, filepath, fromFile);
 	}
 	else {
@@ -406,21 +265,66 @@ void Scripting::updateScript(const std::string& name, const std::string& code) {
 }
 
 void Scripting::updateScriptFromFile(const std::string& name, const std::string& filepath) {
+	// Load the script from file, the VM replaces the old one
+	loadScriptFile(name, filepath);
+}
+
+void Scripting::setScriptPaused(const std::string& name, bool paused) {
 	auto it = m_scripts.find(name);
-	if (it != m_scripts.end()) {
-		// Delete the old script
-		m_scripts.erase(it);
+	if (it == m_scripts.end()) return;
+
+	m_vms[it->second.vm]->post([name, paused](ScriptVM& target) {
+		target.setPaused(name, paused);
+		});
+}
+
+void Scripting::stopScript(const std::string& name) {
+	auto it = m_scripts.find(name);
+	if (it == m_scripts.end()) return;
+
+	m_vms[it->second.vm]->post([name](ScriptVM& target) {
+		target.stopScript(name);
+		});
+}
+
+void Scripting::setScriptBudget(const ScriptBudget& budget) {
+	m_budget = budget;
+
+	for (auto& vm : m_vms) {
+		vm->post([budget](ScriptVM& target) {
+			target.setBudget(budget);
+			});
 	}
+}
 
-	// Load the script from file
-	loadScriptFile(name, filepath);
+void Scripting::setScriptMemoryLimit(std::size_t bytes) {
+	m_memoryLimit = bytes;
+
+	for (auto& vm : m_vms) {
+		vm->post([bytes](ScriptVM& target) {
+			target.setMemoryLimit(bytes);
+			});
+	}
+}
+
+void Scripting::setGCSettings(const GCSettings& settings) {
+	m_gcSettings = settings;
+
+	for (auto& vm : m_vms) {
+		vm->post([settings](ScriptVM& target) {
+			target.setGCSettings(settings);
+			});
+	}
 }
 
 bool Scripting::getScriptInfo(const std::string& name, ScriptState& outState,
 	std::string& outFilepath, bool& outFromFile) const {
 	auto it = m_scripts.find(name);
 	if (it != m_scripts.end()) {
-		outState = it->second.state;
+		// Scripts the VM hasn't picked up yet report the default (stopped) state
+		if (!m_vms[it->second.vm]->getState(name, outState)) {
+			outState = ScriptState{};
+		}
 		outFilepath = it->second.filepath;
 		outFromFile = it->second.fromFile;
 		return true;
@@ -439,11 +343,18 @@ std::string Scripting::getScriptCode(const std::string& name) const {
 bool Scripting::isScriptValid(const std::string& name) const {
 	auto it = m_scripts.find(name);
 	if (it != m_scripts.end()) {
-		return it->second.coroutine.valid();
+		ScriptState state;
+		bool valid = false;
+		return m_vms[it->second.vm]->getState(name, state, &valid) && valid;
 	}
 	return false;
 }
 
+std::size_t Scripting::getScriptVM(const std::string& name) const {
+	auto it = m_scripts.find(name);
+	return it != m_scripts.end() ? it->second.vm : 0;
+}
+
 void Scripting::drawImGuiWindow(bool* p_open) {
 	if (!ImGui::Begin("Lua Script Manager", p_open)) {
 		ImGui::End();
@@ -459,7 +370,7 @@ void Scripting::drawImGuiWindow(bool* p_open) {
 	static char execBuffer[4096] = "";
 
 	auto drawScriptList = [&]() {
-		ImGui::Text("Loaded Scripts");
+		ImGui::Text("Loaded Scripts (%zu VMs)", m_vms.size());
 		ImGui::Separator();
 		auto scriptNames = getScriptNames();
 
@@ -496,9 +407,12 @@ void Scripting::drawImGuiWindow(bool* p_open) {
 		else
 			statusText = state.error.empty() ? "Stopped" : "Error";
 
+		std::size_t vm = getScriptVM(selectedScript);
+
 		ImGui::Separator();
 		ImGui::Text("Script Actions");
 		ImGui::Text("Status: %s", statusText);
+		ImGui::Text("VM: %zu (%s)", vm, vm == 0 ? "main thread" : "worker thread");
 
 		if (!state.error.empty()) {
 			ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Error: %s", state.error.c_str());
@@ -512,25 +426,23 @@ void Scripting::drawImGuiWindow(bool* p_open) {
 			ImGui::SameLine();
 		}
 
-		auto& script = m_scripts.at(selectedScript);
-
 		if (state.isRunning) {
 			if (state.isPaused) {
-				if (ImGui::Button("Resume")) script.state.isPaused = false;
+				if (ImGui::Button("Resume")) setScriptPaused(selectedScript, false);
 			}
 			else {
-				if (ImGui::Button("Pause")) script.state.isPaused = true;
+				if (ImGui::Button("Pause")) setScriptPaused(selectedScript, true);
 			}
 			ImGui::SameLine();
 
 			if (ImGui::Button("Stop")) {
-				script.state.isRunning = false;
+				stopScript(selectedScript);
 			}
 			ImGui::SameLine();
 		}
 		else {
 			if (ImGui::Button("Restart")) {
-				updateScript(selectedScript, script.code);
+				updateScript(selectedScript, getScriptCode(selectedScript));
 			}
 			ImGui::SameLine();
 		}
@@ -652,6 +564,105 @@ void Scripting::drawImGuiWindow(bool* p_open) {
 		if (ImGui::Button("Reload All Scripts")) {
 			reloadAll();
 		}
+
+		ImGui::SameLine();
+		bool hotReload = isHotReloadEnabled();
+		if (ImGui::Checkbox("Hot Reload", &hotReload)) {
+			setHotReloadEnabled(hotReload);
+		}
+		};
+
+	auto drawPerformanceSection = [&]() {
+		ImGui::Separator();
+		if (!ImGui::CollapsingHeader("Performance")) return;
+
+		ScriptBudget budget = m_budget;
+		int instructions = static_cast<int>(budget.instructions);
+		bool budgetChanged = false;
+		budgetChanged |= ImGui::InputInt("Instruction Budget", &instructions, 1000, 100000);
+		budgetChanged |= ImGui::InputFloat("Time Budget (ms)", &budget.milliseconds, 0.1f, 1.0f, "%.2f");
+		budgetChanged |= ImGui::Checkbox("Kill on Exceed", &budget.killOnExceed);
+		if (budgetChanged) {
+			budget.instructions = static_cast<std::uint32_t>(std::max(instructions, 0));
+			budget.milliseconds = std::max(budget.milliseconds, 0.0f);
+			setScriptBudget(budget);
+		}
+
+		int memoryLimitKiB = static_cast<int>(m_memoryLimit / 1024);
+		if (ImGui::InputInt("Memory Limit (KiB)", &memoryLimitKiB, 256, 4096)) {
+			setScriptMemoryLimit(static_cast<std::size_t>(std::max(memoryLimitKiB, 0)) * 1024);
+		}
+
+		ImGui::SeparatorText("Garbage Collector");
+
+		GCSettings gc = m_gcSettings;
+		bool gcChanged = false;
+		gcChanged |= ImGui::Checkbox("Manual Stepping", &gc.manual);
+		gcChanged |= ImGui::DragFloat("GC Budget (ms)", &gc.budgetMs, 0.05f, 0.0f, 16.0f, "%.2f");
+		gcChanged |= ImGui::DragInt("Pause (%)", &gc.pause, 1.0f, 100, 1000);
+		gcChanged |= ImGui::DragInt("Step Multiplier", &gc.stepMul, 1.0f, 100, 1000);
+		if (gcChanged) {
+			setGCSettings(gc);
+		}
+
+		for (std::size_t i = 0; i < m_vms.size(); ++i) {
+			GCStats stats = m_vms[i]->getGCStats();
+			ImGui::Text("VM %zu: heap %.1f KiB, GC %.3f ms (%u steps), %u cycles, %u forced",
+				i, stats.heapBytes / 1024.0f, stats.lastStepMs, stats.stepsLastFrame,
+				stats.cyclesCompleted, stats.forcedCycles);
+		}
+
+		ImGui::SeparatorText("Scripts");
+
+		// Most expensive scripts first
+		std::vector<std::pair<std::string, ScriptState>> rows;
+		rows.reserve(m_scripts.size());
+		for (const auto& [name, entry] : m_scripts) {
+			ScriptState state;
+			if (m_vms[entry.vm]->getState(name, state)) {
+				rows.emplace_back(name, std::move(state));
+			}
+		}
+		std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+			return a.second.averageRunMs > b.second.averageRunMs;
+			});
+
+		if (ImGui::BeginTable("ScriptTimings", 9, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY, ImVec2(0, 150))) {
+			ImGui::TableSetupColumn("Script");
+			ImGui::TableSetupColumn("VM");
+			ImGui::TableSetupColumn("Last (ms)");
+			ImGui::TableSetupColumn("Avg (ms)");
+			ImGui::TableSetupColumn("Peak (ms)");
+			ImGui::TableSetupColumn("Overruns");
+			ImGui::TableSetupColumn("Memory (KiB)");
+			ImGui::TableSetupColumn("Peak (KiB)");
+			ImGui::TableSetupColumn("Alloc/Tick (KiB)");
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableHeadersRow();
+
+			for (const auto& [name, state] : rows) {
+				ImGui::TableNextRow();
+				ImGui::TableSetColumnIndex(0);
+				ImGui::TextUnformatted(name.c_str());
+				ImGui::TableSetColumnIndex(1);
+				ImGui::Text("%zu", getScriptVM(name));
+				ImGui::TableSetColumnIndex(2);
+				ImGui::Text("%.3f", state.lastRunMs);
+				ImGui::TableSetColumnIndex(3);
+				ImGui::Text("%.3f", state.averageRunMs);
+				ImGui::TableSetColumnIndex(4);
+				ImGui::Text("%.3f", state.peakRunMs);
+				ImGui::TableSetColumnIndex(5);
+				ImGui::Text("%u", state.budgetOverruns);
+				ImGui::TableSetColumnIndex(6);
+				ImGui::Text("%.1f", state.memoryBytes / 1024.0f);
+				ImGui::TableSetColumnIndex(7);
+				ImGui::Text("%.1f", state.peakMemoryBytes / 1024.0f);
+				ImGui::TableSetColumnIndex(8);
+				ImGui::Text("%.2f", state.allocatedBytes / 1024.0f);
+			}
+			ImGui::EndTable();
+		}
 		};
 
 	// ----- Render All Sections -----
@@ -659,6 +670,7 @@ void Scripting::drawImGuiWindow(bool* p_open) {
 	drawScriptActions();
 	drawNewScriptSection();
 	drawQuickExecuteSection();
+	drawPerformanceSection();
 
 	ImGui::End();
 }
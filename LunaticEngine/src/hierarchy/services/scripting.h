@@ -2,63 +2,112 @@
 
 #include "../base.h"
 
+#include "core/file_watcher.h"
+#include "scripting/vm.h"
+
 namespace Lunatic::Services {
-	struct ScriptState {
-		bool isRunning = false;
-		bool isPaused = false;
-		float waitUntil = 0.0f;
-		std::string error;
-	};
+	using Lunatic::ScriptState;
+	using Lunatic::ScriptBudget;
+	using Lunatic::GCSettings;
+	using Lunatic::GCStats;
 
 	class Scripting : public Service {
 	public:
-		Scripting();
-		~Scripting() override = default;
+		// With workerVMs > 0, scripts are sharded across that many Lua states that each
+		// run on their own thread. VM 0 always lives on the main thread and is used for
+		// exec() and for all scripts when there are no workers.
+		explicit Scripting(std::size_t workerVMs = 0);
+		~Scripting() override;
 
 		void update(float deltaTime) override;
+		void endFrame() override;
 
 		void loadScript(const std::string& name, const std::string& code);
 		void loadScriptFile(const std::string& name, const std::string& filepath);
 		void exec(const std::string& code);
 		void execFile(const std::string& filepath);
-		void reloadAll();
+		void reloadAll(); // Restarts all scripts, file scripts from their current source
 
 		std::vector<std::string> getScriptNames() const;
 		bool deleteScript(const std::string& name);
 		void updateScript(const std::string& name, const std::string& code);
 		void updateScriptFromFile(const std::string& name, const std::string& filepath);
+		void setScriptPaused(const std::string& name, bool paused);
+		void stopScript(const std::string& name);
 
 		bool getScriptInfo(const std::string& name, ScriptState& outState,
 			std::string& outFilepath, bool& outFromFile) const;
 		std::string getScriptCode(const std::string& name) const;
 		bool isScriptValid(const std::string& name) const;
+		std::size_t getScriptVM(const std::string& name) const;
+		std::size_t getVMCount() const { return m_vms.size(); }
+
+		// Applies to every script on every VM, see ScriptBudget
+		void setScriptBudget(const ScriptBudget& budget);
+		const ScriptBudget& getScriptBudget() const { return m_budget; }
+
+		// Per script memory cap in bytes (0 = unlimited), a script that hits it fails with an out of memory error
+		void setScriptMemoryLimit(std::size_t bytes);
+		std::size_t getScriptMemoryLimit() const { return m_memoryLimit; }
+
+		// File scripts are reloaded when their source is saved, at the next update
+		void setHotReloadEnabled(bool enabled) { m_hotReload = enabled; }
+		bool isHotReloadEnabled() const { return m_hotReload.load(); }
+
+		void setGCSettings(const GCSettings& settings);
+		const GCSettings& getGCSettings() const { return m_gcSettings; }
+		GCStats getGCStats(std::size_t vm) const { return m_vms[vm]->getGCStats(); }
+
+		// Queues a call to run on the main thread during the next update. Bindings
+		// running on worker VMs use this for anything that is not thread-safe.
+		void postToMainThread(ScriptVM::MainThreadCall call);
 
 		void drawImGuiWindow(bool* p_open = nullptr); // Debugging
 
 	private:
-		sol::state m_lua;
+		std::vector<std::unique_ptr<ScriptVM>> m_vms;
+
+		ScriptBudget m_budget;
+		std::size_t m_memoryLimit = 0;
+		GCSettings m_gcSettings;
 
 		float m_currentTime = 0.0f;
+		std::uint64_t m_frameIndex = 0;
 
-		struct ScriptData {
-			sol::thread thread;
-			sol::environment env;
-			sol::coroutine coroutine;
-			ScriptState state;
+		// Main thread view of every script, the Lua side lives in the owning VM
+		struct ScriptEntry {
+			std::size_t vm = 0;
 			std::string code;
 			std::string filepath;
 			bool fromFile = false;
+			std::size_t codeHash = 0;
 		};
 
-		std::unordered_map<std::string, ScriptData> m_scripts;
+		std::unordered_map<std::string, ScriptEntry> m_scripts;
+
+		// Read and hashed on the watcher thread, swapped in by update()
+		struct PendingReload {
+			std::string filepath;
+			std::string code;
+			std::size_t codeHash = 0;
+		};
+
+		std::atomic<bool> m_hotReload = true;
+		std::mutex m_reloadMutex;
+		std::vector<PendingReload> m_pendingReloads;
+		std::unique_ptr<FileWatcher> m_watcher;
+
+		std::mutex m_mainThreadMutex;
+		std::vector<ScriptVM::MainThreadCall> m_mainThreadCalls;
 
-		void initializeCoroutineRuntime();
-		std::string luaValueToString(const sol::object& obj);
-		std::string formatLuaArgs(sol::variadic_args va);
-		void registerLogFuncs(sol::environment& env);
-		void registerLogFuncsGlobal();
+		std::size_t pickVM() const;
+		void drainMainThreadCalls();
+		void onFileChanged(const std::filesystem::path& filepath);
+		void applyPendingReloads();
+		void reloadChanged(const std::string& filepath, const std::string& code, std::size_t codeHash);
 		void runScript(const std::string& name, const std::string& code,
 			const std::string& filepath = "", bool fromFile = false);
 		static std::string loadFileToString(const std::string& filepath);
+		static std::size_t hashCode(std::string_view code);
 	};
 } // namespace Lunatic
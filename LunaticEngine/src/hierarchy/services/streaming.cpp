@@ -0,0 +1,339 @@
+#include "pch.h"
+
+#include "streaming.h"
+#include "renderer.h"
+#include "workspace.h"
+
+#include "core/engine.h"
+#include "hierarchy/scene.h"
+
+#include <charconv>
+
+using namespace Lunatic::Services;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// cell_X_Z, coordinates may be negative
+static bool parseCellName(std::string_view stem, std::int32_t& x, std::int32_t& z) {
+	constexpr std::string_view PREFIX = "cell_";
+	if (!stem.starts_with(PREFIX)) return false;
+	stem.remove_prefix(PREFIX.size());
+
+	const char* end = stem.data() + stem.size();
+	auto [afterX, ecX] = std::from_chars(stem.data(), end, x);
+	if (ecX != std::errc() || afterX == end || *afterX != '_') return false;
+
+	auto [afterZ, ecZ] = std::from_chars(afterX + 1, end, z);
+	return ecZ == std::errc() && afterZ == end;
+}
+
+static std::size_t countInstances(const Lunatic::Instance& root) {
+	std::size_t count = 0;
+	std::vector<const Lunatic::Instance*> stack{ &root };
+	while (!stack.empty()) {
+		const Lunatic::Instance* node = stack.back();
+		stack.pop_back();
+
+		count += node->children.size();
+		for (const auto& child : node->children) {
+			stack.push_back(child.get());
+		}
+	}
+	return count;
+}
+
+Streaming::Streaming(std::size_t loaderThreads)
+	: Service("Streaming"), m_pool(loaderThreads) {}
+
+std::uint64_t Streaming::cellKey(std::int32_t x, std::int32_t z) {
+	return (std::uint64_t(std::uint32_t(x)) << 32) | std::uint32_t(z);
+}
+
+void Streaming::setSettings(const Settings& settings) {
+	m_settings = settings;
+	m_settings.cellSize = std::max(m_settings.cellSize, 1.0f);
+	m_settings.loadRadius = std::max(m_settings.loadRadius, 0);
+	m_settings.unloadRadius = std::max(m_settings.unloadRadius, m_settings.loadRadius);
+	m_cameraCell.reset();
+}
+
+bool Streaming::setWorld(const std::filesystem::path& directory) {
+	unloadAll();
+
+	m_world = directory;
+	m_worldInput = directory.string();
+	m_stats = Stats{};
+	m_worldSetAt = std::chrono::steady_clock::now();
+
+	std::error_code ec;
+	if (!std::filesystem::is_directory(directory, ec)) {
+		spdlog::warn("[Streaming] World directory {} does not exist", directory.string());
+		return false;
+	}
+
+	for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+		if (!entry.is_regular_file() || entry.path().extension() != ".lscene") continue;
+
+		std::int32_t x = 0, z = 0;
+		if (!parseCellName(entry.path().stem().string(), x, z)) continue;
+
+		m_cells[cellKey(x, z)] = Cell{ .x = x, .z = z, .path = entry.path() };
+	}
+
+	m_stats.availableCells = m_cells.size();
+	spdlog::info("[Streaming] World {} has {} cells", directory.string(), m_cells.size());
+	return true;
+}
+
+std::size_t Streaming::exportWorld(const std::filesystem::path& directory) {
+	static auto workspace = ServiceLocator::Get<Workspace>("Workspace");
+
+	// Streamed cells are exported by their content, not as a cell root
+	std::unordered_set<const Instance*> cellRoots;
+	for (const auto& [key, cell] : m_cells) {
+		if (cell.root) cellRoots.insert(cell.root.get());
+	}
+
+	std::unordered_map<std::uint64_t, std::vector<std::shared_ptr<Instance>>> groups;
+	auto addToCell = [&](const std::shared_ptr<Instance>& instance) {
+		auto x = static_cast<std::int32_t>(std::floor(instance->position.x / m_settings.cellSize));
+		auto z = static_cast<std::int32_t>(std::floor(instance->position.z / m_settings.cellSize));
+		groups[cellKey(x, z)].push_back(instance);
+		};
+
+	for (const auto& instance : workspace->getInstances()) {
+		if (cellRoots.contains(instance.get())) {
+			for (const auto& child : instance->children) addToCell(child);
+		}
+		else {
+			addToCell(instance);
+		}
+	}
+
+	std::size_t written = 0;
+	try {
+		std::filesystem::create_directories(directory);
+		for (const auto& [key, instances] : groups) {
+			auto x = static_cast<std::int32_t>(key >> 32);
+			auto z = static_cast<std::int32_t>(key & 0xFFFFFFFF);
+			Scene::Save(instances, directory / std::format("cell_{}_{}.lscene", x, z), Scene::Format::Binary);
+			++written;
+		}
+	}
+	catch (const std::exception& e) {
+		spdlog::error("[Streaming] Exporting world to {} failed: {}", directory.string(), e.what());
+	}
+
+	spdlog::info("[Streaming] Exported {} cells to {}", written, directory.string());
+	return written;
+}
+
+void Streaming::update(float deltaTime) {
+	// Their Removed events went out with this frame's dispatch, nothing else holds them now
+	for (auto& root : m_retired) {
+		release(std::move(root));
+	}
+	m_retired.clear();
+
+	if (!m_cells.empty()) {
+		static auto renderer = ServiceLocator::Get<Renderer>("Renderer");
+		updateWantedCells(renderer->getCamera().getPosition());
+	}
+
+	commitLoaded();
+}
+
+void Streaming::updateWantedCells(const glm::vec3& cameraPosition) {
+	std::pair<std::int32_t, std::int32_t> cameraCell{
+		static_cast<std::int32_t>(std::floor(cameraPosition.x / m_settings.cellSize)),
+		static_cast<std::int32_t>(std::floor(cameraPosition.z / m_settings.cellSize))
+	};
+
+	// Wanted cells only change when the camera crosses into another cell
+	if (m_cameraCell == cameraCell) return;
+	m_cameraCell = cameraCell;
+
+	std::vector<std::pair<std::int32_t, std::uint64_t>> toLoad; // distance, key
+	for (auto& [key, cell] : m_cells) {
+		std::int32_t distance = std::max(std::abs(cell.x - cameraCell.first), std::abs(cell.z - cameraCell.second));
+		if (distance <= m_settings.loadRadius) {
+			if (cell.state == CellState::Unloaded) toLoad.emplace_back(distance, key);
+		}
+		else if (distance > m_settings.unloadRadius) {
+			unload(cell);
+		}
+	}
+
+	// The pool is FIFO, so the cells closest to the camera arrive first
+	std::sort(toLoad.begin(), toLoad.end());
+	for (const auto& [distance, key] : toLoad) {
+		requestLoad(key, m_cells[key]);
+	}
+}
+
+void Streaming::requestLoad(std::uint64_t key, Cell& cell) {
+	cell.state = CellState::Loading;
+	cell.ticket = m_nextTicket++;
+	++m_stats.loadingCells;
+
+	m_pool.submit([this, key, ticket = cell.ticket, path = cell.path, x = cell.x, z = cell.z] {
+		auto start = std::chrono::steady_clock::now();
+
+		LoadedCell loaded{ .key = key, .ticket = ticket };
+		try {
+			loaded.root = std::make_shared<Instance>(std::format("Cell {},{}", x, z));
+			Scene::Load(path, loaded.root, false);
+			loaded.instanceCount = countInstances(*loaded.root);
+		}
+		catch (const std::exception& e) {
+			loaded.root.reset();
+			loaded.error = e.what();
+		}
+		loaded.loadMs = millisecondsSince(start);
+
+		std::lock_guard lock(m_loadedMutex);
+		m_loaded.push_back(std::move(loaded));
+	});
+}
+
+void Streaming::unload(Cell& cell) {
+	static auto workspace = ServiceLocator::Get<Workspace>("Workspace");
+
+	if (cell.state == CellState::Loading) {
+		// The result is dropped when it arrives, its ticket no longer matches a loading cell
+		--m_stats.loadingCells;
+	}
+	else if (cell.state == CellState::Resident) {
+		workspace->removeChild(cell.root);
+		m_retired.push_back(std::move(cell.root));
+
+		--m_stats.residentCells;
+		m_stats.residentInstances -= cell.instanceCount;
+		cell.instanceCount = 0;
+	}
+
+	cell.state = CellState::Unloaded;
+}
+
+void Streaming::unloadAll() {
+	for (auto& [key, cell] : m_cells) {
+		unload(cell);
+	}
+	m_cells.clear();
+	m_cameraCell.reset();
+
+	for (auto& loaded : m_commitQueue) {
+		release(std::move(loaded.root));
+	}
+	m_commitQueue.clear();
+}
+
+void Streaming::commitLoaded() {
+	static auto workspace = ServiceLocator::Get<Workspace>("Workspace");
+
+	{
+		std::lock_guard lock(m_loadedMutex);
+		for (auto& loaded : m_loaded) {
+			m_commitQueue.push_back(std::move(loaded));
+		}
+		m_loaded.clear();
+	}
+
+	if (m_commitQueue.empty()) {
+		m_stats.lastCommitMs = 0.0;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::size_t committed = 0;
+
+	while (!m_commitQueue.empty()) {
+		if (committed > 0 && millisecondsSince(start) >= m_settings.commitBudgetMs) break;
+
+		LoadedCell loaded = std::move(m_commitQueue.front());
+		m_commitQueue.pop_front();
+
+		auto it = m_cells.find(loaded.key);
+		if (it == m_cells.end() || it->second.state != CellState::Loading || it->second.ticket != loaded.ticket) {
+			release(std::move(loaded.root)); // Unloaded again before it got here
+			continue;
+		}
+
+		Cell& cell = it->second;
+		--m_stats.loadingCells;
+		if (!loaded.error.empty()) {
+			spdlog::error("[Streaming] Could not load cell {}: {}", cell.path.string(), loaded.error);
+			cell.state = CellState::Unloaded;
+			continue;
+		}
+
+		// The whole subtree was built off-thread, joining the live tree is a single attach
+		cell.root = std::move(loaded.root);
+		cell.instanceCount = loaded.instanceCount;
+		cell.state = CellState::Resident;
+		workspace->addChild(cell.root);
+
+		++committed;
+		++m_stats.residentCells;
+		m_stats.residentInstances += cell.instanceCount;
+		m_stats.lastLoadMs = loaded.loadMs;
+		if (m_stats.timeToFirstCellMs < 0.0) {
+			m_stats.timeToFirstCellMs = millisecondsSince(m_worldSetAt);
+		}
+	}
+
+	m_stats.lastCommitMs = millisecondsSince(start);
+	m_stats.maxCommitMs = std::max(m_stats.maxCommitMs, m_stats.lastCommitMs);
+
+	if (m_stats.timeToSettledMs < 0.0 && m_stats.loadingCells == 0 && m_commitQueue.empty()) {
+		m_stats.timeToSettledMs = millisecondsSince(m_worldSetAt);
+		spdlog::info("[Streaming] {} cells resident after {:.1f} ms (first after {:.1f} ms)",
+			m_stats.residentCells, m_stats.timeToSettledMs, m_stats.timeToFirstCellMs);
+	}
+}
+
+void Streaming::release(std::shared_ptr<Instance> root) {
+	if (!root) return;
+
+	// Freeing a big cell is a lot of small deletes, keep them off the main thread
+	m_pool.submit([root = std::move(root)]() mutable {
+		root.reset();
+	});
+}
+
+void Streaming::render() {
+	if (ImGui::Begin("Streaming")) {
+		ImGui::SetNextItemWidth(200.0f);
+		ImGui::InputText("##World", &m_worldInput);
+		ImGui::SameLine();
+		if (ImGui::Button("Load World")) setWorld(m_worldInput);
+		ImGui::SameLine();
+		if (ImGui::Button("Export Workspace")) exportWorld(m_worldInput);
+
+		Settings settings = m_settings;
+		bool changed = false;
+		changed |= ImGui::DragFloat("Cell Size", &settings.cellSize, 1.0f, 1.0f, 1024.0f, "%.0f");
+		changed |= ImGui::SliderInt("Load Radius", &settings.loadRadius, 0, 16);
+		changed |= ImGui::SliderInt("Unload Radius", &settings.unloadRadius, 0, 17);
+		changed |= ImGui::DragFloat("Commit Budget (ms)", &settings.commitBudgetMs, 0.1f, 0.1f, 16.0f, "%.1f");
+		if (changed) setSettings(settings);
+
+		ImGui::Separator();
+		ImGui::Text("Cells: %zu resident, %zu loading, %zu in world", m_stats.residentCells, m_stats.loadingCells, m_stats.availableCells);
+		ImGui::Text("Instances: %zu", m_stats.residentInstances);
+		ImGui::Text("Loader threads: %zu, pending jobs: %zu", m_pool.getThreadCount(), m_pool.getPendingCount());
+		ImGui::Text("Last cell load: %.2f ms (worker)", m_stats.lastLoadMs);
+		ImGui::Text("Commit: %.3f ms last frame, %.3f ms max", m_stats.lastCommitMs, m_stats.maxCommitMs);
+
+		auto showTime = [](const char* label, double ms) {
+			if (ms < 0.0) ImGui::Text("%s: -", label);
+			else ImGui::Text("%s: %.1f ms", label, ms);
+			};
+		showTime("Time to first frame", Engine::GetInstance().getTimeToFirstFrame());
+		showTime("Time to first cell", m_stats.timeToFirstCellMs);
+		showTime("Time to settled", m_stats.timeToSettledMs);
+	}
+	ImGui::End();
+}
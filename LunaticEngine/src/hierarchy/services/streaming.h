@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../base.h"
+
+#include "core/thread_pool.h"
+
+#include <optional>
+
+namespace Lunatic::Services {
+	/// <summary>
+	/// Streams a world split into square cells on the XZ plane around the camera. Every cell
+	/// is a scene file named cell_X_Z.lscene in the world directory. Cells are parsed and
+	/// built on a ThreadPool under a detached root, then committed to the Workspace on the
+	/// main thread within a per-frame budget. Unloaded cells are freed on the pool as well.
+	/// Nothing in a cell may need GL at construction, uploads happen on first render.
+	/// </summary>
+	class Streaming : public Service {
+	public:
+		struct Settings {
+			float cellSize = 32.0f;
+			std::int32_t loadRadius = 2;   // in cells around the camera's cell
+			std::int32_t unloadRadius = 3; // larger than loadRadius so border cells don't thrash
+			float commitBudgetMs = 2.0f;   // at least one cell is committed per frame regardless
+		};
+
+		struct Stats {
+			std::size_t availableCells = 0;
+			std::size_t residentCells = 0;
+			std::size_t loadingCells = 0;  // on a worker or waiting to be committed
+			std::size_t residentInstances = 0;
+			double lastLoadMs = 0.0;       // worker time for the latest cell
+			double lastCommitMs = 0.0;     // main thread time spent committing last frame
+			double maxCommitMs = 0.0;
+			double timeToFirstCellMs = -1.0; // since setWorld, -1 until it happened
+			double timeToSettledMs = -1.0;   // since setWorld, until nothing was left to load
+		};
+
+		explicit Streaming(std::size_t loaderThreads = 0);
+		~Streaming() override = default;
+
+		void update(float deltaTime) override;
+		void render() override;
+
+		// Unloads the current world and indexes the cells in directory, false if it doesn't exist
+		bool setWorld(const std::filesystem::path& directory);
+		// Splits the workspace's top-level instances into cells by position and saves them to
+		// directory, for turning a hand-built scene into a streamed world. Returns the cell count.
+		std::size_t exportWorld(const std::filesystem::path& directory);
+
+		void setSettings(const Settings& settings);
+		const Settings& getSettings() const { return m_settings; }
+		const Stats& getStats() const { return m_stats; }
+
+	private:
+		enum class CellState {
+			Unloaded,
+			Loading,
+			Resident
+		};
+
+		struct Cell {
+			std::int32_t x = 0;
+			std::int32_t z = 0;
+			std::filesystem::path path;
+			CellState state = CellState::Unloaded;
+			std::uint64_t ticket = 0; // bumped per request, results for an older ticket are stale
+			std::shared_ptr<Instance> root; // child of the workspace while resident
+			std::size_t instanceCount = 0;
+		};
+
+		// Built on a worker, waiting for the main thread
+		struct LoadedCell {
+			std::uint64_t key = 0;
+			std::uint64_t ticket = 0;
+			std::shared_ptr<Instance> root;
+			std::size_t instanceCount = 0;
+			double loadMs = 0.0;
+			std::string error;
+		};
+
+		Settings m_settings;
+		Stats m_stats;
+
+		std::filesystem::path m_world;
+		std::string m_worldInput = "world";
+		std::unordered_map<std::uint64_t, Cell> m_cells;
+		std::uint64_t m_nextTicket = 1;
+		std::optional<std::pair<std::int32_t, std::int32_t>> m_cameraCell; // reset to rescan
+
+		std::mutex m_loadedMutex;
+		std::vector<LoadedCell> m_loaded;
+		std::deque<LoadedCell> m_commitQueue;
+
+		// Removed from the workspace, released on the pool once their events were dispatched
+		std::vector<std::shared_ptr<Instance>> m_retired;
+
+		std::chrono::steady_clock::time_point m_worldSetAt;
+
+		ThreadPool m_pool; // last, so workers are joined before anything they touch is destroyed
+
+		static std::uint64_t cellKey(std::int32_t x, std::int32_t z);
+
+		void updateWantedCells(const glm::vec3& cameraPosition);
+		void requestLoad(std::uint64_t key, Cell& cell);
+		void unload(Cell& cell);
+		void commitLoaded();
+		void release(std::shared_ptr<Instance> root);
+		void unloadAll();
+	};
+} // namespace Lunatic::Services
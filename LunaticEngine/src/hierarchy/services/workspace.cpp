@@ -3,13 +3,34 @@
 #include "workspace.h"
 #include "hierarchy/objects/cube.h"
 
+#include <functional>
+
 using namespace Lunatic::Services;
 
 Workspace::Workspace() : Service("Workspace") {
 	// Constructor does not set up hierarchy to avoid std::bad_weak_ptr
+
+	// The explorer only rebuilds when the tree actually changed
+	m_explorerSubscription = HierarchyEvents::Subscribe([this](std::span<const HierarchyEvent>) {
+		m_rowsDirty = true;
+		m_searchIndexDirty = true;
+		}, HierarchyEvents::STRUCTURE_EVENTS);
+}
+
+Workspace::~Workspace() {
+	HierarchyEvents::Unsubscribe(m_explorerSubscription);
 }
 
 void Workspace::initialize() {
+	// Built before the engine started running, by a tool or the stress scenes, and kept
+	if (!children.empty()) {
+		return;
+	}
+
+	if (std::filesystem::exists(m_scenePath) && loadScene(m_scenePath)) {
+		return;
+	}
+
 	// Create some example entities and show some hierarchy stuff ig
 
 	auto cube1 = std::make_shared<Cube>("Cube1");
@@ -17,9 +38,9 @@ void Workspace::initialize() {
 	auto cube3 = std::make_shared<Cube>("Cube3");
 
 	// Set different 3D positions to test depth
-	cube1->position = glm::vec3(-2.0f, 0.0f, 0.0f);
-	cube2->position = glm::vec3(0.0f, 0.0f, -2.0f);  // Behind cube1
-	cube3->position = glm::vec3(2.0f, 1.0f, -1.0f);  // To the right and slightly back
+	cube1->setPosition(glm::vec3(-2.0f, 0.0f, 0.0f));
+	cube2->setPosition(glm::vec3(0.0f, 0.0f, -2.0f));  // Behind cube1
+	cube3->setPosition(glm::vec3(2.0f, 1.0f, -1.0f));  // To the right and slightly back
 
 	// Make cube2 a child of cube1
 	cube1->addChild(cube2);
@@ -29,6 +50,49 @@ void Workspace::initialize() {
 	this->addChild(cube3);
 }
 
+bool Workspace::loadScene(const std::filesystem::path& path) {
+	auto start = std::chrono::steady_clock::now();
+
+	// Built off to the side first and quietly, a broken file leaves the current scene alone
+	auto staging = std::make_shared<Instance>("Staging");
+	try {
+		Scene::Load(path, staging, false);
+	}
+	catch (const std::exception& e) {
+		spdlog::error("[Workspace] Could not load scene {}: {}", path.string(), e.what());
+		return false;
+	}
+
+	clearAllChildren();
+	m_selected.reset();
+
+	// Subscribers only ever see the scene being added to the workspace, never the staging root
+	auto loaded = std::move(staging->children);
+	staging->children.clear();
+	children.reserve(loaded.size());
+	for (auto& instance : loaded) {
+		instance->parent.reset();
+		addChild(std::move(instance));
+	}
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	spdlog::info("[Workspace] Loaded scene {} in {:.2f} ms", path.string(), elapsed);
+	return true;
+}
+
+bool Workspace::saveScene(const std::filesystem::path& path, Scene::Format format) {
+	try {
+		Scene::Save(*this, path, format);
+	}
+	catch (const std::exception& e) {
+		spdlog::error("[Workspace] Could not save scene {}: {}", path.string(), e.what());
+		return false;
+	}
+
+	spdlog::info("[Workspace] Saved scene to {}", path.string());
+	return true;
+}
+
 void Workspace::update(float deltaTime) {
 }
 
@@ -38,6 +102,15 @@ void Workspace::render() {
     
     // Render the Dear ImGui workspace explorer window
     if (ImGui::Begin("Workspace Explorer")) {
+        ImGui::SetNextItemWidth(200.0f);
+        ImGui::InputText("##ScenePath", &m_scenePath);
+        ImGui::SameLine();
+        if (ImGui::Button("Load")) loadScene(m_scenePath);
+        ImGui::SameLine();
+        if (ImGui::Button("Save")) saveScene(m_scenePath, Scene::Format::Binary);
+        ImGui::SameLine();
+        if (ImGui::Button("Save as Text")) saveScene(m_scenePath, Scene::Format::Text);
+
         // Split window into two columns: tree view and properties
         if (ImGui::BeginTable("WorkspaceLayout", 2, ImGuiTableFlags_Resizable | ImGuiTableFlags_BordersInnerV)) {
             ImGui::TableSetupColumn("Hierarchy", ImGuiTableColumnFlags_WidthFixed, 300.0f);
@@ -47,80 +120,241 @@ void Workspace::render() {
             
             // Left column: Hierarchy tree
             ImGui::TableSetColumnIndex(0);
-            ImGui::Text("Hierarchy");
-            ImGui::Separator();
-            
-            static std::shared_ptr<Instance> selectedInstance = nullptr;
-            
-            std::function<void(const std::shared_ptr<Instance>&)> renderInstanceTree;
-            renderInstanceTree = [&](const std::shared_ptr<Instance>& instance) {
-                ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth;
-                if (instance->children.empty()) {
-                    flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
-                }
-                if (selectedInstance == instance) {
-                    flags |= ImGuiTreeNodeFlags_Selected;
-                }
-                
-                bool isOpen = ImGui::TreeNodeEx(instance->getName().data(), flags);
-                
-                // Handle selection
-                if (ImGui::IsItemClicked()) {
-                    selectedInstance = instance;
-                }
-                
-                if (isOpen && !(flags & ImGuiTreeNodeFlags_NoTreePushOnOpen)) {
-                    for (const auto& child : instance->children) {
-                        renderInstanceTree(child);
-                    }
-                    ImGui::TreePop();
-                }
-            };
-            
-            for (const auto& child : this->children) {
-                renderInstanceTree(child);
-            }
+            drawExplorerTree();
             
             // Right column: Properties
             ImGui::TableSetColumnIndex(1);
-            ImGui::Text("Properties");
-            ImGui::Separator();
-            
-            if (selectedInstance) {
-                ImGui::Text("Name: %s", selectedInstance->getName().data());
-                ImGui::Text("Class: %s", selectedInstance->getClassName().data());
-                
-                ImGui::Text("Position:");
-                ImGui::SameLine();
-				ImGui::DragFloat3("##Position", &selectedInstance->position.x, 0.1f, -100.0f, 100.0f, "%.1f");
-                
-                ImGui::Text("Rotation:");
-                ImGui::SameLine();
-				ImGui::DragFloat3("##Rotation", &selectedInstance->rotation.x, 0.1f, 0.0f, 360.0f, "%.1f");
-                
-                auto parent = selectedInstance->getParent();
-                if (parent) {
-                    ImGui::Text("Parent: %s", parent->getName().data());
-                } else {
-                    ImGui::Text("Parent: None (Root)");
-                }
-                
-                ImGui::Text("Children: %zu", selectedInstance->children.size());
-                
-                if (!selectedInstance->children.empty()) {
-                    ImGui::Text("Child List:");
-                    ImGui::Indent();
-                    for (const auto& child : selectedInstance->children) {
-                        ImGui::BulletText("%s (%s)", child->getName().data(), child->getClassName().data());
-                    }
-                    ImGui::Unindent();
-                }
-            } else {
-                ImGui::Text("Select an instance to view properties");
-            }
+            drawProperties();
             
             ImGui::EndTable();
         }
     }
     ImGui::End();
-}
\ No newline at end of file
+}
+
+static std::string toLower(std::string_view text) {
+	std::string lower(text);
+	std::transform(lower.begin(), lower.end(), lower.begin(),
+		[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return lower;
+}
+
+void Workspace::select(const std::shared_ptr<Instance>& instance) {
+	m_selected = instance;
+
+	// Make sure the selection shows up in the tree once the search is cleared
+	for (auto ancestor = instance->getParent(); ancestor && ancestor.get() != this; ancestor = ancestor->getParent()) {
+		if (m_expanded.insert(ancestor->getId()).second) {
+			m_rowsDirty = true;
+		}
+	}
+}
+
+void Workspace::rebuildSearchIndex() {
+	m_searchIndex.clear();
+	m_searchNames.clear();
+	m_searchMatches.clear();
+	m_matchedQuery.clear();
+
+	std::vector<Instance*> stack{ this };
+	while (!stack.empty()) {
+		Instance* node = stack.back();
+		stack.pop_back();
+
+		for (const auto& child : node->children) {
+			m_searchIndex.push_back(SearchEntry{ child, static_cast<std::uint32_t>(m_searchNames.size()) });
+			m_searchNames += toLower(child->getName());
+			m_searchNames += '\0';
+			stack.push_back(child.get());
+		}
+	}
+
+	m_searchIndexDirty = false;
+}
+
+void Workspace::updateSearchMatches(const std::string& query) {
+	if (query == m_matchedQuery) return;
+
+	// Typing narrows the query, so only the previous matches can still match
+	if (!m_matchedQuery.empty() && query.find(m_matchedQuery) != std::string::npos) {
+		std::erase_if(m_searchMatches, [&](std::uint32_t entry) {
+			std::string_view name(m_searchNames.data() + m_searchIndex[entry].nameOffset);
+			return name.find(query) == std::string_view::npos;
+			});
+		m_matchedQuery = query;
+		return;
+	}
+
+	// Otherwise one pass over all names, continuing after the name of every hit
+	m_searchMatches.clear();
+	std::boyer_moore_horspool_searcher searcher(query.begin(), query.end());
+	auto it = m_searchNames.cbegin();
+	while (true) {
+		auto hit = searcher(it, m_searchNames.cend()).first;
+		if (hit == m_searchNames.cend()) break;
+
+		auto offset = static_cast<std::uint32_t>(hit - m_searchNames.cbegin());
+		auto next = std::ranges::upper_bound(m_searchIndex, offset, {}, &SearchEntry::nameOffset);
+		m_searchMatches.push_back(static_cast<std::uint32_t>(next - m_searchIndex.begin() - 1));
+		it = next == m_searchIndex.end() ? m_searchNames.cend() : m_searchNames.cbegin() + next->nameOffset;
+	}
+	m_matchedQuery = query;
+}
+
+void Workspace::rebuildExplorerRows() {
+	m_explorerRows.clear();
+
+	auto makeRow = [](const std::shared_ptr<Instance>& instance, std::uint32_t depth) {
+		return ExplorerRow{
+			.instance = instance,
+			.id = instance->getId(),
+			.label = std::string(instance->getName()),
+			.depth = depth,
+			.hasChildren = !instance->children.empty()
+		};
+		};
+
+	if (!m_search.empty()) {
+		// Search shows matches as a flat list, straight from the index
+		if (m_searchIndexDirty) rebuildSearchIndex();
+
+		updateSearchMatches(toLower(m_search));
+		for (std::uint32_t entry : m_searchMatches) {
+			if (auto instance = m_searchIndex[entry].instance.lock()) {
+				m_explorerRows.push_back(makeRow(instance, 0));
+			}
+		}
+	}
+	else {
+		// Depth-first without recursion, only descending into expanded nodes
+		std::vector<std::pair<Instance*, std::uint32_t>> stack;
+		for (auto it = children.rbegin(); it != children.rend(); ++it) {
+			stack.emplace_back(it->get(), 0);
+		}
+
+		while (!stack.empty()) {
+			auto [node, depth] = stack.back();
+			stack.pop_back();
+
+			auto instance = node->shared_from_this();
+			m_explorerRows.push_back(makeRow(instance, depth));
+
+			if (m_expanded.contains(node->getId())) {
+				for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
+					stack.emplace_back(it->get(), depth + 1);
+				}
+			}
+		}
+	}
+
+	m_rowsDirty = false;
+}
+
+void Workspace::drawExplorerTree() {
+	ImGui::Text("Hierarchy");
+	ImGui::Separator();
+
+	if (ImGui::InputTextWithHint("##Search", "Search", &m_search)) {
+		m_rowsDirty = true;
+	}
+
+	if (m_rowsDirty) {
+		rebuildExplorerRows();
+	}
+
+	auto selected = m_selected.lock();
+	std::uint64_t selectedId = selected ? selected->getId() : 0;
+	const float indent = ImGui::GetTreeNodeToLabelSpacing();
+
+	ImGui::BeginChild("HierarchyRows");
+
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(m_explorerRows.size()));
+	while (clipper.Step()) {
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+			const ExplorerRow& row = m_explorerRows[i];
+
+			ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth
+				| ImGuiTreeNodeFlags_NoTreePushOnOpen;
+			if (!row.hasChildren || !m_search.empty()) {
+				flags |= ImGuiTreeNodeFlags_Leaf;
+			}
+			if (row.id == selectedId) {
+				flags |= ImGuiTreeNodeFlags_Selected;
+			}
+
+			// Rows are not nested ImGui trees, the depth is just an indent
+			bool expanded = m_expanded.contains(row.id);
+			ImGui::SetCursorPosX(ImGui::GetCursorPosX() + indent * static_cast<float>(row.depth));
+			ImGui::SetNextItemOpen(expanded);
+			bool open = ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<std::uintptr_t>(row.id)), flags, "%s", row.label.c_str());
+
+			if (row.hasChildren && m_search.empty() && open != expanded) {
+				if (open) m_expanded.insert(row.id);
+				else m_expanded.erase(row.id);
+				m_rowsDirty = true;
+			}
+
+			// Handle selection
+			if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
+				if (auto instance = row.instance.lock()) {
+					select(instance);
+				}
+			}
+		}
+	}
+
+	ImGui::EndChild();
+}
+
+void Workspace::drawProperties() {
+	ImGui::Text("Properties");
+	ImGui::Separator();
+
+	auto selectedInstance = m_selected.lock();
+	if (!selectedInstance) {
+		ImGui::Text("Select an instance to view properties");
+		return;
+	}
+
+	ImGui::Text("Name: %s", selectedInstance->getName().data());
+	ImGui::Text("Class: %s", selectedInstance->getClassName().data());
+
+	ImGui::Text("Position:");
+	ImGui::SameLine();
+	if (ImGui::DragFloat3("##Position", &selectedInstance->position.x, 0.1f, -100.0f, 100.0f, "%.1f")) {
+		selectedInstance->markTransformDirty();
+	}
+
+	ImGui::Text("Rotation:");
+	ImGui::SameLine();
+	if (ImGui::DragFloat3("##Rotation", &selectedInstance->rotation.x, 0.1f, 0.0f, 360.0f, "%.1f")) {
+		selectedInstance->markTransformDirty();
+	}
+
+	auto parent = selectedInstance->getParent();
+	if (parent) {
+		ImGui::Text("Parent: %s", parent->getName().data());
+	}
+	else {
+		ImGui::Text("Parent: None (Root)");
+	}
+
+	const auto& children = selectedInstance->children;
+	ImGui::Text("Children: %zu", children.size());
+
+	if (!children.empty()) {
+		ImGui::Text("Child List:");
+		ImGui::BeginChild("ChildList", ImVec2(0, 0), true);
+
+		ImGuiListClipper clipper;
+		clipper.Begin(static_cast<int>(children.size()));
+		while (clipper.Step()) {
+			for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+				ImGui::BulletText("%s (%s)", children[i]->getName().data(), children[i]->getClassName().data());
+			}
+		}
+
+		ImGui::EndChild();
+	}
+}
@@ -1,19 +1,64 @@
 #pragma once
 
 #include "../base.h"
+#include "../scene.h"
 
 namespace Lunatic::Services {
 	class Workspace : public Service {
 	public:
 		Workspace();
+		~Workspace() override;
 
-		std::vector<std::shared_ptr<Instance>>& getInstances() {
+		const std::vector<std::shared_ptr<Instance>>& getInstances() const {
 			return children;
 		}
 
+		// Loads scene.lscene, or the example cubes without one, into an empty workspace
 		void initialize();
 
+		// Replaces everything in the workspace, returns false (and logs) if the file can't be loaded
+		bool loadScene(const std::filesystem::path& path);
+		bool saveScene(const std::filesystem::path& path, Scene::Format format);
+
 		void update(float deltaTime) override;
 		void render() override;
+
+	private:
+		// Workspace Explorer, the expanded part of the tree flattened into rows. Rebuilt only
+		// when HierarchyEvents reports a structural change, the expansion state or the search
+		// changes, drawn with a clipper.
+		struct ExplorerRow {
+			std::weak_ptr<Instance> instance;
+			std::uint64_t id = 0;
+			std::string label;
+			std::uint32_t depth = 0;
+			bool hasChildren = false;
+		};
+
+		struct SearchEntry {
+			std::weak_ptr<Instance> instance;
+			std::uint32_t nameOffset = 0; // into m_searchNames
+		};
+
+		std::vector<ExplorerRow> m_explorerRows;
+		std::vector<SearchEntry> m_searchIndex; // every instance, rebuilt on hierarchy change
+		std::string m_searchNames;              // their lowercased names, each ended by a '\0'
+		std::vector<std::uint32_t> m_searchMatches; // into m_searchIndex, for m_matchedQuery
+		std::string m_matchedQuery;
+		std::unordered_set<std::uint64_t> m_expanded;
+		std::weak_ptr<Instance> m_selected;
+		std::string m_search;
+		std::string m_scenePath = "scene.lscene";
+
+		HierarchyEvents::SubscriptionId m_explorerSubscription = 0;
+		bool m_rowsDirty = true;
+		bool m_searchIndexDirty = true;
+
+		void rebuildExplorerRows();
+		void rebuildSearchIndex();
+		void updateSearchMatches(const std::string& query);
+		void drawExplorerTree();
+		void drawProperties();
+		void select(const std::shared_ptr<Instance>& instance);
 	};
 } // namespace Lunatic::Services
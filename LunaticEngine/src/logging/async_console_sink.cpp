@@ -0,0 +1,110 @@
+#include "pch.h"
+
+#include "async_console_sink.h"
+
+using namespace Lunatic;
+
+std::atomic<AsyncConsoleSink*> AsyncConsoleSink::sm_active = nullptr;
+
+AsyncConsoleSink::AsyncConsoleSink(Output output, std::size_t capacity)
+	: output_(std::move(output)), mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1) {
+	records_ = std::make_unique<Record[]>(mask_ + 1);
+	for (std::size_t i = 0; i <= mask_; ++i) {
+		records_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+AsyncConsoleSink::~AsyncConsoleSink() {
+	AsyncConsoleSink* self = this;
+	sm_active.compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+}
+
+AsyncConsoleSink::Record* AsyncConsoleSink::claim(std::size_t& pos) {
+	// Bounded MPSC ring, a slot belongs to the producer whose position matches its sequence
+	pos = enqueuePos_.load(std::memory_order_relaxed);
+	for (;;) {
+		Record* record = &records_[pos & mask_];
+		std::size_t sequence = record->sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+		if (diff == 0) {
+			if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return record;
+		}
+		else if (diff < 0) {
+			// Full, dropping keeps the log call from ever waiting on the main thread
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		else {
+			pos = enqueuePos_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void AsyncConsoleSink::publish(Record& record, std::size_t pos) {
+	record.sequence.store(pos + 1, std::memory_order_release);
+}
+
+void AsyncConsoleSink::sink_it_(const spdlog::details::log_msg& msg) {
+	std::size_t pos = 0;
+	Record* record = claim(pos);
+	if (!record) return;
+
+	record->time = msg.time;
+	record->threadId = msg.thread_id;
+	record->level = msg.level;
+	record->nameLength = static_cast<std::uint8_t>(std::min(msg.logger_name.size(), MAX_LOGGER_NAME));
+	std::memcpy(record->name.data(), msg.logger_name.data(), record->nameLength);
+	record->format = {};
+	record->argCount = 0;
+
+	record->textLength = static_cast<std::uint32_t>(msg.payload.size());
+	if (msg.payload.size() <= INLINE_TEXT) {
+		std::memcpy(record->text.data(), msg.payload.data(), msg.payload.size());
+	}
+	else {
+		record->overflow.assign(msg.payload.data(), msg.payload.size());
+	}
+
+	publish(*record, pos);
+}
+
+void AsyncConsoleSink::drain() {
+	spdlog::memory_buf_t formatted;
+	std::string decoded;
+
+	for (;;) {
+		Record& record = records_[dequeuePos_ & mask_];
+		if (record.sequence.load(std::memory_order_acquire) != dequeuePos_ + 1) break;
+
+		const char* data = record.textLength <= INLINE_TEXT ? record.text.data() : record.overflow.data();
+		spdlog::string_view_t payload(data, record.textLength);
+		spdlog::string_view_t name(record.name.data(), record.nameLength);
+
+		// LUN_LOG records only carry their arguments, they get formatted here
+		if (!record.format.empty()) {
+			decoded = BinaryLog::DecodeArgs(record.format, record.argCount,
+				std::as_bytes(std::span(data, record.textLength)));
+			payload = spdlog::string_view_t(decoded.data(), decoded.size());
+			if (auto* logger = spdlog::default_logger_raw()) name = logger->name();
+		}
+
+		spdlog::details::log_msg msg(record.time, spdlog::source_loc{}, name, record.level, payload);
+		msg.thread_id = record.threadId;
+
+		formatted.clear();
+		formatter_->format(msg, formatted);
+		output_(record.level, std::string_view(formatted.data(), formatted.size()));
+
+		// Hand the slot back to the producers one lap ahead
+		record.overflow.clear();
+		record.sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+		++dequeuePos_;
+	}
+
+	if (std::size_t dropped = dropped_.exchange(0, std::memory_order_relaxed)) {
+		output_(spdlog::level::warn, std::format("[Console] Dropped {} log message(s), the queue was full\n", dropped));
+	}
+}
+
+void AsyncConsoleSink::flush_() { /* Drained by its owner */ }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "pch.h"
+
+#include "binary_log.h"
+
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/details/os.h>
+
+namespace Lunatic {
+	/// <summary>
+	/// Console sink for the async logging mode. Logging only copies the message into a
+	/// preallocated ring of records (a lock-free bounded MPSC queue), pattern formatting
+	/// and the console push happen when the owner drains it once per frame. LUN_LOG calls
+	/// skip spdlog's payload formatting too: while the sink is active they queue the format
+	/// string and the raw arguments, encoded like BinaryLog does, and drain() formats them.
+	/// </summary>
+	class AsyncConsoleSink : public spdlog::sinks::base_sink<spdlog::details::null_mutex> {
+	public:
+		static constexpr std::size_t DEFAULT_CAPACITY = 4096; // must be a power of two
+
+		// Receives every drained line, already pattern formatted
+		using Output = std::function<void(spdlog::level::level_enum level, std::string_view text)>;
+
+		explicit AsyncConsoleSink(Output output, std::size_t capacity = DEFAULT_CAPACITY);
+		~AsyncConsoleSink() override;
+
+		// LUN_LOG hands its arguments to the active sink, at most one is active at a time
+		static AsyncConsoleSink* GetActive() { return sm_active.load(std::memory_order_acquire); }
+		static void SetActive(AsyncConsoleSink* sink) { sm_active.store(sink, std::memory_order_release); }
+
+		// Queues a message without formatting it, format has to outlive the drain (literals do)
+		template<typename... Args>
+		void write(spdlog::level::level_enum level, std::string_view format, const Args&... args) {
+			static_assert(sizeof...(Args) <= 255, "Too many log arguments");
+
+			std::size_t pos = 0;
+			Record* record = claim(pos);
+			if (!record) return;
+
+			record->time = spdlog::log_clock::now();
+			record->threadId = spdlog::details::os::thread_id();
+			record->level = level;
+			record->nameLength = 0;
+			record->format = format;
+			record->argCount = static_cast<std::uint8_t>(sizeof...(Args));
+			BinaryLog::EncodeArgs([record](std::size_t size) {
+				record->textLength = static_cast<std::uint32_t>(size);
+				if (size <= INLINE_TEXT) return reinterpret_cast<std::byte*>(record->text.data());
+
+				record->overflow.resize(size);
+				return reinterpret_cast<std::byte*>(record->overflow.data());
+				}, args...);
+
+			publish(*record, pos);
+		}
+
+		// Main thread only, formats and forwards everything logged since the last call
+		void drain();
+
+	protected:
+		void sink_it_(const spdlog::details::log_msg& msg) override;
+		void flush_() override;
+
+	private:
+		static constexpr std::size_t INLINE_TEXT = 256;
+		static constexpr std::size_t MAX_LOGGER_NAME = 32;
+
+		struct Record {
+			std::atomic<std::size_t> sequence;
+			spdlog::log_clock::time_point time;
+			std::size_t threadId = 0;
+			spdlog::level::level_enum level = spdlog::level::info;
+			std::uint8_t nameLength = 0;
+			std::uint8_t argCount = 0;
+			std::uint32_t textLength = 0;
+			std::string_view format; // empty if text holds a formatted payload, else encoded arguments
+			std::array<char, MAX_LOGGER_NAME> name{};
+			std::array<char, INLINE_TEXT> text{};
+			std::string overflow; // only for payloads longer than INLINE_TEXT
+		};
+
+		Output output_;
+		std::unique_ptr<Record[]> records_;
+		std::size_t mask_;
+
+		alignas(64) std::atomic<std::size_t> enqueuePos_ = 0;
+		alignas(64) std::size_t dequeuePos_ = 0;
+		std::atomic<std::size_t> dropped_ = 0;
+
+		static std::atomic<AsyncConsoleSink*> sm_active;
+
+		// Null if the ring is full, a claimed record has to be published
+		Record* claim(std::size_t& pos);
+		void publish(Record& record, std::size_t pos);
+	};
+} // namespace Lunatic
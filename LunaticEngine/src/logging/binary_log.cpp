@@ -0,0 +1,215 @@
+#include "pch.h"
+
+#include "binary_log.h"
+
+#include <fmt/args.h>
+#include <spdlog/details/os.h>
+
+using namespace Lunatic;
+
+std::atomic<BinaryLog*> BinaryLog::sm_active = nullptr;
+std::mutex BinaryLog::sm_formatMutex;
+std::vector<std::string_view> BinaryLog::sm_formats;
+
+static constexpr std::size_t RECORD_ALIGNMENT = 8;
+
+static std::size_t alignedSize(std::size_t size) {
+	return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+static std::int64_t nowNanoseconds() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+BinaryLog::BinaryLog(const std::filesystem::path& path, std::size_t capacity)
+	: m_path(path), m_file(path, MappedFile::Mode::ReadWrite, std::max(capacity, sizeof(FileHeader))) {
+	// The file starts zeroed, so every record past the cursor reads as uncommitted
+	FileHeader& file = header();
+	file.magic = MAGIC;
+	file.version = VERSION;
+	file.headerSize = sizeof(FileHeader);
+	file.capacity = m_file.size();
+	file.startTime = nowNanoseconds();
+	std::atomic_ref(file.cursor).store(sizeof(FileHeader), std::memory_order_release);
+}
+
+BinaryLog::~BinaryLog() {
+	BinaryLog* self = this;
+	sm_active.compare_exchange_strong(self, nullptr);
+	m_file.flush();
+}
+
+void BinaryLog::SetActive(BinaryLog* log) {
+	std::lock_guard lock(sm_formatMutex);
+
+	// Formats interned before this capture started must be in the file before any message using them
+	if (log) {
+		for (std::size_t id = 0; id < sm_formats.size(); ++id) {
+			log->writeFormat(static_cast<std::uint32_t>(id), sm_formats[id]);
+		}
+	}
+	sm_active.store(log, std::memory_order_release);
+}
+
+std::uint32_t BinaryLog::Intern(std::string_view format) {
+	std::lock_guard lock(sm_formatMutex);
+
+	auto id = static_cast<std::uint32_t>(sm_formats.size());
+	sm_formats.push_back(format);
+
+	if (BinaryLog* log = sm_active.load(std::memory_order_acquire)) {
+		log->writeFormat(id, format);
+	}
+	return id;
+}
+
+std::size_t BinaryLog::getUsedBytes() const {
+	auto cursor = std::atomic_ref(const_cast<FileHeader&>(header()).cursor).load(std::memory_order_relaxed);
+	return static_cast<std::size_t>(std::min<std::uint64_t>(cursor, m_file.size()));
+}
+
+std::uint64_t BinaryLog::getDroppedCount() const {
+	return std::atomic_ref(const_cast<FileHeader&>(header()).dropped).load(std::memory_order_relaxed);
+}
+
+std::byte* BinaryLog::reserve(std::size_t size) {
+	size = alignedSize(size);
+
+	std::uint64_t offset = std::atomic_ref(header().cursor).fetch_add(size, std::memory_order_relaxed);
+	if (offset + size > m_file.size()) {
+		std::atomic_ref(header().dropped).fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	return m_file.data() + offset;
+}
+
+void BinaryLog::commit(std::byte* record, std::size_t size, RecordType type,
+	spdlog::level::level_enum level, std::uint8_t argCount, std::uint32_t formatId) {
+	auto* fields = reinterpret_cast<RecordHeader*>(record);
+	fields->type = type;
+	fields->level = static_cast<std::uint8_t>(level);
+	fields->argCount = argCount;
+	fields->formatId = formatId;
+	fields->threadId = static_cast<std::uint32_t>(spdlog::details::os::thread_id());
+	fields->timestamp = nowNanoseconds();
+
+	// Readers stop at a record whose size is still zero, so it has to be published last
+	std::atomic_ref(fields->size).store(static_cast<std::uint32_t>(alignedSize(size)), std::memory_order_release);
+}
+
+void BinaryLog::writeFormat(std::uint32_t formatId, std::string_view format) {
+	std::size_t size = sizeof(RecordHeader) + format.size();
+	std::byte* record = reserve(size);
+	if (!record) return;
+
+	std::memcpy(record + sizeof(RecordHeader), format.data(), format.size());
+	commit(record, size, RecordType::Format, spdlog::level::off, 0, formatId);
+}
+
+static void writeTag(std::byte*& out, BinaryLog::ArgType type) {
+	*out++ = static_cast<std::byte>(type);
+}
+
+template<typename T>
+static void writeRaw(std::byte*& out, const T& value) {
+	std::memcpy(out, &value, sizeof(T));
+	out += sizeof(T);
+}
+
+void BinaryLog::encodeArg(std::byte*& out, bool value) {
+	writeTag(out, ArgType::Bool);
+	writeRaw(out, static_cast<std::uint8_t>(value));
+}
+
+void BinaryLog::encodeArg(std::byte*& out, char value) {
+	writeTag(out, ArgType::Char);
+	writeRaw(out, value);
+}
+
+void BinaryLog::encodeArg(std::byte*& out, std::int64_t value) {
+	writeTag(out, ArgType::Int);
+	writeRaw(out, value);
+}
+
+void BinaryLog::encodeArg(std::byte*& out, std::uint64_t value) {
+	writeTag(out, ArgType::UInt);
+	writeRaw(out, value);
+}
+
+void BinaryLog::encodeArg(std::byte*& out, double value) {
+	writeTag(out, ArgType::Float);
+	writeRaw(out, value);
+}
+
+void BinaryLog::encodeArg(std::byte*& out, const void* value) {
+	writeTag(out, ArgType::Pointer);
+	writeRaw(out, static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(value)));
+}
+
+void BinaryLog::encodeArg(std::byte*& out, const StringArg& value) {
+	writeTag(out, ArgType::String);
+	writeRaw(out, static_cast<std::uint32_t>(value.value.size()));
+	std::memcpy(out, value.value.data(), value.value.size());
+	out += value.value.size();
+}
+
+void BinaryLog::encodeArg(std::byte*& out, const std::string& value) {
+	encodeArg(out, StringArg{ value });
+}
+
+template<typename T>
+static bool readRaw(std::span<const std::byte>& in, T& value) {
+	if (in.size() < sizeof(T)) return false;
+	std::memcpy(&value, in.data(), sizeof(T));
+	in = in.subspan(sizeof(T));
+	return true;
+}
+
+std::string BinaryLog::DecodeArgs(std::string_view format, std::size_t argCount, std::span<const std::byte> payload) {
+	// Strings point straight into the payload, which outlives the vformat call
+	fmt::dynamic_format_arg_store<fmt::format_context> args;
+	for (std::size_t i = 0; i < argCount; ++i) {
+		ArgType type{};
+		if (!readRaw(payload, type)) break;
+
+		bool ok = true;
+		switch (type) {
+		case ArgType::Int: { std::int64_t value = 0; ok = readRaw(payload, value); args.push_back(value); break; }
+		case ArgType::UInt: { std::uint64_t value = 0; ok = readRaw(payload, value); args.push_back(value); break; }
+		case ArgType::Float: { double value = 0; ok = readRaw(payload, value); args.push_back(value); break; }
+		case ArgType::Bool: { std::uint8_t value = 0; ok = readRaw(payload, value); args.push_back(value != 0); break; }
+		case ArgType::Char: { char value = 0; ok = readRaw(payload, value); args.push_back(value); break; }
+		case ArgType::Pointer: {
+			std::uint64_t value = 0;
+			ok = readRaw(payload, value);
+			args.push_back(reinterpret_cast<const void*>(static_cast<std::uintptr_t>(value)));
+			break;
+		}
+		case ArgType::String: {
+			std::uint32_t length = 0;
+			ok = readRaw(payload, length) && payload.size() >= length;
+			if (ok) {
+				args.push_back(fmt::string_view(reinterpret_cast<const char*>(payload.data()), length));
+				payload = payload.subspan(length);
+			}
+			break;
+		}
+		default:
+			ok = false;
+			break;
+		}
+
+		if (!ok) {
+			return std::format("<corrupt record for \"{}\">", format);
+		}
+	}
+
+	try {
+		return fmt::vformat(fmt::string_view(format.data(), format.size()), args);
+	}
+	catch (const fmt::format_error& e) {
+		return std::format("{} <format error: {}>", format, e.what());
+	}
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "pch.h"
+
+#include "core/mapped_file.h"
+
+#include <fmt/format.h>
+
+namespace Lunatic {
+	/// <summary>
+	/// Structured binary log capture. Instead of formatting text, a log call appends a record
+	/// holding the interned format string id, level, timestamp, thread and the raw arguments
+	/// to a memory-mapped, append-only file. Formatting happens later, in BinaryLogReader.
+	/// Writers only contend on one atomic cursor, a full capture drops (and counts) records.
+	/// </summary>
+	class BinaryLog {
+	public:
+		static constexpr std::size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+		static constexpr std::uint32_t VERSION = 1;
+		static constexpr std::array<char, 8> MAGIC = { 'L', 'U', 'N', 'B', 'L', 'O', 'G', '\0' };
+
+		struct FileHeader {
+			std::array<char, 8> magic;
+			std::uint32_t version;
+			std::uint32_t headerSize;
+			std::uint64_t capacity;
+			std::int64_t startTime;  // ns since the system clock epoch
+			std::uint64_t cursor;    // end of the reserved records, may run past capacity once full
+			std::uint64_t dropped;
+		};
+
+		enum class RecordType : std::uint16_t {
+			Format = 1, // payload is the format string for formatId
+			Message = 2 // payload is argCount encoded arguments
+		};
+
+		enum class ArgType : std::uint8_t {
+			Int,     // int64
+			UInt,    // uint64
+			Float,   // double
+			Bool,    // uint8
+			Char,    // char
+			String,  // uint32 length + bytes
+			Pointer  // uint64
+		};
+
+		// Records are 8-byte aligned, size is written last and doubles as the commit flag
+		struct RecordHeader {
+			std::uint32_t size;
+			RecordType type;
+			std::uint8_t level;
+			std::uint8_t argCount;
+			std::uint32_t formatId;
+			std::uint32_t threadId;
+			std::int64_t timestamp; // ns since the system clock epoch
+		};
+
+		// Throws std::runtime_error if the file cannot be created
+		explicit BinaryLog(const std::filesystem::path& path, std::size_t capacity = DEFAULT_CAPACITY);
+		// Deactivate first and make sure no thread is still writing
+		~BinaryLog();
+
+		BinaryLog(const BinaryLog&) = delete;
+		BinaryLog& operator=(const BinaryLog&) = delete;
+
+		// LUN_LOG writes to the active capture, at most one is active at a time
+		static BinaryLog* GetActive() { return sm_active.load(std::memory_order_acquire); }
+		static void SetActive(BinaryLog* log);
+
+		// Format strings must outlive every capture, which string literals do
+		static std::uint32_t Intern(std::string_view format);
+
+		bool shouldLog(spdlog::level::level_enum level) const { return level >= m_level; }
+		void setLevel(spdlog::level::level_enum level) { m_level = level; }
+
+		template<typename... Args>
+		void write(spdlog::level::level_enum level, std::uint32_t formatId, const Args&... args) {
+			static_assert(sizeof...(Args) <= 255, "Too many log arguments");
+
+			std::byte* record = nullptr;
+			std::size_t size = 0;
+			EncodeArgs([&](std::size_t payloadSize) -> std::byte* {
+				size = sizeof(RecordHeader) + payloadSize;
+				record = reserve(size);
+				return record ? record + sizeof(RecordHeader) : nullptr;
+				}, args...);
+			if (!record) return;
+
+			commit(record, size, RecordType::Message, level, static_cast<std::uint8_t>(sizeof...(Args)), formatId);
+		}
+
+		// Encodes args as ArgType tagged values into the buffer allocate(size) returns, nothing
+		// is written if it returns null. Also used by AsyncConsoleSink.
+		template<typename Allocate, typename... Args>
+		static void EncodeArgs(Allocate&& allocate, const Args&... args) {
+			// Normalize first so strings and eagerly formatted values are only measured once
+			auto encoded = std::make_tuple(toArg(args)...);
+			std::size_t size = std::apply([](const auto&... arg) {
+				return (std::size_t(0) + ... + argSize(arg));
+				}, encoded);
+
+			std::byte* out = allocate(size);
+			if (!out) return;
+			std::apply([&out](const auto&... arg) { (encodeArg(out, arg), ...); }, encoded);
+		}
+
+		// Formats argCount arguments written by EncodeArgs, a malformed payload or format
+		// comes back as a marked up message instead of throwing
+		static std::string DecodeArgs(std::string_view format, std::size_t argCount, std::span<const std::byte> payload);
+
+		const std::filesystem::path& getPath() const { return m_path; }
+		std::size_t getUsedBytes() const;
+		std::uint64_t getDroppedCount() const;
+		void flush() { m_file.flush(); }
+
+	private:
+		struct StringArg {
+			std::string_view value;
+		};
+
+		std::filesystem::path m_path;
+		MappedFile m_file;
+		std::atomic<spdlog::level::level_enum> m_level = spdlog::level::trace;
+
+		static std::atomic<BinaryLog*> sm_active;
+		static std::mutex sm_formatMutex;
+		static std::vector<std::string_view> sm_formats;
+
+		FileHeader& header() { return *reinterpret_cast<FileHeader*>(m_file.data()); }
+		const FileHeader& header() const { return *reinterpret_cast<const FileHeader*>(m_file.data()); }
+
+		std::byte* reserve(std::size_t size);
+		void commit(std::byte* record, std::size_t size, RecordType type,
+			spdlog::level::level_enum level, std::uint8_t argCount, std::uint32_t formatId);
+		void writeFormat(std::uint32_t formatId, std::string_view format);
+
+		template<typename T>
+		static auto toArg(const T& value) {
+			if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, char>) return value;
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) return static_cast<std::int64_t>(value);
+			else if constexpr (std::is_integral_v<T>) return static_cast<std::uint64_t>(value);
+			else if constexpr (std::is_floating_point_v<T>) return static_cast<double>(value);
+			else if constexpr (std::is_convertible_v<const T&, std::string_view>) return StringArg{ std::string_view(value) };
+			else if constexpr (std::is_pointer_v<T>) return static_cast<const void*>(value);
+			else return fmt::format("{}", value); // No raw encoding, formatted now
+		}
+
+		static std::size_t argSize(const StringArg& arg) { return 1 + sizeof(std::uint32_t) + arg.value.size(); }
+		static std::size_t argSize(const std::string& arg) { return 1 + sizeof(std::uint32_t) + arg.size(); }
+		static std::size_t argSize(const void*) { return 1 + sizeof(std::uint64_t); }
+		template<typename T>
+		static std::size_t argSize(const T&) { return 1 + sizeof(T); }
+
+		static void encodeArg(std::byte*& out, bool value);
+		static void encodeArg(std::byte*& out, char value);
+		static void encodeArg(std::byte*& out, std::int64_t value);
+		static void encodeArg(std::byte*& out, std::uint64_t value);
+		static void encodeArg(std::byte*& out, double value);
+		static void encodeArg(std::byte*& out, const void* value);
+		static void encodeArg(std::byte*& out, const StringArg& value);
+		static void encodeArg(std::byte*& out, const std::string& value);
+	};
+} // namespace Lunatic
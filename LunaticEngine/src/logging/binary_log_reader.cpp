@@ -0,0 +1,65 @@
+#include "pch.h"
+
+#include "binary_log_reader.h"
+
+using namespace Lunatic;
+
+using RecordType = BinaryLog::RecordType;
+using RecordHeader = BinaryLog::RecordHeader;
+
+BinaryLogReader::BinaryLogReader(const std::filesystem::path& path)
+	: m_file(path, MappedFile::Mode::Read) {
+	LUN_ASSERT(m_file.size() >= sizeof(BinaryLog::FileHeader), "File is too small to be a binary log")
+
+	const auto& header = *reinterpret_cast<const BinaryLog::FileHeader*>(m_file.data());
+	LUN_ASSERT(header.magic == BinaryLog::MAGIC, "File is not a binary log")
+	LUN_ASSERT(header.version == BinaryLog::VERSION, "Unsupported binary log version")
+
+	m_end = static_cast<std::size_t>(std::min<std::uint64_t>(header.cursor, m_file.size()));
+	m_offset = header.headerSize;
+	m_dropped = header.dropped;
+
+	// Formats can be interned on any thread, so collect all of them before decoding messages
+	for (std::size_t offset = m_offset; const RecordHeader* record = recordAt(offset); offset += record->size) {
+		if (record->type == RecordType::Format) {
+			std::string_view text(reinterpret_cast<const char*>(record + 1), record->size - sizeof(RecordHeader));
+			m_formats[record->formatId] = text.substr(0, text.find('\0')); // Drop the alignment padding
+		}
+	}
+}
+
+const RecordHeader* BinaryLogReader::recordAt(std::size_t offset) const {
+	if (offset + sizeof(RecordHeader) > m_end) return nullptr;
+
+	auto* record = reinterpret_cast<const RecordHeader*>(m_file.data() + offset);
+	std::uint32_t size = std::atomic_ref(const_cast<std::uint32_t&>(record->size)).load(std::memory_order_acquire);
+
+	// Uncommitted (still being written, or the writer died) or corrupt, either way the end
+	if (size < sizeof(RecordHeader) || offset + size > m_end) return nullptr;
+	return record;
+}
+
+bool BinaryLogReader::next(Entry& out) {
+	while (const RecordHeader* record = recordAt(m_offset)) {
+		m_offset += record->size;
+		if (record->type != RecordType::Message) continue;
+
+		auto payload = std::span(reinterpret_cast<const std::byte*>(record + 1), record->size - sizeof(RecordHeader));
+
+		out.level = static_cast<spdlog::level::level_enum>(record->level);
+		out.time = std::chrono::system_clock::time_point(
+			std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(record->timestamp)));
+		out.threadId = record->threadId;
+		out.text = decode(*record, payload);
+		return true;
+	}
+	return false;
+}
+
+std::string BinaryLogReader::decode(const RecordHeader& record, std::span<const std::byte> payload) const {
+	auto format = m_formats.find(record.formatId);
+	if (format == m_formats.end()) {
+		return std::format("<unknown format #{}>", record.formatId);
+	}
+	return BinaryLog::DecodeArgs(format->second, record.argCount, payload);
+}
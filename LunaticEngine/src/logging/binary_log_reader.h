@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pch.h"
+
+#include "binary_log.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Decodes a BinaryLog capture back into text. The file is mapped read-only, format
+	/// strings are collected up front and each message is formatted on demand from its
+	/// stored arguments. Works on a capture that is still being written, reading stops at
+	/// the first record that isn't committed yet.
+	/// </summary>
+	class BinaryLogReader {
+	public:
+		struct Entry {
+			spdlog::level::level_enum level = spdlog::level::info;
+			std::chrono::system_clock::time_point time;
+			std::size_t threadId = 0;
+			std::string text;
+		};
+
+		// Throws std::runtime_error if the file is missing or isn't a capture
+		explicit BinaryLogReader(const std::filesystem::path& path);
+
+		// Decodes the next message, false once the end of the capture is reached
+		bool next(Entry& out);
+
+		std::uint64_t getDroppedCount() const { return m_dropped; }
+
+	private:
+		MappedFile m_file;
+		std::size_t m_end = 0;
+		std::size_t m_offset = 0;
+		std::uint64_t m_dropped = 0;
+		std::unordered_map<std::uint32_t, std::string_view> m_formats;
+
+		const BinaryLog::RecordHeader* recordAt(std::size_t offset) const;
+		std::string decode(const BinaryLog::RecordHeader& record, std::span<const std::byte> payload) const;
+	};
+} // namespace Lunatic
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "pch.h"
+
+#include "binary_log.h"
+#include "async_console_sink.h"
+
+// Logs through the active binary capture if there is one, otherwise through spdlog as usual.
+// The format id is interned once per call site, so a capture only stores it and the raw arguments.
+// With an active AsyncConsoleSink the arguments are queued raw as well and formatted when it drains.
+// Arguments are only evaluated once the level is known to be enabled.
+#define LUN_LOG(level, format, ...) \
+	do { \
+		if (::Lunatic::BinaryLog* lunLog_ = ::Lunatic::BinaryLog::GetActive()) { \
+			if (lunLog_->shouldLog(level)) { \
+				static const std::uint32_t lunFormatId_ = ::Lunatic::BinaryLog::Intern(format); \
+				lunLog_->write(level, lunFormatId_, ##__VA_ARGS__); \
+			} \
+		} \
+		else if (spdlog::should_log(level)) { \
+			if (::Lunatic::AsyncConsoleSink* lunSink_ = ::Lunatic::AsyncConsoleSink::GetActive()) { \
+				lunSink_->write(level, format, ##__VA_ARGS__); \
+			} \
+			else { \
+				spdlog::log(level, format, ##__VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+// Compile-time floor for the LUN_TRACE..LUN_CRITICAL macros, using spdlog's SPDLOG_LEVEL_* values.
+// Calls below it compile to nothing, arguments included. Release builds keep info and up.
+#ifndef LUN_LOG_ACTIVE_LEVEL
+#ifdef NDEBUG
+#define LUN_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_INFO
+#else
+#define LUN_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+#endif
+
+// Above the floor the runtime level is checked before any argument is evaluated, see LUN_LOG
+#if LUN_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define LUN_TRACE(...) LUN_LOG(spdlog::level::trace, __VA_ARGS__)
+#else
+#define LUN_TRACE(...) (void)0
+#endif
+
+#if LUN_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define LUN_DEBUG(...) LUN_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+#define LUN_DEBUG(...) (void)0
+#endif
+
+#if LUN_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_INFO
+#define LUN_INFO(...) LUN_LOG(spdlog::level::info, __VA_ARGS__)
+#else
+#define LUN_INFO(...) (void)0
+#endif
+
+#if LUN_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define LUN_WARN(...) LUN_LOG(spdlog::level::warn, __VA_ARGS__)
+#else
+#define LUN_WARN(...) (void)0
+#endif
+
+#if LUN_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define LUN_ERROR(...) LUN_LOG(spdlog::level::err, __VA_ARGS__)
+#else
+#define LUN_ERROR(...) (void)0
+#endif
+
+#if LUN_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_CRITICAL
+#define LUN_CRITICAL(...) LUN_LOG(spdlog::level::critical, __VA_ARGS__)
+#else
+#define LUN_CRITICAL(...) (void)0
+#endif
@@ -35,6 +35,7 @@
 #include <format>
 #include <cstdint>
 #include <vector>
+#include <deque>
 #include <array>
 #include <unordered_set>
 #include <unordered_map>
@@ -42,9 +43,18 @@
 #include <algorithm>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <bit>
 
 #define LUN_ASSERT(x, msg) \
 	if (!(x)) throw std::runtime_error(std::format("Assertion failed: {} ({}:{})", msg, __FILE__, __LINE__));
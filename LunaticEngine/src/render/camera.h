@@ -24,6 +24,8 @@ namespace Lunatic {
 		glm::mat4 getViewProjection() const;
 		glm::mat4 getView() const { return m_view; }
 		glm::mat4 getProjection() const { return m_projection; }
+		float getNearPlane() const { return m_nearPlane; }
+		float getFarPlane() const { return m_farPlane; }
 		const glm::vec2& getViewportSize() const { return m_viewportSize; }
 		const glm::vec3& getPosition() const { return m_position; }
 		const glm::vec3& getForward() const { return m_forward; }
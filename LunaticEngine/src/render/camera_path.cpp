@@ -0,0 +1,78 @@
+#include "pch.h"
+
+#include "camera_path.h"
+
+#include <glm/gtc/constants.hpp>
+
+using namespace Lunatic;
+
+static float lerpAngle(float from, float to, float t) {
+	float delta = std::fmod(to - from, 360.0f);
+	if (delta > 180.0f) delta -= 360.0f;
+	else if (delta < -180.0f) delta += 360.0f;
+	return from + delta * t;
+}
+
+void CameraPath::add(const Keyframe& keyframe) {
+	auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), keyframe.time,
+		[](float value, const Keyframe& other) { return value < other.time; });
+	m_keyframes.insert(it, keyframe);
+}
+
+CameraPath::Keyframe CameraPath::sample(float time) const {
+	if (m_keyframes.empty()) return {};
+	if (time <= m_keyframes.front().time) return m_keyframes.front();
+	if (time >= m_keyframes.back().time) return m_keyframes.back();
+
+	auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time,
+		[](float value, const Keyframe& other) { return value < other.time; });
+	const Keyframe& a = *(next - 1);
+	const Keyframe& b = *next;
+	const float t = (time - a.time) / (b.time - a.time);
+
+	return { time, glm::mix(a.position, b.position, t), glm::mix(a.pitch, b.pitch, t), lerpAngle(a.yaw, b.yaw, t) };
+}
+
+void CameraPath::apply(Camera& camera, float time) const {
+	if (m_keyframes.empty()) return;
+
+	const Keyframe keyframe = sample(time);
+	camera.setPosition(keyframe.position);
+	camera.setRotation(keyframe.pitch, keyframe.yaw);
+}
+
+CameraPath CameraPath::Load(const std::filesystem::path& path) {
+	std::ifstream file(path);
+	if (!file) throw std::runtime_error(std::format("Failed to open camera path {}", path.string()));
+
+	CameraPath cameraPath;
+	std::string line;
+	for (std::size_t number = 1; std::getline(file, line); ++number) {
+		if (auto comment = line.find('#'); comment != std::string::npos) line.erase(comment);
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+		std::istringstream stream(line);
+		Keyframe keyframe;
+		if (!(stream >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.pitch >> keyframe.yaw)) {
+			throw std::runtime_error(std::format("{}:{}: expected \"time x y z pitch yaw\"", path.string(), number));
+		}
+		cameraPath.add(keyframe);
+	}
+	return cameraPath;
+}
+
+CameraPath CameraPath::Orbit(const glm::vec3& center, float radius, float height, float duration, std::size_t steps) {
+	CameraPath cameraPath;
+	steps = std::max<std::size_t>(steps, 2);
+
+	const float pitch = -glm::degrees(std::atan2(height, radius));
+	for (std::size_t i = 0; i <= steps; ++i) {
+		const float t = static_cast<float>(i) / static_cast<float>(steps);
+		const float angle = t * glm::two_pi<float>();
+		const glm::vec3 offset(std::cos(angle) * radius, height, std::sin(angle) * radius);
+		// Facing the center, yaw is measured from +X towards +Z
+		const float yaw = glm::degrees(std::atan2(-offset.z, -offset.x));
+		cameraPath.add({ t * duration, center + offset, pitch, yaw });
+	}
+	return cameraPath;
+}
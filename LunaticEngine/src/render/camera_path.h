@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pch.h"
+
+#include "render/camera.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Keyframed camera flight for repeatable runs. Positions are interpolated linearly and
+	/// angles along the shorter way around, so the same time always gives the same view.
+	/// Before the first and after the last keyframe the camera holds still.
+	/// </summary>
+	class CameraPath {
+	public:
+		struct Keyframe {
+			float time = 0.0f; // seconds
+			glm::vec3 position{ 0.0f };
+			float pitch = 0.0f; // degrees
+			float yaw = -90.0f;
+		};
+
+		// Keyframes may come in any order, they are kept sorted by time
+		void add(const Keyframe& keyframe);
+		Keyframe sample(float time) const;
+		void apply(Camera& camera, float time) const;
+
+		float getDuration() const { return m_keyframes.empty() ? 0.0f : m_keyframes.back().time; }
+		bool empty() const { return m_keyframes.empty(); }
+		const std::vector<Keyframe>& getKeyframes() const { return m_keyframes; }
+
+		// One keyframe per line, "time x y z pitch yaw", '#' starts a comment.
+		// Throws std::runtime_error if the file cannot be read or a line doesn't parse.
+		static CameraPath Load(const std::filesystem::path& path);
+		// Circles center once over duration, looking at it from height above
+		static CameraPath Orbit(const glm::vec3& center, float radius, float height, float duration, std::size_t steps = 16);
+
+	private:
+		std::vector<Keyframe> m_keyframes;
+	};
+} // namespace Lunatic
@@ -1 +1,162 @@
-#include "pch.h"
\ No newline at end of file
+#include "pch.h"
+
+#include "framebuffer.h"
+
+#include "logging/log.h"
+
+using namespace Lunatic;
+
+static GLuint createAttachment(GLenum format, const glm::ivec2& size, std::int32_t samples) {
+	GLuint texture;
+	if (samples > 1) {
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &texture);
+		glTextureStorage2DMultisample(texture, samples, format, size.x, size.y, GL_TRUE);
+		return texture;
+	}
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, format, size.x, size.y);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+static void checkComplete(GLuint framebuffer) {
+	GLenum status = glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER);
+	LUN_ASSERT(status == GL_FRAMEBUFFER_COMPLETE, std::format("Framebuffer incomplete, status 0x{:X}", status))
+}
+
+Framebuffer::Framebuffer(const Spec& spec) : m_spec(spec) {
+	LUN_ASSERT(spec.samples >= 1, "Framebuffers need at least one sample")
+	m_spec.size = glm::max(spec.size, glm::ivec2(1));
+	create();
+}
+
+Framebuffer::~Framebuffer() {
+	for (Readback& readback : m_readbacks) {
+		if (readback.fence) glDeleteSync(readback.fence);
+		glDeleteBuffers(1, &readback.buffer);
+	}
+	destroy();
+}
+
+void Framebuffer::create() {
+	glCreateFramebuffers(1, &m_framebuffer);
+	m_color = createAttachment(m_spec.colorFormat, m_spec.size, m_spec.samples);
+	glNamedFramebufferTexture(m_framebuffer, GL_COLOR_ATTACHMENT0, m_color, 0);
+	if (m_spec.depthFormat) {
+		m_depth = createAttachment(m_spec.depthFormat, m_spec.size, m_spec.samples);
+		const bool stencil = m_spec.depthFormat == GL_DEPTH24_STENCIL8 || m_spec.depthFormat == GL_DEPTH32F_STENCIL8;
+		glNamedFramebufferTexture(m_framebuffer, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, m_depth, 0);
+	}
+	checkComplete(m_framebuffer);
+
+	if (m_spec.samples > 1) {
+		glCreateFramebuffers(1, &m_resolveFramebuffer);
+		m_resolveColor = createAttachment(m_spec.colorFormat, m_spec.size, 1);
+		glNamedFramebufferTexture(m_resolveFramebuffer, GL_COLOR_ATTACHMENT0, m_resolveColor, 0);
+		checkComplete(m_resolveFramebuffer);
+	}
+
+	LUN_DEBUG("Framebuffer::create - {}x{}, {} samples", m_spec.size.x, m_spec.size.y, m_spec.samples);
+}
+
+void Framebuffer::destroy() {
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteFramebuffers(1, &m_resolveFramebuffer);
+	glDeleteTextures(1, &m_color);
+	glDeleteTextures(1, &m_depth);
+	glDeleteTextures(1, &m_resolveColor);
+	m_framebuffer = m_resolveFramebuffer = m_color = m_depth = m_resolveColor = 0;
+}
+
+void Framebuffer::resize(const glm::ivec2& size) {
+	const glm::ivec2 clamped = glm::max(size, glm::ivec2(1));
+	if (clamped == m_spec.size) return;
+
+	// Readbacks in flight own their buffers, the copies already queued stay valid
+	destroy();
+	m_spec.size = clamped;
+	create();
+}
+
+void Framebuffer::bind() const {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_spec.size.x, m_spec.size.y);
+}
+
+void Framebuffer::resolve() const {
+	if (m_spec.samples <= 1) return;
+
+	glBlitNamedFramebuffer(m_framebuffer, m_resolveFramebuffer, 0, 0, m_spec.size.x, m_spec.size.y,
+		0, 0, m_spec.size.x, m_spec.size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+void Framebuffer::blitTo(GLuint target, const glm::ivec2& size) const {
+	const GLenum filter = size == m_spec.size ? GL_NEAREST : GL_LINEAR;
+	glBlitNamedFramebuffer(getResolvedId(), target, 0, 0, m_spec.size.x, m_spec.size.y,
+		0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, filter);
+}
+
+std::uint64_t Framebuffer::requestReadback() {
+	auto free = std::find_if(m_readbacks.begin(), m_readbacks.end(), [](const Readback& readback) { return !readback.fence; });
+	if (free == m_readbacks.end()) return 0;
+
+	const std::size_t bytes = std::size_t(m_spec.size.x) * m_spec.size.y * 4;
+	if (free->capacity < bytes) {
+		glDeleteBuffers(1, &free->buffer);
+		glCreateBuffers(1, &free->buffer);
+		glNamedBufferStorage(free->buffer, bytes, nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+		free->capacity = bytes;
+	}
+
+	// Into the pixel buffer, so the call returns as soon as the copy is queued
+	GLint previousRead = 0;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, getResolvedId());
+	glNamedFramebufferReadBuffer(getResolvedId(), GL_COLOR_ATTACHMENT0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, free->buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_spec.size.x, m_spec.size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(previousRead));
+
+	free->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	free->size = m_spec.size;
+	free->request = m_nextRequest++;
+	return free->request;
+}
+
+std::optional<Framebuffer::Capture> Framebuffer::pollReadback() {
+	Readback* oldest = nullptr;
+	for (Readback& readback : m_readbacks) {
+		if (readback.fence && (!oldest || readback.request < oldest->request)) oldest = &readback;
+	}
+	if (!oldest) return std::nullopt;
+
+	// A zero timeout only asks, the flush makes sure the fence gets to the GPU at all
+	GLenum status = glClientWaitSync(oldest->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return std::nullopt;
+
+	Capture capture;
+	capture.size = oldest->size;
+	capture.request = oldest->request;
+	const std::size_t bytes = std::size_t(oldest->size.x) * oldest->size.y * 4;
+
+	if (const void* mapped = glMapNamedBufferRange(oldest->buffer, 0, bytes, GL_MAP_READ_BIT)) {
+		capture.pixels.resize(bytes);
+		std::memcpy(capture.pixels.data(), mapped, bytes);
+		glUnmapNamedBuffer(oldest->buffer);
+	}
+
+	glDeleteSync(oldest->fence);
+	oldest->fence = nullptr;
+	return capture;
+}
+
+std::size_t Framebuffer::getPendingReadbacks() const {
+	return static_cast<std::size_t>(std::count_if(m_readbacks.begin(), m_readbacks.end(),
+		[](const Readback& readback) { return readback.fence != nullptr; }));
+}
@@ -1 +1,88 @@
 #pragma once
+
+#include "pch.h"
+
+#include <optional>
+
+namespace Lunatic {
+	/// <summary>
+	/// Offscreen render target with a color and a depth attachment, both textures. With more
+	/// than one sample it renders multisampled and resolve() blits into a single-sample color
+	/// texture, which is what getColorTexture() returns either way, so it can be sampled or
+	/// shown with ImGui::Image.
+	///
+	/// Readbacks copy the resolved color into a pixel buffer and put a fence behind the copy.
+	/// pollReadback() only maps buffers whose fence has signaled, so capturing a frame never
+	/// waits on the GPU. A few readbacks can be in flight, requests beyond that are dropped.
+	/// </summary>
+	class Framebuffer {
+	public:
+		static constexpr std::size_t MAX_READBACKS = 3;
+
+		struct Spec {
+			glm::ivec2 size{ 1, 1 };
+			std::int32_t samples = 1;
+			GLenum colorFormat = GL_RGBA8;
+			GLenum depthFormat = GL_DEPTH24_STENCIL8; // 0 for none
+		};
+
+		// RGBA8, the bottom row first like GL returns it
+		struct Capture {
+			glm::ivec2 size{ 0 };
+			std::vector<std::uint8_t> pixels;
+			std::uint64_t request = 0; // what requestReadback() returned
+		};
+
+		explicit Framebuffer(const Spec& spec);
+		~Framebuffer();
+
+		Framebuffer(const Framebuffer&) = delete;
+		Framebuffer& operator=(const Framebuffer&) = delete;
+
+		// Recreates the attachments when the size changed, their contents are lost
+		void resize(const glm::ivec2& size);
+		// Binds for drawing and sets the viewport to cover it
+		void bind() const;
+		// Multisampled color into the color texture, nothing to do with one sample
+		void resolve() const;
+		// Blits the resolved color to another framebuffer, 0 being the window, scaled to size
+		void blitTo(GLuint target, const glm::ivec2& size) const;
+
+		// 0 if all readbacks are in flight. Resolve first when multisampled.
+		std::uint64_t requestReadback();
+		// The oldest finished readback, without waiting for the ones still running. A readback
+		// whose buffer could not be mapped comes back with no pixels, so it can be let go of.
+		std::optional<Capture> pollReadback();
+		std::size_t getPendingReadbacks() const;
+
+		GLuint getId() const { return m_framebuffer; }
+		GLuint getColorTexture() const { return m_spec.samples > 1 ? m_resolveColor : m_color; }
+		GLuint getDepthTexture() const { return m_depth; } // multisampled if the framebuffer is
+		const glm::ivec2& getSize() const { return m_spec.size; }
+		std::int32_t getSamples() const { return m_spec.samples; }
+
+	private:
+		struct Readback {
+			GLuint buffer = 0;
+			std::size_t capacity = 0; // in bytes
+			GLsync fence = nullptr;
+			glm::ivec2 size{ 0 };
+			std::uint64_t request = 0;
+		};
+
+		Spec m_spec;
+		GLuint m_framebuffer = 0;
+		GLuint m_color = 0;
+		GLuint m_depth = 0;
+		GLuint m_resolveFramebuffer = 0; // only when multisampled
+		GLuint m_resolveColor = 0;
+
+		std::array<Readback, MAX_READBACKS> m_readbacks{};
+		std::uint64_t m_nextRequest = 1;
+
+		void create();
+		void destroy();
+		// The framebuffer holding the single-sample color
+		GLuint getResolvedId() const { return m_spec.samples > 1 ? m_resolveFramebuffer : m_framebuffer; }
+	};
+} // namespace Lunatic
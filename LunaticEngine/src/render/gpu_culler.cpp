@@ -0,0 +1,145 @@
+#include "pch.h"
+
+#include "gpu_culler.h"
+
+using namespace Lunatic;
+
+static constexpr GLuint CULL_GROUP_SIZE = 64;
+static constexpr GLuint HIZ_GROUP_SIZE = 8;
+static constexpr std::size_t DRAW_DATA_BYTES = 80; // mat4 and vec4, RenderQueue::DrawData
+
+GpuCuller::~GpuCuller() {
+	glDeleteBuffers(1, &m_recordBuffer);
+	glDeleteBuffers(1, &m_compactedBuffer);
+	glDeleteFramebuffers(1, &m_depthFramebuffer);
+	glDeleteTextures(1, &m_depthTexture);
+	glDeleteTextures(1, &m_hiZTexture);
+	glDeleteSamplers(1, &m_hiZSampler);
+}
+
+void GpuCuller::reserve(std::size_t records) {
+	if (records <= m_capacity) return;
+
+	glDeleteBuffers(1, &m_recordBuffer);
+	glDeleteBuffers(1, &m_compactedBuffer);
+	m_capacity = std::max(m_capacity * 2, records);
+
+	glCreateBuffers(1, &m_recordBuffer);
+	glNamedBufferData(m_recordBuffer, m_capacity * sizeof(CullRecord), nullptr, GL_DYNAMIC_DRAW);
+	glCreateBuffers(1, &m_compactedBuffer);
+	glNamedBufferData(m_compactedBuffer, m_capacity * DRAW_DATA_BYTES, nullptr, GL_DYNAMIC_COPY);
+}
+
+GLuint GpuCuller::cull(const glm::mat4& viewProjection, std::span<const CullRecord> records, GLuint drawData, GLuint commands) {
+	if (!m_cullShader) {
+		m_cullShader = std::make_unique<Shader>(Shader::Builtin::CullDraws);
+	}
+
+	reserve(records.size());
+	glNamedBufferSubData(m_recordBuffer, 0, records.size_bytes(), records.data());
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_compactedBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, drawData);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_recordBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commands);
+
+	m_cullShader->use();
+	m_cullShader->set("u_count", static_cast<int>(records.size()));
+
+	// Gribb-Hartmann: each plane is the last row plus or minus another
+	const glm::mat4 rows = glm::transpose(viewProjection);
+	const std::array<glm::vec4, 6> planes = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2]
+	};
+	for (std::size_t i = 0; i < planes.size(); ++i) {
+		m_cullShader->set(std::format("u_planes[{}]", i), planes[i] / glm::length(glm::vec3(planes[i])));
+	}
+
+	const bool useHiZ = m_hiZEnabled && m_hiZValid;
+	m_cullShader->set("u_useHiZ", useHiZ);
+	if (useHiZ) {
+		glm::vec2 size(m_hiZSize);
+		m_cullShader->set("u_previousViewProjection", m_hiZViewProjection);
+		m_cullShader->set("u_hiZSize", &size.x, 2);
+		m_cullShader->set("u_hiZ", 0);
+		glBindTextureUnit(0, m_hiZTexture);
+		glBindSampler(0, m_hiZSampler);
+	}
+
+	glDispatchCompute((static_cast<GLuint>(records.size()) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	// The counts are read by the indirect draws, the records by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if (useHiZ) {
+		glBindSampler(0, 0);
+	}
+	return m_compactedBuffer;
+}
+
+void GpuCuller::resizeHiZ(const glm::ivec2& size) {
+	glDeleteFramebuffers(1, &m_depthFramebuffer);
+	glDeleteTextures(1, &m_depthTexture);
+	glDeleteTextures(1, &m_hiZTexture);
+
+	m_hiZSize = size;
+	m_hiZLevels = static_cast<std::int32_t>(std::bit_width(static_cast<std::uint32_t>(std::max(size.x, size.y))));
+
+	// Same format as the Renderer's Framebuffer depth, blits between depth buffers need that
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_depthTexture);
+	glTextureStorage2D(m_depthTexture, 1, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glTextureParameteri(m_depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glCreateFramebuffers(1, &m_depthFramebuffer);
+	glNamedFramebufferTexture(m_depthFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, m_depthTexture, 0);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_hiZTexture);
+	glTextureStorage2D(m_hiZTexture, m_hiZLevels, GL_R32F, size.x, size.y);
+
+	if (!m_hiZSampler) {
+		glCreateSamplers(1, &m_hiZSampler);
+		glSamplerParameteri(m_hiZSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glSamplerParameteri(m_hiZSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glSamplerParameteri(m_hiZSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glSamplerParameteri(m_hiZSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+}
+
+void GpuCuller::captureDepth(GLuint framebuffer, const glm::ivec2& size, const glm::mat4& viewProjection) {
+	if (!m_hiZEnabled) {
+		m_hiZValid = false;
+		return;
+	}
+	if (size.x <= 0 || size.y <= 0) return;
+
+	if (!m_hiZShader) {
+		m_hiZShader = std::make_unique<Shader>(Shader::Builtin::BuildHiZ);
+	}
+	if (size != m_hiZSize) {
+		resizeHiZ(size);
+	}
+
+	glBlitNamedFramebuffer(framebuffer, m_depthFramebuffer, 0, 0, size.x, size.y, 0, 0, size.x, size.y,
+		GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	m_hiZShader->use();
+	m_hiZShader->set("u_depth", 0);
+	glBindTextureUnit(0, m_depthTexture);
+
+	glm::ivec2 levelSize = size;
+	for (std::int32_t level = 0; level < m_hiZLevels; ++level) {
+		m_hiZShader->set("u_fromDepth", level == 0);
+		glBindImageTexture(0, m_hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		// Level 0 never reads it, but an image unit has to name a level all the same
+		glBindImageTexture(1, m_hiZTexture, std::max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+
+		glDispatchCompute((levelSize.x + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (levelSize.y + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_hiZViewProjection = viewProjection;
+	m_hiZValid = true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "pch.h"
+
+#include "render/shader.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Visibility on the GPU for the RenderQueue's multi-draw path. A compute pass tests every
+	/// draw's bounding sphere against the camera frustum and writes the survivors, compacted,
+	/// into the instances of their indirect command, so the CPU never looks at per-object
+	/// visibility. With Hi-Z on, draws hidden behind last frame's depth are dropped as well:
+	/// captureDepth() keeps a max-depth pyramid of the frame for the next one. Objects that
+	/// were hidden and moved into view show up one frame late.
+	///
+	/// GL objects and programs are created on first use, the disabled path costs nothing.
+	/// </summary>
+	class GpuCuller {
+	public:
+		// std430 layout of CullRecord in CULL_DRAWS_COMPUTE_SRC, one per draw record
+		struct CullRecord {
+			glm::vec4 sphere;   // local bounding sphere, center and radius
+			std::uint32_t command;
+			std::uint32_t padding[3] = {};
+		};
+
+		GpuCuller() = default;
+		~GpuCuller();
+
+		GpuCuller(const GpuCuller&) = delete;
+		GpuCuller& operator=(const GpuCuller&) = delete;
+
+		void setHiZ(bool enabled) { m_hiZEnabled = enabled; }
+		bool isHiZ() const { return m_hiZEnabled; }
+
+		// Culls records[i] against draw record i of drawData. The commands must have an
+		// instanceCount of 0 and a baseInstance naming the first of as many slots as draws
+		// may end up in them. Returns the compacted records, for the draw shader's binding 0.
+		GLuint cull(const glm::mat4& viewProjection, std::span<const CullRecord> records, GLuint drawData, GLuint commands);
+
+		// Copies the depth of framebuffer into the pyramid, after the opaque draws. It has to be
+		// GL_DEPTH24_STENCIL8, multisampled is fine. size is the framebuffer's, viewProjection
+		// what it was drawn with.
+		void captureDepth(GLuint framebuffer, const glm::ivec2& size, const glm::mat4& viewProjection);
+
+	private:
+		std::unique_ptr<Shader> m_cullShader;
+		std::unique_ptr<Shader> m_hiZShader;
+
+		GLuint m_recordBuffer = 0;
+		GLuint m_compactedBuffer = 0;
+		std::size_t m_capacity = 0; // in records, of both
+
+		bool m_hiZEnabled = false;
+		bool m_hiZValid = false;     // a pyramid was captured since Hi-Z was enabled
+		GLuint m_depthFramebuffer = 0;
+		GLuint m_depthTexture = 0;
+		GLuint m_hiZTexture = 0;
+		GLuint m_hiZSampler = 0;
+		glm::ivec2 m_hiZSize{ 0 };
+		std::int32_t m_hiZLevels = 0;
+		glm::mat4 m_hiZViewProjection{ 1.0f };
+
+		void reserve(std::size_t records);
+		void resizeHiZ(const glm::ivec2& size);
+	};
+} // namespace Lunatic
@@ -0,0 +1,92 @@
+#include "pch.h"
+
+#include "image.h"
+
+using namespace Lunatic;
+
+Image Image::FromCapture(const Framebuffer::Capture& capture) {
+	Image image;
+	image.size = capture.size;
+	image.pixels.resize(std::size_t(capture.size.x) * capture.size.y * 3);
+
+	for (int y = 0; y < capture.size.y; ++y) {
+		const std::uint8_t* source = capture.pixels.data() + std::size_t(capture.size.y - 1 - y) * capture.size.x * 4;
+		std::uint8_t* target = image.pixels.data() + std::size_t(y) * capture.size.x * 3;
+		for (int x = 0; x < capture.size.x; ++x) {
+			std::memcpy(target + x * 3, source + x * 4, 3);
+		}
+	}
+	return image;
+}
+
+// PPM header tokens may be separated by any whitespace and '#' comments
+static int readPpmNumber(std::istream& stream) {
+	stream >> std::ws;
+	while (stream.peek() == '#') {
+		std::string comment;
+		std::getline(stream, comment);
+		stream >> std::ws;
+	}
+	int value = -1;
+	stream >> value;
+	return value;
+}
+
+Image Image::LoadPpm(const std::filesystem::path& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) throw std::runtime_error(std::format("Failed to open {}", path.string()));
+
+	std::string magic;
+	file >> magic;
+	Image image;
+	image.size.x = readPpmNumber(file);
+	image.size.y = readPpmNumber(file);
+	const int maxValue = readPpmNumber(file);
+	if (magic != "P6" || image.size.x <= 0 || image.size.y <= 0 || maxValue != 255) {
+		throw std::runtime_error(std::format("{} is not an 8-bit binary PPM", path.string()));
+	}
+	file.get(); // the single whitespace before the pixels
+
+	image.pixels.resize(std::size_t(image.size.x) * image.size.y * 3);
+	file.read(reinterpret_cast<char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+	if (file.gcount() != static_cast<std::streamsize>(image.pixels.size())) {
+		throw std::runtime_error(std::format("{} is truncated", path.string()));
+	}
+	return image;
+}
+
+void Image::savePpm(const std::filesystem::path& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) throw std::runtime_error(std::format("Failed to open {} for writing", path.string()));
+
+	file << "P6\n" << size.x << ' ' << size.y << "\n255\n";
+	file.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+}
+
+Image::Difference Image::Compare(const Image& a, const Image& b, std::uint8_t tolerance) {
+	Difference difference;
+	if (a.size != b.size) {
+		difference.sizeMismatch = true;
+		difference.mismatched = std::size_t(std::max(a.size.x * a.size.y, b.size.x * b.size.y));
+		difference.mismatchedFraction = 1.0;
+		return difference;
+	}
+
+	double squaredError = 0.0;
+	const std::size_t pixelCount = std::size_t(a.size.x) * a.size.y;
+	for (std::size_t pixel = 0; pixel < pixelCount; ++pixel) {
+		bool mismatched = false;
+		for (std::size_t channel = 0; channel < 3; ++channel) {
+			const int error = std::abs(int(a.pixels[pixel * 3 + channel]) - int(b.pixels[pixel * 3 + channel]));
+			squaredError += double(error) * error;
+			difference.maxError = std::max(difference.maxError, static_cast<std::uint8_t>(error));
+			mismatched |= error > tolerance;
+		}
+		difference.mismatched += mismatched;
+	}
+
+	difference.mismatchedFraction = pixelCount ? double(difference.mismatched) / double(pixelCount) : 0.0;
+	const double meanSquaredError = pixelCount ? squaredError / double(pixelCount * 3) : 0.0;
+	difference.psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : std::numeric_limits<double>::infinity();
+	return difference;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "pch.h"
+
+#include "render/framebuffer.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// RGB8 image, top row first, for screenshots and golden images. Stored as binary PPM so
+	/// they need nothing to read or write and diff byte for byte.
+	/// </summary>
+	struct Image {
+		glm::ivec2 size{ 0 };
+		std::vector<std::uint8_t> pixels; // RGB
+
+		struct Difference {
+			std::size_t mismatched = 0;  // pixels with a channel off by more than the tolerance
+			double mismatchedFraction = 0.0;
+			std::uint8_t maxError = 0;   // largest channel difference anywhere
+			double psnr = 0.0;           // dB, infinite when equal
+			bool sizeMismatch = false;
+		};
+
+		// Flips and drops alpha, the capture is RGBA from the bottom row up
+		static Image FromCapture(const Framebuffer::Capture& capture);
+
+		// Both throw std::runtime_error when the file cannot be read or written
+		static Image LoadPpm(const std::filesystem::path& path);
+		void savePpm(const std::filesystem::path& path) const;
+
+		// Compares channel by channel, tolerance absorbs rasterizer differences between drivers
+		static Difference Compare(const Image& a, const Image& b, std::uint8_t tolerance = 0);
+	};
+} // namespace Lunatic
@@ -0,0 +1,508 @@
+#include "pch.h"
+
+#include "mesh_asset.h"
+
+#include "hierarchy/services/mesh_cache.h"
+
+#include <charconv>
+#include <numeric>
+
+#include <meshoptimizer.h>
+
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+
+using namespace Lunatic;
+
+static constexpr std::size_t VERTEX_FLOATS = Services::MeshCache::VERTEX_FLOATS;
+static constexpr std::size_t VERTEX_BYTES = VERTEX_FLOATS * sizeof(float);
+static constexpr std::array<std::size_t, 3> STANDARD_FLOAT_OFFSETS = { 0, 3, 6 }; // by attribute location
+
+static std::uint64_t alignTo8(std::uint64_t offset) {
+	return (offset + 7) & ~std::uint64_t(7);
+}
+
+// ----- OBJ ----- //
+
+namespace {
+	class ObjReader {
+	public:
+		ObjReader(const char* begin, const char* end) : m_cursor(begin), m_end(end) {}
+
+		bool atLineEnd() {
+			skipSpaces();
+			return m_cursor == m_end || *m_cursor == '\n' || *m_cursor == '\r' || *m_cursor == '#';
+		}
+
+		std::string_view keyword() {
+			skipSpaces();
+			const char* start = m_cursor;
+			while (m_cursor != m_end && !isSpace(*m_cursor) && *m_cursor != '\n' && *m_cursor != '\r') ++m_cursor;
+			return std::string_view(start, m_cursor - start);
+		}
+
+		float number() {
+			skipSpaces();
+			float value = 0.0f;
+			auto [next, error] = std::from_chars(m_cursor, m_end, value);
+			LUN_ASSERT(error == std::errc(), "Malformed number in OBJ file")
+			m_cursor = next;
+			return value;
+		}
+
+		// Trailing components like vt's v and w may be left out
+		float optionalNumber(float fallback) {
+			return atLineEnd() ? fallback : number();
+		}
+
+		// One face corner, v, v/vt, v//vn or v/vt/vn. Missing references are 0.
+		std::array<std::int64_t, 3> corner() {
+			skipSpaces();
+			std::array<std::int64_t, 3> references = { 0, 0, 0 };
+			for (std::size_t i = 0; i < 3; ++i) {
+				if (m_cursor != m_end && *m_cursor != '/' && !isSpace(*m_cursor) && *m_cursor != '\n' && *m_cursor != '\r') {
+					auto [next, error] = std::from_chars(m_cursor, m_end, references[i]);
+					LUN_ASSERT(error == std::errc(), "Malformed face in OBJ file")
+					m_cursor = next;
+				}
+				if (m_cursor == m_end || *m_cursor != '/') break;
+				++m_cursor;
+			}
+			return references;
+		}
+
+		void nextLine() {
+			while (m_cursor != m_end && *m_cursor != '\n') ++m_cursor;
+			if (m_cursor != m_end) ++m_cursor;
+		}
+
+		bool done() const { return m_cursor == m_end; }
+
+	private:
+		const char* m_cursor;
+		const char* m_end;
+
+		static bool isSpace(char c) { return c == ' ' || c == '\t'; }
+		void skipSpaces() { while (m_cursor != m_end && isSpace(*m_cursor)) ++m_cursor; }
+	};
+
+	// 1-based from the start or negative from the end, as of the line referencing it
+	std::size_t resolveObjIndex(std::int64_t reference, std::size_t count) {
+		std::int64_t index = reference > 0 ? reference - 1 : static_cast<std::int64_t>(count) + reference;
+		LUN_ASSERT(reference != 0 && index >= 0 && static_cast<std::size_t>(index) < count, "OBJ face references a missing vertex")
+		return static_cast<std::size_t>(index);
+	}
+} // namespace
+
+MeshAsset::Data MeshAsset::importObj(const std::filesystem::path& source) {
+	MappedFile file(source, MappedFile::Mode::Read);
+	LUN_ASSERT(file.size() > 0, "OBJ file is empty")
+	const char* text = reinterpret_cast<const char*>(file.data());
+
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> texCoords;
+	std::vector<std::array<std::int64_t, 3>> face;
+
+	auto positionOf = [&](const std::array<std::int64_t, 3>& references) {
+		std::size_t position = resolveObjIndex(references[0], positions.size() / 3);
+		return glm::vec3(positions[position * 3], positions[position * 3 + 1], positions[position * 3 + 2]);
+		};
+
+	// Every corner becomes its own vertex here, Optimize merges the identical ones. Corners
+	// without a normal get their triangle's, so files without vn are flat shaded.
+	Data data;
+	auto emitCorner = [&](const std::array<std::int64_t, 3>& references, const glm::vec3& faceNormal) {
+		std::array<float, VERTEX_FLOATS> vertex{};
+		std::size_t position = resolveObjIndex(references[0], positions.size() / 3);
+		std::copy_n(positions.begin() + position * 3, 3, vertex.begin());
+		if (references[2] != 0) {
+			std::size_t normal = resolveObjIndex(references[2], normals.size() / 3);
+			std::copy_n(normals.begin() + normal * 3, 3, vertex.begin() + 3);
+		}
+		else {
+			std::copy_n(&faceNormal.x, 3, vertex.begin() + 3);
+		}
+		if (references[1] != 0) {
+			std::size_t texCoord = resolveObjIndex(references[1], texCoords.size() / 2);
+			std::copy_n(texCoords.begin() + texCoord * 2, 2, vertex.begin() + 6);
+		}
+		data.vertices.insert(data.vertices.end(), vertex.begin(), vertex.end());
+		};
+
+	for (ObjReader reader(text, text + file.size()); !reader.done(); reader.nextLine()) {
+		std::string_view keyword = reader.keyword();
+		if (keyword == "v") {
+			for (int i = 0; i < 3; ++i) positions.push_back(reader.number());
+		}
+		else if (keyword == "vn") {
+			for (int i = 0; i < 3; ++i) normals.push_back(reader.number());
+		}
+		else if (keyword == "vt") {
+			// u [v [w]], w has no place in the vertex
+			texCoords.push_back(reader.number());
+			texCoords.push_back(reader.optionalNumber(0.0f));
+		}
+		else if (keyword == "f") {
+			face.clear();
+			while (!reader.atLineEnd()) face.push_back(reader.corner());
+			LUN_ASSERT(face.size() >= 3, "OBJ face has fewer than 3 corners")
+
+			// Polygons are triangulated as fans
+			for (std::size_t i = 1; i + 1 < face.size(); ++i) {
+				const glm::vec3 first = positionOf(face[0]);
+				glm::vec3 faceNormal = glm::cross(positionOf(face[i]) - first, positionOf(face[i + 1]) - first);
+				float length = glm::length(faceNormal);
+				faceNormal = length > 0.0f ? faceNormal / length : glm::vec3(0.0f); // degenerate triangles stay unlit
+
+				emitCorner(face[0], faceNormal);
+				emitCorner(face[i], faceNormal);
+				emitCorner(face[i + 1], faceNormal);
+			}
+		}
+		// Groups, materials, smoothing groups and comments don't affect the geometry
+	}
+
+	data.indices.resize(data.vertices.size() / VERTEX_FLOATS);
+	std::iota(data.indices.begin(), data.indices.end(), 0u);
+	return data;
+}
+
+// ----- glTF ----- //
+
+MeshAsset::Data MeshAsset::importGltf(const std::filesystem::path& source) {
+	const std::string path = source.string();
+
+	cgltf_options options{};
+	cgltf_data* parsed = nullptr;
+	if (cgltf_parse_file(&options, path.c_str(), &parsed) != cgltf_result_success) {
+		throw std::runtime_error(std::format("Failed to parse glTF file {}", path));
+	}
+	std::unique_ptr<cgltf_data, decltype(&cgltf_free)> gltf(parsed, &cgltf_free);
+	if (cgltf_load_buffers(&options, gltf.get(), path.c_str()) != cgltf_result_success) {
+		throw std::runtime_error(std::format("Failed to load the buffers of {}", path));
+	}
+
+	Data data;
+	std::vector<float> scratch;
+
+	auto appendPrimitive = [&](const cgltf_primitive& primitive, const glm::mat4& transform) {
+		if (primitive.type != cgltf_primitive_type_triangles) return;
+
+		const cgltf_accessor* positions = nullptr;
+		const cgltf_accessor* normals = nullptr;
+		const cgltf_accessor* texCoords = nullptr;
+		for (cgltf_size i = 0; i < primitive.attributes_count; ++i) {
+			const cgltf_attribute& attribute = primitive.attributes[i];
+			if (attribute.type == cgltf_attribute_type_position) positions = attribute.data;
+			else if (attribute.type == cgltf_attribute_type_normal) normals = attribute.data;
+			else if (attribute.type == cgltf_attribute_type_texcoord && attribute.index == 0) texCoords = attribute.data;
+		}
+		if (!positions) return;
+
+		const std::size_t count = positions->count;
+		const std::size_t base = data.vertices.size() / VERTEX_FLOATS;
+		LUN_ASSERT(base + count <= std::numeric_limits<std::uint32_t>::max(), "glTF mesh has too many vertices")
+		data.vertices.resize(data.vertices.size() + count * VERTEX_FLOATS);
+		float* vertices = data.vertices.data() + base * VERTEX_FLOATS;
+
+		auto unpack = [&](const cgltf_accessor* accessor, std::size_t components, std::size_t at) {
+			if (!accessor || accessor->count != count) return false;
+			scratch.resize(count * components);
+			cgltf_accessor_unpack_floats(accessor, scratch.data(), scratch.size());
+			for (std::size_t v = 0; v < count; ++v) {
+				std::copy_n(scratch.begin() + v * components, components, vertices + v * VERTEX_FLOATS + at);
+			}
+			return true;
+			};
+
+		unpack(positions, 3, 0);
+		const bool hasNormals = unpack(normals, 3, 3);
+		unpack(texCoords, 2, 6);
+
+		// Bake the node transform, every node ends up in one mesh
+		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+		for (std::size_t v = 0; v < count; ++v) {
+			float* vertex = vertices + v * VERTEX_FLOATS;
+			glm::vec3 position = glm::vec3(transform * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+			std::copy_n(glm::value_ptr(position), 3, vertex);
+			if (hasNormals) {
+				glm::vec3 normal = normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]);
+				if (glm::dot(normal, normal) > 0.0f) normal = glm::normalize(normal);
+				std::copy_n(glm::value_ptr(normal), 3, vertex + 3);
+			}
+		}
+
+		const std::size_t firstIndex = data.indices.size();
+		if (primitive.indices) {
+			data.indices.reserve(firstIndex + primitive.indices->count);
+			for (cgltf_size i = 0; i < primitive.indices->count; ++i) {
+				cgltf_size index = cgltf_accessor_read_index(primitive.indices, i);
+				LUN_ASSERT(index < count, "glTF index out of range")
+				data.indices.push_back(static_cast<std::uint32_t>(base + index));
+			}
+		}
+		else {
+			for (std::size_t i = 0; i < count; ++i) data.indices.push_back(static_cast<std::uint32_t>(base + i));
+		}
+		data.indices.resize(firstIndex + (data.indices.size() - firstIndex) / 3 * 3);
+
+		// Mirroring transforms flip the winding
+		if (glm::determinant(glm::mat3(transform)) < 0.0f) {
+			for (std::size_t i = firstIndex; i < data.indices.size(); i += 3) {
+				std::swap(data.indices[i + 1], data.indices[i + 2]);
+			}
+		}
+		};
+
+	// Meshes are placed by the nodes using them, a file without nodes gets its meshes as they are
+	bool placedByNodes = false;
+	for (cgltf_size i = 0; i < gltf->nodes_count; ++i) {
+		const cgltf_node& node = gltf->nodes[i];
+		if (!node.mesh) continue;
+		placedByNodes = true;
+
+		glm::mat4 world(1.0f);
+		cgltf_node_transform_world(&node, glm::value_ptr(world));
+		for (cgltf_size p = 0; p < node.mesh->primitives_count; ++p) {
+			appendPrimitive(node.mesh->primitives[p], world);
+		}
+	}
+	if (!placedByNodes) {
+		for (cgltf_size m = 0; m < gltf->meshes_count; ++m) {
+			for (cgltf_size p = 0; p < gltf->meshes[m].primitives_count; ++p) {
+				appendPrimitive(gltf->meshes[m].primitives[p], glm::mat4(1.0f));
+			}
+		}
+	}
+
+	return data;
+}
+
+// ----- Processing ----- //
+
+MeshAsset::Data MeshAsset::Import(const std::filesystem::path& source) {
+	std::string extension = source.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	Data data;
+	if (extension == ".obj") {
+		data = importObj(source);
+	}
+	else if (extension == ".gltf" || extension == ".glb") {
+		data = importGltf(source);
+	}
+	else {
+		throw std::runtime_error(std::format("Unsupported mesh format {}", source.string()));
+	}
+	LUN_ASSERT(!data.indices.empty(), "Mesh file has no triangles")
+
+	Optimize(data);
+	fillMissingNormals(data);
+	return data;
+}
+
+void MeshAsset::Optimize(Data& data) {
+	const std::size_t indexCount = data.indices.size();
+	const std::size_t vertexCount = data.vertices.size() / VERTEX_FLOATS;
+
+	// Merge bitwise identical vertices
+	std::vector<unsigned int> remap(vertexCount);
+	std::size_t uniqueCount = meshopt_generateVertexRemap(remap.data(), data.indices.data(), indexCount,
+		data.vertices.data(), vertexCount, VERTEX_BYTES);
+
+	std::vector<float> unique(uniqueCount * VERTEX_FLOATS);
+	meshopt_remapVertexBuffer(unique.data(), data.vertices.data(), vertexCount, VERTEX_BYTES, remap.data());
+	meshopt_remapIndexBuffer(data.indices.data(), data.indices.data(), indexCount, remap.data());
+
+	// Triangle order for the post-transform cache, then for overdraw without losing much of it
+	meshopt_optimizeVertexCache(data.indices.data(), data.indices.data(), indexCount, uniqueCount);
+	meshopt_optimizeOverdraw(data.indices.data(), data.indices.data(), indexCount, unique.data(), uniqueCount, VERTEX_BYTES, 1.05f);
+
+	// Vertices in the order they are first used, which also drops unreferenced ones
+	data.vertices.resize(unique.size());
+	std::size_t usedCount = meshopt_optimizeVertexFetch(data.vertices.data(), data.indices.data(), indexCount,
+		unique.data(), uniqueCount, VERTEX_BYTES);
+	data.vertices.resize(usedCount * VERTEX_FLOATS);
+}
+
+void MeshAsset::fillMissingNormals(Data& data) {
+	const std::size_t vertexCount = data.vertices.size() / VERTEX_FLOATS;
+	auto normalAt = [&](std::size_t vertex) { return data.vertices.data() + vertex * VERTEX_FLOATS + 3; };
+
+	std::vector<bool> missing(vertexCount);
+	bool anyMissing = false;
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		const float* normal = normalAt(v);
+		missing[v] = normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f;
+		anyMissing |= missing[v];
+	}
+	if (!anyMissing) return;
+
+	// Area-weighted sum of the faces around each vertex
+	for (std::size_t i = 0; i + 2 < data.indices.size(); i += 3) {
+		const std::uint32_t* triangle = data.indices.data() + i;
+		auto positionOf = [&](std::uint32_t vertex) { return glm::make_vec3(data.vertices.data() + vertex * VERTEX_FLOATS); };
+		glm::vec3 a = positionOf(triangle[0]);
+		glm::vec3 faceNormal = glm::cross(positionOf(triangle[1]) - a, positionOf(triangle[2]) - a);
+
+		for (int corner = 0; corner < 3; ++corner) {
+			if (!missing[triangle[corner]]) continue;
+			float* normal = normalAt(triangle[corner]);
+			normal[0] += faceNormal.x;
+			normal[1] += faceNormal.y;
+			normal[2] += faceNormal.z;
+		}
+	}
+
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		if (!missing[v]) continue;
+		float* normal = normalAt(v);
+		glm::vec3 sum = glm::make_vec3(normal);
+		glm::vec3 result = glm::dot(sum, sum) > 0.0f ? glm::normalize(sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+		std::copy_n(glm::value_ptr(result), 3, normal);
+	}
+}
+
+// ----- Cooked files ----- //
+
+std::filesystem::path MeshAsset::CookedPath(const std::filesystem::path& source) {
+	std::filesystem::path cooked = source;
+	cooked += COOKED_EXTENSION;
+	return cooked;
+}
+
+VertexLayout MeshAsset::ChooseLayout(const Data& data) {
+	const std::size_t vertexCount = data.vertices.size() / VERTEX_FLOATS;
+
+	glm::vec3 minimum(std::numeric_limits<float>::max());
+	glm::vec3 maximum(std::numeric_limits<float>::lowest());
+	bool unitTexCoords = true;
+	for (std::size_t v = 0; v < vertexCount; ++v) {
+		const float* vertex = data.vertices.data() + v * VERTEX_FLOATS;
+		minimum = glm::min(minimum, glm::make_vec3(vertex));
+		maximum = glm::max(maximum, glm::make_vec3(vertex));
+		unitTexCoords &= vertex[6] >= 0.0f && vertex[6] <= 1.0f && vertex[7] >= 0.0f && vertex[7] <= 1.0f;
+	}
+
+	// A half rounds to within 1/2048 of its magnitude, so that holds relative to the mesh's size
+	// as long as no coordinate is further from the origin than the mesh is large
+	glm::vec3 extent = maximum - minimum;
+	float size = std::max({ extent.x, extent.y, extent.z });
+	float reach = std::max({ std::abs(minimum.x), std::abs(minimum.y), std::abs(minimum.z),
+		std::abs(maximum.x), std::abs(maximum.y), std::abs(maximum.z) });
+	bool halfPositions = size > 0.0f && reach <= size && reach < 65504.0f;
+
+	return VertexLayout({
+		{ 0, halfPositions ? VertexFormat::Half4 : VertexFormat::Float3 },
+		{ 1, VertexFormat::Snorm10x3 },
+		{ 2, unitTexCoords ? VertexFormat::Unorm16x2 : VertexFormat::Float2 }
+	});
+}
+
+void MeshAsset::Cook(const Data& data, const std::filesystem::path& source, const std::filesystem::path& path) {
+	const VertexLayout layout = ChooseLayout(data);
+	const std::size_t vertexCount = data.vertices.size() / VERTEX_FLOATS;
+	const std::uint32_t stride = layout.getStride();
+
+	FileHeader header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.vertexStride = stride;
+	header.layoutKey = layout.getKey();
+	header.vertexCount = vertexCount;
+	header.indexCount = data.indices.size();
+	header.sourceSize = std::filesystem::file_size(source);
+	header.sourceWriteTime = std::filesystem::last_write_time(source).time_since_epoch().count();
+
+	std::uint64_t offset = alignTo8(sizeof(FileHeader));
+	header.verticesOffset = offset;
+	offset = alignTo8(offset + vertexCount * stride);
+	header.indicesOffset = offset;
+	offset = alignTo8(offset + data.indices.size() * sizeof(std::uint32_t));
+	header.fileSize = offset;
+
+	// Written aside and renamed over, so a reader never maps a half-written file
+	std::filesystem::path temporary = path;
+	temporary += ".tmp";
+	{
+		MappedFile file(temporary, MappedFile::Mode::ReadWrite, static_cast<std::size_t>(header.fileSize));
+		std::memcpy(file.data(), &header, sizeof(header));
+		// Standard vertices are position, normal and texture coords, at the locations they are packed for
+		std::byte* out = file.data() + header.verticesOffset;
+		for (std::size_t v = 0; v < vertexCount; ++v, out += stride) {
+			const float* vertex = data.vertices.data() + v * VERTEX_FLOATS;
+			for (const VertexAttribute& attribute : layout.getAttributes()) {
+				VertexLayout::Encode(attribute.format, vertex + STANDARD_FLOAT_OFFSETS[attribute.location], out + attribute.offset);
+			}
+		}
+		std::memcpy(file.data() + header.indicesOffset, data.indices.data(), data.indices.size() * sizeof(std::uint32_t));
+		file.flush();
+	}
+	std::filesystem::rename(temporary, path);
+}
+
+MeshAsset::Cooked MeshAsset::Open(const std::filesystem::path& path) {
+	Cooked cooked;
+	cooked.file = MappedFile(path, MappedFile::Mode::Read);
+
+	const std::byte* base = cooked.file.data();
+	const std::uint64_t size = cooked.file.size();
+	LUN_ASSERT(size >= sizeof(FileHeader), "Cooked mesh is truncated")
+
+	FileHeader header;
+	std::memcpy(&header, base, sizeof(header));
+	LUN_ASSERT(header.magic == MAGIC, "Not a cooked mesh file")
+	LUN_ASSERT(header.version == VERSION, "Unsupported cooked mesh version")
+	LUN_ASSERT(header.fileSize <= size, "Cooked mesh is truncated")
+
+	cooked.layout = VertexLayout::FromKey(header.layoutKey);
+	const std::uint32_t stride = cooked.layout.getStride();
+	LUN_ASSERT(stride > 0 && header.vertexStride == stride, "Cooked mesh vertex layout is corrupt")
+	LUN_ASSERT(header.verticesOffset % 8 == 0 && header.verticesOffset <= size
+		&& header.vertexCount <= (size - header.verticesOffset) / stride, "Cooked mesh vertices out of bounds")
+	LUN_ASSERT(header.indicesOffset % 8 == 0 && header.indicesOffset <= size
+		&& header.indexCount <= (size - header.indicesOffset) / sizeof(std::uint32_t), "Cooked mesh indices out of bounds")
+
+	cooked.vertices = std::span<const std::byte>(base + header.verticesOffset, static_cast<std::size_t>(header.vertexCount * stride));
+	cooked.indices = std::span<const std::uint32_t>(reinterpret_cast<const std::uint32_t*>(base + header.indicesOffset),
+		static_cast<std::size_t>(header.indexCount));
+
+	// The indices go to the GPU as they are, one out of range would read past the mesh
+	LUN_ASSERT(!cooked.indices.empty() && cooked.indices.size() % 3 == 0, "Cooked mesh has no whole triangles")
+	LUN_ASSERT(*std::max_element(cooked.indices.begin(), cooked.indices.end()) < header.vertexCount, "Cooked mesh index out of range")
+	return cooked;
+}
+
+MeshAsset::Cooked MeshAsset::Load(const std::filesystem::path& source) {
+	const std::filesystem::path cookedPath = CookedPath(source);
+
+	// A cooked file without its source is used as is, that is how meshes ship
+	if (std::filesystem::exists(cookedPath)) {
+		const bool hasSource = std::filesystem::exists(source);
+
+		std::optional<Cooked> cooked;
+		try {
+			cooked = Open(cookedPath);
+		}
+		catch (const std::exception&) {
+			// Cooked by an older version or broken, cooked again from the source if there is one
+			if (!hasSource) throw;
+		}
+
+		if (cooked && !hasSource) return std::move(*cooked);
+		if (cooked) {
+			FileHeader header;
+			std::memcpy(&header, cooked->file.data(), sizeof(header));
+			if (header.sourceSize == std::filesystem::file_size(source)
+				&& header.sourceWriteTime == std::filesystem::last_write_time(source).time_since_epoch().count()) {
+				return std::move(*cooked);
+			}
+		}
+		// Stale, Cook renames over the file and Windows won't replace one that is still mapped
+		cooked.reset();
+	}
+
+	Cook(Import(source), source, cookedPath);
+	return Open(cookedPath);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "pch.h"
+
+#include "core/mapped_file.h"
+#include "render/vertex_layout.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// Mesh import and the cooked mesh cache. OBJ and glTF sources are decoded, deduplicated
+	/// and reordered for the post-transform vertex cache, overdraw and vertex fetch, then
+	/// written next to the source as a .lmesh file. Cooking picks the smallest VertexLayout
+	/// that keeps the mesh accurate and stores the vertices packed in it, exactly as the
+	/// MeshCache uploads them, so loading is a mapping and one copy to the GPU. Everything
+	/// here is safe to run on worker threads, nothing touches GL.
+	/// </summary>
+	class MeshAsset {
+	public:
+		static constexpr std::uint32_t VERSION = 2;
+		static constexpr std::array<char, 8> MAGIC = { 'L', 'U', 'N', 'M', 'E', 'S', 'H', '\0' };
+		static constexpr std::string_view COOKED_EXTENSION = ".lmesh";
+
+		// Every array is 8-byte aligned and sits at its offset from the start of the file
+		struct FileHeader {
+			std::array<char, 8> magic;
+			std::uint32_t version;
+			std::uint32_t vertexStride;   // in bytes
+			std::uint64_t layoutKey;      // VertexLayout::getKey()
+			std::uint64_t vertexCount;
+			std::uint64_t indexCount;     // uint32 indices
+			std::uint64_t sourceSize;     // of the file it was cooked from, a mismatch means it is stale
+			std::int64_t sourceWriteTime; // in file clock ticks
+			std::uint64_t verticesOffset;
+			std::uint64_t indicesOffset;
+			std::uint64_t fileSize;
+		};
+
+		// Decoded geometry in VertexLayout::Standard()
+		struct Data {
+			std::vector<float> vertices;
+			std::vector<std::uint32_t> indices;
+		};
+
+		// A cooked file mapped into memory, the spans point into the mapping
+		struct Cooked {
+			MappedFile file;
+			VertexLayout layout;
+			std::span<const std::byte> vertices;
+			std::span<const std::uint32_t> indices;
+		};
+
+		// Decodes and optimizes a .obj, .gltf or .glb file. Throws std::runtime_error on a
+		// format it doesn't know or a malformed file.
+		static Data Import(const std::filesystem::path& source);
+		// Reorders data for rendering, identical vertices are merged first
+		static void Optimize(Data& data);
+
+		// Half float positions when their rounding stays under 1/2048 of the mesh's size,
+		// 10-bit normals, and 16-bit texture coords when they all lie in [0, 1]
+		static VertexLayout ChooseLayout(const Data& data);
+
+		static std::filesystem::path CookedPath(const std::filesystem::path& source);
+		static void Cook(const Data& data, const std::filesystem::path& source, const std::filesystem::path& path);
+		static Cooked Open(const std::filesystem::path& path);
+
+		// Opens the cooked file of source, importing and cooking it first if it is missing or stale
+		static Cooked Load(const std::filesystem::path& source);
+
+	private:
+		static Data importObj(const std::filesystem::path& source);
+		static Data importGltf(const std::filesystem::path& source);
+		static void fillMissingNormals(Data& data);
+	};
+} // namespace Lunatic
@@ -0,0 +1,292 @@
+#include "pch.h"
+
+#include "render_queue.h"
+
+#include "hierarchy/services/mesh_cache.h"
+
+using namespace Lunatic;
+
+// Below this std::sort beats clearing and scanning the radix histograms
+static constexpr std::size_t RADIX_SORT_MIN = 256;
+
+RenderQueue::RenderQueue() {
+	m_materials.emplace_back();
+}
+
+RenderQueue::~RenderQueue() {
+	glDeleteBuffers(1, &m_indirectBuffer);
+	glDeleteBuffers(1, &m_drawDataBuffer);
+}
+
+RenderQueue::MaterialId RenderQueue::addMaterial(const Material& material) {
+	LUN_ASSERT(m_materials.size() <= std::numeric_limits<MaterialId>::max(), "Too many materials")
+	m_materials.push_back(material);
+	return static_cast<MaterialId>(m_materials.size() - 1);
+}
+
+std::uint64_t RenderQueue::MakeKey(Pass pass, std::uint32_t shader, std::uint32_t arena, std::uint32_t mesh, MaterialId material, float depth) {
+	// Fields are truncated to their width, a collision only costs a redundant bind
+	const auto quantized = static_cast<std::uint64_t>(std::clamp(depth, 0.0f, 1.0f) * 65535.0f);
+	const std::uint64_t state = (std::uint64_t(shader & 0x3FF) << 36) | (std::uint64_t(std::min(arena, 15u)) << 32)
+		| (std::uint64_t(mesh & 0xFFFF) << 16) | material;
+
+	if (pass == Pass::Transparent) {
+		// Blending needs back to front before anything else
+		return (std::uint64_t(pass) << 62) | ((0xFFFF - quantized) << 46) | state;
+	}
+	return (std::uint64_t(pass) << 62) | (state << 16) | quantized;
+}
+
+void RenderQueue::begin(const Camera& camera, const Shader& shader, const Services::MeshCache& meshCache) {
+	m_commands.clear();
+	m_entries.clear();
+	m_shader = &shader;
+	m_meshCache = &meshCache;
+	m_view = camera.getView();
+	m_viewProjection = camera.getViewProjection();
+	m_nearPlane = camera.getNearPlane();
+	m_farPlane = camera.getFarPlane();
+
+	// Materials may have been edited since, every program gets its uniforms again once
+	for (auto& [program, state] : m_programs) {
+		state.hasViewProjection = false;
+		state.material = NO_MATERIAL;
+	}
+}
+
+void RenderQueue::push(const MeshHandle& mesh, const glm::mat4& model, MaterialId material, Pass pass, const Shader* shader) {
+	if (!mesh || m_meshCache->getIndexCount(mesh) == 0) return;
+	LUN_ASSERT(material < m_materials.size(), "Unknown material")
+
+	if (!shader) shader = m_shader;
+
+	const float viewDepth = -(m_view * model[3]).z;
+	const float depth = (viewDepth - m_nearPlane) / (m_farPlane - m_nearPlane);
+
+	const std::uint32_t arena = m_meshCache->getArena(mesh);
+	m_entries.push_back({ MakeKey(pass, shader->getProgram(), arena, mesh.getId(), material, depth),
+		static_cast<std::uint32_t>(m_commands.size()) });
+	m_commands.push_back({ shader, mesh.getId(), arena, material, model });
+}
+
+void RenderQueue::sortEntries() {
+	const std::size_t count = m_entries.size();
+	if (count < RADIX_SORT_MIN) {
+		std::sort(m_entries.begin(), m_entries.end(), [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+		return;
+	}
+
+	// Every byte's histogram in one read of the keys
+	std::array<std::array<std::uint32_t, 256>, 8> histograms{};
+	for (const SortEntry& entry : m_entries) {
+		for (std::size_t pass = 0; pass < 8; ++pass) {
+			++histograms[pass][(entry.key >> (pass * 8)) & 0xFF];
+		}
+	}
+
+	m_scratch.resize(count);
+	for (std::size_t pass = 0; pass < 8; ++pass) {
+		auto& histogram = histograms[pass];
+		const std::size_t shift = pass * 8;
+		if (histogram[(m_entries.front().key >> shift) & 0xFF] == count) continue;
+
+		std::uint32_t offset = 0;
+		for (std::uint32_t& bucket : histogram) {
+			std::uint32_t size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+		for (const SortEntry& entry : m_entries) {
+			m_scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+		}
+		m_entries.swap(m_scratch);
+	}
+}
+
+RenderQueue::ProgramState& RenderQueue::getProgramState(const Shader& shader) {
+	auto [it, inserted] = m_programs.try_emplace(shader.getProgram());
+	if (inserted) {
+		const GLuint program = shader.getProgram();
+		it->second.viewProjection = glGetUniformLocation(program, "u_viewProjection");
+		it->second.model = glGetUniformLocation(program, "u_model");
+		it->second.color = glGetUniformLocation(program, "u_color");
+		it->second.opacity = glGetUniformLocation(program, "u_opacity");
+		it->second.drawData = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, "DrawDataBuffer") != GL_INVALID_INDEX;
+	}
+	return it->second;
+}
+
+void RenderQueue::buildRuns() {
+	m_runs.clear();
+	m_indirectCommands.clear();
+	m_drawData.clear();
+	m_cullRecords.clear();
+
+	for (std::size_t i = 0; i < m_entries.size();) {
+		const Command& first = m_commands[m_entries[i].command];
+		const Pass pass = passOf(m_entries[i].key);
+		const bool indirect = getProgramState(*first.shader).drawData;
+
+		Run run{ i, i, pass, indirect, m_indirectCommands.size(), 0 };
+		std::uint32_t lastMesh = MeshHandle::INVALID_ID;
+		glm::vec4 lastBounds(0.0f);
+		for (; i < m_entries.size(); ++i) {
+			const Command& command = m_commands[m_entries[i].command];
+			if (command.shader != first.shader || command.arena != first.arena || passOf(m_entries[i].key) != pass) break;
+			if (!indirect) continue;
+
+			// The draw's record is at gl_BaseInstance + gl_InstanceID
+			const auto record = static_cast<std::uint32_t>(m_drawData.size());
+			const Material& material = m_materials[command.material];
+			m_drawData.push_back({ command.model, glm::vec4(material.color, material.opacity) });
+
+			if (command.mesh != lastMesh) {
+				const Services::MeshCache::DrawRange range = m_meshCache->getDrawRange(command.mesh);
+				m_indirectCommands.push_back({ range.indexCount, 0, range.firstIndex, static_cast<std::int32_t>(range.baseVertex), record });
+				lastMesh = command.mesh;
+				lastBounds = range.bounds;
+			}
+			++m_indirectCommands.back().instanceCount;
+
+			// Transparent instances keep the order they were sorted in, the culler's compaction
+			// would shuffle them. Opaque records all come first, so record i stays draw i.
+			if (m_gpuCulling && pass == Pass::Opaque) {
+				m_cullRecords.push_back({ lastBounds, static_cast<std::uint32_t>(m_indirectCommands.size() - 1) });
+			}
+		}
+		run.endEntry = i;
+		run.commandCount = m_indirectCommands.size() - run.firstCommand;
+		m_runs.push_back(run);
+	}
+}
+
+void RenderQueue::uploadIndirect() {
+	// Grown like the MeshCache arenas, the old contents never need to survive
+	if (m_indirectCommands.size() > m_indirectCapacity) {
+		glDeleteBuffers(1, &m_indirectBuffer);
+		m_indirectCapacity = std::max(m_indirectCapacity * 2, m_indirectCommands.size());
+		glCreateBuffers(1, &m_indirectBuffer);
+		glNamedBufferData(m_indirectBuffer, m_indirectCapacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+	}
+	if (m_drawData.size() > m_drawDataCapacity) {
+		glDeleteBuffers(1, &m_drawDataBuffer);
+		m_drawDataCapacity = std::max(m_drawDataCapacity * 2, m_drawData.size());
+		glCreateBuffers(1, &m_drawDataBuffer);
+		glNamedBufferData(m_drawDataBuffer, m_drawDataCapacity * sizeof(DrawData), nullptr, GL_DYNAMIC_DRAW);
+	}
+
+	// The culler counts the instances it lets through itself
+	for (const GpuCuller::CullRecord& record : m_cullRecords) {
+		m_indirectCommands[record.command].instanceCount = 0;
+	}
+
+	glNamedBufferSubData(m_indirectBuffer, 0, m_indirectCommands.size() * sizeof(DrawElementsIndirectCommand), m_indirectCommands.data());
+	glNamedBufferSubData(m_drawDataBuffer, 0, m_drawData.size() * sizeof(DrawData), m_drawData.data());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+
+	GLuint drawData = m_drawDataBuffer;
+	if (!m_cullRecords.empty()) {
+		drawData = m_culler.cull(m_viewProjection, m_cullRecords, m_drawDataBuffer, m_indirectBuffer);
+		m_stats.gpuCullTested = m_cullRecords.size();
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawData);
+}
+
+void RenderQueue::submitDirect(const Run& run, ProgramState& program) {
+	for (std::size_t i = run.firstEntry; i < run.endEntry; ++i) {
+		const Command& command = m_commands[m_entries[i].command];
+
+		if (program.material != command.material) {
+			const Material& material = m_materials[command.material];
+			glUniform3fv(program.color, 1, glm::value_ptr(material.color));
+			glUniform1f(program.opacity, material.opacity);
+			program.material = command.material;
+			++m_stats.uniformUploads;
+		}
+
+		glUniformMatrix4fv(program.model, 1, GL_FALSE, glm::value_ptr(command.model));
+		m_meshCache->draw(command.mesh);
+	}
+}
+
+void RenderQueue::submit() {
+	m_stats = Stats{};
+	if (m_commands.empty()) return;
+
+	auto start = std::chrono::steady_clock::now();
+	sortEntries();
+	auto sorted = std::chrono::steady_clock::now();
+	m_stats.sortMs = std::chrono::duration<double, std::milli>(sorted - start).count();
+
+	buildRuns();
+	if (!m_indirectCommands.empty()) {
+		uploadIndirect();
+	}
+
+	const Shader* boundShader = nullptr;
+	ProgramState* program = nullptr;
+
+	m_meshCache->bind();
+	std::uint32_t boundArena = 0;
+	++m_stats.vaoBinds;
+
+	bool blending = false;
+	for (const Run& run : m_runs) {
+		const Command& first = m_commands[m_entries[run.firstEntry].command];
+
+		// Transparent runs sort after every opaque one, so the state only changes once
+		if (run.pass == Pass::Transparent && !blending) {
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+			blending = true;
+
+			// Drawn from the records as built, compacted ones only exist for opaque draws
+			if (!m_cullRecords.empty()) {
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_drawDataBuffer);
+			}
+		}
+
+		if (first.shader != boundShader) {
+			first.shader->use();
+			boundShader = first.shader;
+			program = &getProgramState(*first.shader);
+			++m_stats.programBinds;
+
+			if (!program->hasViewProjection) {
+				glUniformMatrix4fv(program->viewProjection, 1, GL_FALSE, glm::value_ptr(m_viewProjection));
+				program->hasViewProjection = true;
+				++m_stats.uniformUploads;
+			}
+		}
+
+		if (first.arena != boundArena) {
+			m_meshCache->bind(first.arena);
+			boundArena = first.arena;
+			++m_stats.vaoBinds;
+		}
+
+		if (run.indirect) {
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+				reinterpret_cast<const void*>(run.firstCommand * sizeof(DrawElementsIndirectCommand)),
+				static_cast<GLsizei>(run.commandCount), 0);
+			++m_stats.multiDraws;
+		}
+		else {
+			submitDirect(run, *program);
+		}
+	}
+
+	// Depth writes also gate glClear, the next frame needs them back
+	if (blending) {
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+	}
+
+	m_stats.draws = m_entries.size();
+	m_stats.indirectCommands = m_indirectCommands.size();
+	m_stats.programBindsSaved = m_stats.draws - std::min(m_stats.programBinds, m_stats.draws);
+	m_stats.vaoBindsSaved = m_stats.draws - std::min(m_stats.vaoBinds, m_stats.draws);
+	m_stats.uniformUploadsSaved = 2 * m_stats.draws - std::min(m_stats.uniformUploads, 2 * m_stats.draws);
+	m_stats.submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sorted).count();
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "pch.h"
+
+#include "render/camera.h"
+#include "render/shader.h"
+#include "render/gpu_culler.h"
+
+namespace Lunatic {
+	class MeshHandle;
+	namespace Services { class MeshCache; }
+
+	/// <summary>
+	/// Per-frame list of draws, submitted in state order instead of hierarchy order. Every
+	/// draw gets a 64-bit sort key and the keys are radix sorted, so draws sharing a shader,
+	/// a VAO, a mesh and a material end up next to each other. Submission only binds a
+	/// program or VAO and uploads a material when it differs from the previous draw, and
+	/// keeps per program which view projection and material it already holds.
+	///
+	/// Opaque keys: pass | shader | vertex arena | mesh | material | depth, front to back.
+	/// Transparent keys: pass | depth back to front | shader | vertex arena | mesh | material.
+	///
+	/// Shaders with a DrawDataBuffer (Shader::Builtin::DrawData) read their model matrix and
+	/// color from a storage buffer instead of uniforms. Every run of their draws sharing a VAO
+	/// is one glMultiDrawElementsIndirect, with consecutive draws of a mesh merged into one
+	/// instanced command, so the GL calls per frame don't grow with the number of objects.
+	/// With GPU culling on, the GpuCuller decides which of the opaque instances are drawn.
+	/// Transparent ones are all drawn, in the back to front order they were sorted in.
+	///
+	/// The transparent pass is drawn last with alpha blending and without depth writes.
+	/// </summary>
+	class RenderQueue {
+	public:
+		enum class Pass : std::uint8_t { Opaque, Transparent };
+
+		struct Material {
+			glm::vec3 color{ 1.0f, 0.5f, 0.2f };
+			float opacity = 1.0f; // only blended in the transparent pass
+		};
+		using MaterialId = std::uint16_t;
+
+		struct Stats {
+			std::size_t draws = 0;
+			std::size_t programBinds = 0;
+			std::size_t vaoBinds = 0;
+			std::size_t uniformUploads = 0;  // view projections and materials, not model matrices
+			std::size_t programBindsSaved = 0; // over binding everything for every draw
+			std::size_t vaoBindsSaved = 0;
+			std::size_t uniformUploadsSaved = 0;
+			std::size_t multiDraws = 0;       // glMultiDrawElementsIndirect calls
+			std::size_t indirectCommands = 0; // in them
+			std::size_t gpuCullTested = 0;    // draws handed to the GpuCuller
+			double sortMs = 0.0;
+			double submitMs = 0.0;
+		};
+
+		// Material 0 always exists, the default orange
+		RenderQueue();
+		~RenderQueue();
+
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue& operator=(const RenderQueue&) = delete;
+
+		MaterialId addMaterial(const Material& material);
+		Material& getMaterial(MaterialId id) { return m_materials[id]; }
+
+		// Clears the queue, draws pushed until submit() are seen from camera and use shader
+		// unless they bring their own
+		void begin(const Camera& camera, const Shader& shader, const Services::MeshCache& meshCache);
+		// Meshes that are still loading are left out
+		void push(const MeshHandle& mesh, const glm::mat4& model, MaterialId material = 0,
+			Pass pass = Pass::Opaque, const Shader* shader = nullptr);
+		// Sorts and draws everything pushed since begin()
+		void submit();
+
+		// Frustum and, if the culler has Hi-Z on, occlusion culling of multi-draw runs on the GPU
+		void setGpuCulling(bool enabled) { m_gpuCulling = enabled; }
+		bool isGpuCulling() const { return m_gpuCulling; }
+		GpuCuller& getCuller() { return m_culler; }
+
+		std::size_t getSize() const { return m_commands.size(); }
+		const Stats& getStats() const { return m_stats; }
+
+		// depth is in [0, 1], from the near to the far plane
+		static std::uint64_t MakeKey(Pass pass, std::uint32_t shader, std::uint32_t arena, std::uint32_t mesh, MaterialId material, float depth);
+
+	private:
+		static constexpr std::uint32_t NO_MATERIAL = 0xFFFFFFFF;
+
+		struct Command {
+			const Shader* shader;
+			std::uint32_t mesh;
+			std::uint32_t arena;
+			MaterialId material;
+			glm::mat4 model;
+		};
+
+		// Layout glMultiDrawElementsIndirect reads
+		struct DrawElementsIndirectCommand {
+			std::uint32_t count;
+			std::uint32_t instanceCount;
+			std::uint32_t firstIndex;
+			std::int32_t baseVertex;
+			std::uint32_t baseInstance;
+		};
+
+		// std430 layout of DrawData in DRAW_DATA_VERTEX_SRC
+		struct DrawData {
+			glm::mat4 model;
+			glm::vec4 color;
+		};
+
+		// Sorted entries sharing a shader and a VAO
+		struct Run {
+			std::size_t firstEntry;
+			std::size_t endEntry;
+			Pass pass;
+			bool indirect;               // the shader reads draw data
+			std::size_t firstCommand;    // in m_indirectCommands, if indirect
+			std::size_t commandCount;
+		};
+
+		struct SortEntry {
+			std::uint64_t key;
+			std::uint32_t command;
+		};
+
+		// What a program already holds, uniforms are program state and survive rebinding
+		struct ProgramState {
+			GLint viewProjection = -1;
+			GLint model = -1;
+			GLint color = -1;
+			GLint opacity = -1;
+			bool drawData = false; // has a DrawDataBuffer
+			bool hasViewProjection = false; // of this frame
+			std::uint32_t material = NO_MATERIAL;
+		};
+
+		std::vector<Material> m_materials;
+		std::vector<Command> m_commands;
+		std::vector<SortEntry> m_entries;
+		std::vector<SortEntry> m_scratch;
+		std::unordered_map<GLuint, ProgramState> m_programs;
+
+		std::vector<Run> m_runs;
+		std::vector<DrawElementsIndirectCommand> m_indirectCommands;
+		std::vector<DrawData> m_drawData;
+		GLuint m_indirectBuffer = 0;
+		GLuint m_drawDataBuffer = 0;
+		std::size_t m_indirectCapacity = 0; // in commands
+		std::size_t m_drawDataCapacity = 0; // in records
+
+		GpuCuller m_culler;
+		std::vector<GpuCuller::CullRecord> m_cullRecords;
+		bool m_gpuCulling = false;
+
+		const Shader* m_shader = nullptr;
+		const Services::MeshCache* m_meshCache = nullptr;
+		glm::mat4 m_view{ 1.0f };
+		glm::mat4 m_viewProjection{ 1.0f };
+		float m_nearPlane = 0.1f;
+		float m_farPlane = 100.0f;
+
+		Stats m_stats;
+
+		// LSD radix sort of m_entries on the key, 8 bits per pass, passes where every key
+		// has the same byte are skipped
+		void sortEntries();
+		ProgramState& getProgramState(const Shader& shader);
+		static Pass passOf(std::uint64_t key) { return static_cast<Pass>(key >> 62); }
+		// Splits the sorted entries into runs and fills the indirect commands and draw data
+		void buildRuns();
+		void uploadIndirect();
+		void submitDirect(const Run& run, ProgramState& program);
+	};
+} // namespace Lunatic
@@ -2,6 +2,8 @@
 
 #include "shader.h"
 
+#include "logging/log.h"
+
 using namespace Lunatic;
 
 Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) {
@@ -12,9 +14,23 @@ Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) {
 	m_id = createProgram(vertex, fragment);
 }
 
-Shader::Shader() {
-    unsigned int vertex = compileShader(GL_VERTEX_SHADER, DEFAULT_VERTEX_SRC);
-    unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, DEFAULT_FRAGMENT_SRC);
+Shader::Shader() : Shader(Builtin::Default) {}
+
+Shader::Shader(Builtin builtin) {
+    switch (builtin) {
+    case Builtin::CullDraws:
+        m_id = createProgram(compileShader(GL_COMPUTE_SHADER, CULL_DRAWS_COMPUTE_SRC));
+        return;
+    case Builtin::BuildHiZ:
+        m_id = createProgram(compileShader(GL_COMPUTE_SHADER, BUILD_HIZ_COMPUTE_SRC));
+        return;
+    default:
+        break;
+    }
+
+    const bool drawData = builtin == Builtin::DrawData;
+    unsigned int vertex = compileShader(GL_VERTEX_SHADER, drawData ? DRAW_DATA_VERTEX_SRC : DEFAULT_VERTEX_SRC);
+    unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, drawData ? DRAW_DATA_FRAGMENT_SRC : DEFAULT_FRAGMENT_SRC);
     m_id = createProgram(vertex, fragment);
 }
 
@@ -39,11 +55,11 @@ unsigned int Shader::compileShader(unsigned int type, const char* source) const
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success) {
         glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
-        std::string typeStr = (type == GL_VERTEX_SHADER) ? "Vertex" : "Fragment";
+        std::string typeStr = (type == GL_VERTEX_SHADER) ? "Vertex" : (type == GL_COMPUTE_SHADER) ? "Compute" : "Fragment";
         throw std::runtime_error("Shader::compileShader - Failed to compile " + typeStr + " shader:\n" + infoLog);
     }
 
-	spdlog::info("Shader::compileShader - Compiled {} shader successfully", type == GL_VERTEX_SHADER ? "vertex" : "fragment");
+	LUN_DEBUG("Shader::compileShader - Compiled {} shader successfully", type == GL_VERTEX_SHADER ? "vertex" : type == GL_COMPUTE_SHADER ? "compute" : "fragment");
 
     return shader;
 }
@@ -68,6 +84,24 @@ unsigned int Shader::createProgram(unsigned int vertex, unsigned int fragment) c
     return program;
 }
 
+unsigned int Shader::createProgram(unsigned int compute) const {
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, compute);
+    glLinkProgram(program);
+
+    int success = 0;
+    char infoLog[512] = {};
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
+        throw std::runtime_error("Shader::createProgram - Failed to link compute program:\n" + std::string(infoLog));
+    }
+
+    glDeleteShader(compute);
+
+    return program;
+}
+
 Shader::~Shader() {
   glDeleteProgram(m_id);
 }
@@ -110,6 +144,12 @@ void Shader::set(const std::string_view name, const glm::vec3& value) const {
     glUniform3fv(loc, 1, glm::value_ptr(value));
 }
 
+void Shader::set(const std::string_view name, const glm::vec4& value) const {
+    GLint loc = glGetUniformLocation(m_id, name.data());
+    if (loc == -1) throw std::runtime_error("Uniform '" + std::string(name) + "' not found");
+    glUniform4fv(loc, 1, glm::value_ptr(value));
+}
+
 void Shader::set(const std::string_view name, float* value, int count) const {
     GLint loc = glGetUniformLocation(m_id, name.data());
     if (loc == -1) throw std::runtime_error("Uniform '" + std::string(name) + "' not found");
@@ -33,9 +33,10 @@ constexpr const char* DEFAULT_FRAGMENT_SRC = R"(
 in vec3 fragNormal;
 //in vec2 fragTexCoord;
 
-out vec3 FragColor;
+out vec4 FragColor;
 
 uniform vec3 u_color;
+uniform float u_opacity = 1.0;
 
 void main() {
 	vec3 lightDir = normalize(vec3(0.5, 1.0, 0.3)); // Fake light direction
@@ -43,7 +44,173 @@ void main() {
 	float lightIntensity = 1.0;
 	float directional = max(dot(fragNormal, lightDir), 0.0) * 0.7;
 	float lighting = ambient + directional;
-	FragColor = u_color * lighting;
+	FragColor = vec4(u_color * lighting, u_opacity);
+}
+)";
+
+// Reads its model matrix and color from the DrawDataBuffer the RenderQueue fills, indexed by
+// gl_BaseInstance, which the queue points at the draw's first record, plus gl_InstanceID
+constexpr const char* DRAW_DATA_VERTEX_SRC = R"(
+#version 460 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+
+struct DrawData {
+	mat4 model;
+	vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+	DrawData draws[];
+};
+
+out vec3 fragNormal;
+flat out vec4 fragColor;
+
+uniform mat4 u_viewProjection;
+
+void main() {
+	DrawData draw = draws[gl_BaseInstance + gl_InstanceID];
+	gl_Position = u_viewProjection * draw.model * vec4(position, 1.0);
+	fragNormal = mat3(draw.model) * normal;
+	fragColor = draw.color;
+}
+)";
+
+constexpr const char* DRAW_DATA_FRAGMENT_SRC = R"(
+#version 460 core
+
+in vec3 fragNormal;
+flat in vec4 fragColor;
+
+out vec4 FragColor;
+
+void main() {
+	vec3 lightDir = normalize(vec3(0.5, 1.0, 0.3)); // Fake light direction
+	float ambient = 0.3;
+	float directional = max(dot(fragNormal, lightDir), 0.0) * 0.7;
+	FragColor = vec4(fragColor.rgb * (ambient + directional), fragColor.a);
+}
+)";
+
+// Compute pass of the GpuCuller. Tests every draw's bounding sphere against the frustum and,
+// optionally, last frame's depth pyramid, and appends the survivors to their indirect command:
+// the command's instanceCount is bumped and the draw's record copied to the slot it names.
+constexpr const char* CULL_DRAWS_COMPUTE_SRC = R"(
+#version 460 core
+
+layout(local_size_x = 64) in;
+
+struct DrawData {
+	mat4 model;
+	vec4 color;
+};
+
+struct CullRecord {
+	vec4 sphere; // local center and radius
+	uint command;
+	uint padding[3];
+};
+
+struct DrawCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout(std430, binding = 0) writeonly buffer CompactedBuffer { DrawData compacted[]; };
+layout(std430, binding = 1) readonly buffer DrawDataBuffer { DrawData draws[]; };
+layout(std430, binding = 2) readonly buffer CullRecordBuffer { CullRecord records[]; };
+layout(std430, binding = 3) buffer CommandBuffer { DrawCommand commands[]; };
+
+uniform int u_count;
+uniform vec4 u_planes[6]; // inward facing, normalized
+uniform int u_useHiZ;
+uniform mat4 u_previousViewProjection;
+uniform vec2 u_hiZSize;
+uniform sampler2D u_hiZ;
+
+bool occluded(vec3 center, float radius) {
+	// Screen rectangle and nearest depth of the sphere's box in the frame the pyramid is from
+	vec2 minUV = vec2(1.0);
+	vec2 maxUV = vec2(0.0);
+	float nearest = 1.0;
+	for (int i = 0; i < 8; ++i) {
+		vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = u_previousViewProjection * vec4(corner, 1.0);
+		if (clip.w <= 0.0) return false; // Crosses the near plane
+		vec3 ndc = clip.xyz / clip.w;
+		minUV = min(minUV, ndc.xy * 0.5 + 0.5);
+		maxUV = max(maxUV, ndc.xy * 0.5 + 0.5);
+		nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+	minUV = clamp(minUV, 0.0, 1.0);
+	maxUV = clamp(maxUV, 0.0, 1.0);
+
+	// The level where the rectangle covers at most 2x2 texels
+	vec2 extent = (maxUV - minUV) * u_hiZSize;
+	float level = ceil(log2(max(max(extent.x, extent.y), 1.0)));
+	float farthest = max(
+		max(textureLod(u_hiZ, minUV, level).r, textureLod(u_hiZ, vec2(maxUV.x, minUV.y), level).r),
+		max(textureLod(u_hiZ, vec2(minUV.x, maxUV.y), level).r, textureLod(u_hiZ, maxUV, level).r));
+	return nearest > farthest;
+}
+
+void main() {
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= uint(u_count)) return;
+
+	CullRecord record = records[index];
+	mat4 model = draws[index].model;
+	vec3 center = (model * vec4(record.sphere.xyz, 1.0)).xyz;
+	float radius = record.sphere.w * max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+
+	for (int i = 0; i < 6; ++i) {
+		if (dot(u_planes[i].xyz, center) + u_planes[i].w < -radius) return;
+	}
+	if (u_useHiZ != 0 && occluded(center, radius)) return;
+
+	uint slot = atomicAdd(commands[record.command].instanceCount, 1u);
+	compacted[commands[record.command].baseInstance + slot] = draws[index];
+}
+)";
+
+// Builds one level of the GpuCuller's depth pyramid: level 0 copies the depth texture, every
+// other level keeps the farthest depth of the texels it covers in the level above, including
+// the extra row and column an odd size leaves over
+constexpr const char* BUILD_HIZ_COMPUTE_SRC = R"(
+#version 460 core
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32f, binding = 0) uniform writeonly image2D u_target;
+layout(r32f, binding = 1) uniform readonly image2D u_source;
+uniform sampler2D u_depth;
+uniform int u_fromDepth;
+
+void main() {
+	ivec2 target = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(u_target);
+	if (any(greaterThanEqual(target, size))) return;
+
+	if (u_fromDepth != 0) {
+		imageStore(u_target, target, vec4(texelFetch(u_depth, target, 0).r));
+		return;
+	}
+
+	ivec2 sourceSize = imageSize(u_source);
+	ivec2 first = target * 2;
+	ivec2 last = min(first + 1 + ivec2(equal(target, size - 1)) * (sourceSize & 1), sourceSize - 1);
+	float farthest = 0.0;
+	for (int y = first.y; y <= last.y; ++y) {
+		for (int x = first.x; x <= last.x; ++x) {
+			farthest = max(farthest, imageLoad(u_source, ivec2(x, y)).r);
+		}
+	}
+	imageStore(u_target, target, vec4(farthest));
 }
 )";
 
@@ -51,12 +218,18 @@ void main() {
 class Shader {
 public:
   Shader(const std::string &vertexPath, const std::string &fragmentPath);
+  // Shaders compiled in, Default reads u_model and u_color, DrawData reads the DrawDataBuffer.
+  // CullDraws and BuildHiZ are the GpuCuller's compute programs.
+  enum class Builtin { Default, DrawData, CullDraws, BuildHiZ };
+
   Shader(); // Uses default shaders
+  explicit Shader(Builtin builtin);
 
   ~Shader();
 
   // Apply the shader to the current OpenGL context
   void use() const;
+  unsigned int getProgram() const { return m_id; }
 
   // Utility uniform functions for setting values
   // without using many different functions
@@ -66,6 +239,7 @@ public:
   void set(std::string_view name, GLfloat *value) const;
   void set(std::string_view name, const glm::mat4& value) const;
   void set(std::string_view name, const glm::vec3& value) const;
+  void set(std::string_view name, const glm::vec4& value) const;
   void set(std::string_view name, float *value, int count) const;
 
 private:
@@ -75,5 +249,6 @@ private:
     std::string loadShaderSource(const std::string& path) const;
     unsigned int compileShader(unsigned int type, const char* source) const;
     unsigned int createProgram(unsigned int vertex, unsigned int fragment) const;
+    unsigned int createProgram(unsigned int compute) const;
 };
 } // namespace Lunatic
@@ -0,0 +1,200 @@
+#include "pch.h"
+
+#include "vertex_layout.h"
+
+using namespace Lunatic;
+
+// Round to nearest even, overflow goes to infinity and underflow through the subnormals to 0
+static std::uint16_t floatToHalf(float value) {
+	const std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+	const std::uint32_t sign = (bits >> 16) & 0x8000;
+	const std::uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000) { // Inf or NaN
+		return static_cast<std::uint16_t>(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+	}
+	if (magnitude >= 0x477FF000) { // Rounds past the largest half
+		return static_cast<std::uint16_t>(sign | 0x7C00);
+	}
+	if (magnitude < 0x38800000) { // Subnormal half
+		if (magnitude < 0x33000000) return static_cast<std::uint16_t>(sign);
+		const std::uint32_t mantissa = (magnitude & 0x007FFFFF) | 0x00800000;
+		const std::uint32_t shift = 126 - (magnitude >> 23);
+		std::uint32_t half = mantissa >> shift;
+		const std::uint32_t rest = mantissa & ((1u << shift) - 1);
+		const std::uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+		return static_cast<std::uint16_t>(sign | half);
+	}
+
+	std::uint32_t half = ((magnitude - 0x38000000) >> 13);
+	const std::uint32_t rest = magnitude & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+	return static_cast<std::uint16_t>(sign | half);
+}
+
+static float halfToFloat(std::uint16_t half) {
+	const std::uint32_t sign = std::uint32_t(half & 0x8000) << 16;
+	const std::uint32_t exponent = (half >> 10) & 0x1F;
+	const std::uint32_t mantissa = half & 0x3FF;
+
+	if (exponent == 0x1F) { // Inf or NaN
+		return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+	}
+	if (exponent == 0) { // Zero or subnormal, exact in a float
+		const float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+		return sign ? -magnitude : magnitude;
+	}
+	return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+VertexLayout::VertexLayout(std::initializer_list<VertexAttribute> attributes) {
+	for (const VertexAttribute& attribute : attributes) {
+		add(attribute.location, attribute.format);
+	}
+}
+
+VertexLayout VertexLayout::Standard() {
+	return VertexLayout({
+		{ 0, VertexFormat::Float3 },
+		{ 1, VertexFormat::Float3 },
+		{ 2, VertexFormat::Float2 }
+	});
+}
+
+VertexLayout VertexLayout::FromKey(std::uint64_t key) {
+	VertexLayout layout;
+	for (; key != 0; key >>= 8) {
+		const auto location = static_cast<std::uint32_t>((key >> 4) & 0xF);
+		const auto format = static_cast<VertexFormat>((key & 0xF) - 1);
+		LUN_ASSERT(static_cast<std::uint32_t>(format) <= static_cast<std::uint32_t>(VertexFormat::Snorm10x3), "Unknown vertex format")
+		layout.add(location, format);
+	}
+	return layout;
+}
+
+void VertexLayout::add(std::uint32_t location, VertexFormat format) {
+	LUN_ASSERT(m_count < MAX_ATTRIBUTES, "Too many vertex attributes")
+	LUN_ASSERT(location < 16 && !find(location), "Vertex attribute locations must be unique and below 16")
+
+	m_attributes[m_count++] = VertexAttribute{ location, format, m_stride };
+	m_stride += FormatSize(format);
+}
+
+std::uint32_t VertexLayout::FormatSize(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Float2: return 8;
+	case VertexFormat::Float3: return 12;
+	case VertexFormat::Half4: return 8;
+	case VertexFormat::Unorm16x2: return 4;
+	case VertexFormat::Snorm10x3: return 4;
+	}
+	return 0;
+}
+
+void VertexLayout::Encode(VertexFormat format, const float* values, std::byte* out) {
+	switch (format) {
+	case VertexFormat::Float2:
+		std::memcpy(out, values, 2 * sizeof(float));
+		break;
+	case VertexFormat::Float3:
+		std::memcpy(out, values, 3 * sizeof(float));
+		break;
+	case VertexFormat::Half4: {
+		const std::array<std::uint16_t, 4> halves = { floatToHalf(values[0]), floatToHalf(values[1]), floatToHalf(values[2]), floatToHalf(1.0f) };
+		std::memcpy(out, halves.data(), sizeof(halves));
+		break;
+	}
+	case VertexFormat::Unorm16x2: {
+		std::array<std::uint16_t, 2> packed;
+		for (std::size_t i = 0; i < 2; ++i) {
+			packed[i] = static_cast<std::uint16_t>(std::lround(std::clamp(values[i], 0.0f, 1.0f) * 65535.0f));
+		}
+		std::memcpy(out, packed.data(), sizeof(packed));
+		break;
+	}
+	case VertexFormat::Snorm10x3: {
+		std::uint32_t packed = 0;
+		for (std::size_t i = 0; i < 3; ++i) {
+			const auto component = static_cast<std::int32_t>(std::lround(std::clamp(values[i], -1.0f, 1.0f) * 511.0f));
+			packed |= (static_cast<std::uint32_t>(component) & 0x3FF) << (10 * i);
+		}
+		std::memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	}
+}
+
+void VertexLayout::Decode(VertexFormat format, const std::byte* in, float* values) {
+	switch (format) {
+	case VertexFormat::Float2:
+		std::memcpy(values, in, 2 * sizeof(float));
+		break;
+	case VertexFormat::Float3:
+		std::memcpy(values, in, 3 * sizeof(float));
+		break;
+	case VertexFormat::Half4: {
+		std::array<std::uint16_t, 3> halves;
+		std::memcpy(halves.data(), in, sizeof(halves));
+		for (std::size_t i = 0; i < 3; ++i) values[i] = halfToFloat(halves[i]);
+		break;
+	}
+	case VertexFormat::Unorm16x2: {
+		std::array<std::uint16_t, 2> packed;
+		std::memcpy(packed.data(), in, sizeof(packed));
+		for (std::size_t i = 0; i < 2; ++i) values[i] = packed[i] / 65535.0f;
+		break;
+	}
+	case VertexFormat::Snorm10x3: {
+		std::uint32_t packed;
+		std::memcpy(&packed, in, sizeof(packed));
+		for (std::size_t i = 0; i < 3; ++i) {
+			// Sign extend the 10 bits, -512 clamps to -1 like GL does
+			const std::int32_t component = static_cast<std::int32_t>(packed << (22 - 10 * i)) >> 22;
+			values[i] = std::max(component / 511.0f, -1.0f);
+		}
+		break;
+	}
+	}
+}
+
+const VertexAttribute* VertexLayout::find(std::uint32_t location) const {
+	for (const VertexAttribute& attribute : getAttributes()) {
+		if (attribute.location == location) return &attribute;
+	}
+	return nullptr;
+}
+
+std::uint64_t VertexLayout::getKey() const {
+	// A byte per attribute, first one lowest: location in the high nibble, format + 1 in the low one
+	std::uint64_t key = 0;
+	for (std::size_t i = m_count; i-- > 0;) {
+		key = (key << 8) | (std::uint64_t(m_attributes[i].location) << 4) | (static_cast<std::uint64_t>(m_attributes[i].format) + 1);
+	}
+	return key;
+}
+
+void VertexLayout::apply(GLuint vao, GLuint binding) const {
+	for (const VertexAttribute& attribute : getAttributes()) {
+		glEnableVertexArrayAttrib(vao, attribute.location);
+		glVertexArrayAttribBinding(vao, attribute.location, binding);
+
+		switch (attribute.format) {
+		case VertexFormat::Float2:
+			glVertexArrayAttribFormat(vao, attribute.location, 2, GL_FLOAT, GL_FALSE, attribute.offset);
+			break;
+		case VertexFormat::Float3:
+			glVertexArrayAttribFormat(vao, attribute.location, 3, GL_FLOAT, GL_FALSE, attribute.offset);
+			break;
+		case VertexFormat::Half4:
+			glVertexArrayAttribFormat(vao, attribute.location, 4, GL_HALF_FLOAT, GL_FALSE, attribute.offset);
+			break;
+		case VertexFormat::Unorm16x2:
+			glVertexArrayAttribFormat(vao, attribute.location, 2, GL_UNSIGNED_SHORT, GL_TRUE, attribute.offset);
+			break;
+		case VertexFormat::Snorm10x3:
+			glVertexArrayAttribFormat(vao, attribute.location, 4, GL_INT_2_10_10_10_REV, GL_TRUE, attribute.offset);
+			break;
+		}
+	}
+}
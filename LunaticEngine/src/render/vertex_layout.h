@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Lunatic {
+	enum class VertexFormat : std::uint8_t {
+		Float2,
+		Float3,
+		Half4,     // a vec3 in half floats, padded to 8 bytes
+		Unorm16x2, // [0, 1] in 16 bits each
+		Snorm10x3  // GL_INT_2_10_10_10_REV, [-1, 1] in 10 bits each, the top 2 bits unused
+	};
+
+	struct VertexAttribute {
+		std::uint32_t location = 0;
+		VertexFormat format = VertexFormat::Float3;
+		std::uint32_t offset = 0; // assigned by VertexLayout
+	};
+
+	/// <summary>
+	/// Describes one interleaved vertex: which formats the attribute locations are stored in.
+	/// Attributes are packed in the order given, every format is a multiple of 4 bytes so they
+	/// stay aligned. Shaders see the same float vectors whatever the format, the packed ones
+	/// are normalized or converted by the vertex fetch.
+	/// </summary>
+	class VertexLayout {
+	public:
+		static constexpr std::size_t MAX_ATTRIBUTES = 8;
+
+		VertexLayout() = default;
+		VertexLayout(std::initializer_list<VertexAttribute> attributes);
+
+		// Float3 position, Float3 normal, Float2 texture coords at locations 0, 1 and 2
+		static VertexLayout Standard();
+		// Rebuilds a layout from getKey()
+		static VertexLayout FromKey(std::uint64_t key);
+
+		static std::uint32_t FormatSize(VertexFormat format);
+		// Packs the format's component count of values into out
+		static void Encode(VertexFormat format, const float* values, std::byte* out);
+		// The inverse, as the vertex fetch would see it. Half4's padding is left out.
+		static void Decode(VertexFormat format, const std::byte* in, float* values);
+
+		std::span<const VertexAttribute> getAttributes() const { return { m_attributes.data(), m_count }; }
+		const VertexAttribute* find(std::uint32_t location) const;
+		std::uint32_t getStride() const { return m_stride; }
+		// Locations and formats in order, equal keys mean equal layouts
+		std::uint64_t getKey() const;
+
+		// Sets up the attributes of vao to read from binding, with direct state access
+		void apply(GLuint vao, GLuint binding) const;
+
+		bool operator==(const VertexLayout& other) const { return getKey() == other.getKey(); }
+
+	private:
+		std::array<VertexAttribute, MAX_ATTRIBUTES> m_attributes{};
+		std::size_t m_count = 0;
+		std::uint32_t m_stride = 0;
+
+		void add(std::uint32_t location, VertexFormat format);
+	};
+} // namespace Lunatic
@@ -0,0 +1,196 @@
+#include "pch.h"
+
+#include "allocator.h"
+
+using namespace Lunatic;
+
+LuaAllocator::LuaAllocator() {
+	m_owners.emplace_back(); // SHARED_OWNER
+}
+
+LuaAllocator::~LuaAllocator() {
+	for (std::byte* chunk : m_chunks) {
+		std::free(chunk);
+	}
+}
+
+void* LuaAllocator::Alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize) {
+	auto* allocator = static_cast<LuaAllocator*>(ud);
+
+	if (nsize == 0) {
+		if (ptr) allocator->deallocate(ptr, osize);
+		return nullptr;
+	}
+
+	// Lua 5.1 passes 0 as the old size of a fresh block, 5.2+ passes a type tag instead
+	if (!ptr) return allocator->allocate(nsize, allocator->m_currentOwner);
+
+	return allocator->reallocate(ptr, osize, nsize);
+}
+
+LuaAllocator::OwnerId LuaAllocator::registerOwner(std::size_t limit) {
+	// A released id only comes back once the GC has freed every block charged to it
+	if (!m_freeOwners.empty()) {
+		OwnerId owner = m_freeOwners.back();
+		m_freeOwners.pop_back();
+		m_owners[owner] = OwnerStats{ .limit = limit };
+		return owner;
+	}
+
+	OwnerId owner = static_cast<OwnerId>(m_owners.size());
+	m_owners.push_back(OwnerStats{ .limit = limit });
+	return owner;
+}
+
+void LuaAllocator::releaseOwner(OwnerId owner) {
+	if (owner == SHARED_OWNER || owner >= m_owners.size() || m_owners[owner].released) return;
+
+	m_owners[owner].released = true;
+	m_owners[owner].limit = 0;
+	if (m_currentOwner == owner) m_currentOwner = SHARED_OWNER;
+	if (m_owners[owner].bytes == 0) m_freeOwners.push_back(owner);
+}
+
+void LuaAllocator::setLimit(OwnerId owner, std::size_t limit) {
+	if (owner == SHARED_OWNER || owner >= m_owners.size()) return;
+	m_owners[owner].limit = limit;
+}
+
+std::size_t LuaAllocator::takeAllocated(OwnerId owner) {
+	return std::exchange(m_owners[owner].allocatedBytes, 0);
+}
+
+bool LuaAllocator::charge(OwnerId owner, std::size_t bytes, bool enforceLimit) {
+	auto& stats = m_owners[owner];
+	if (enforceLimit && stats.limit > 0 && stats.bytes + bytes > stats.limit) return false;
+
+	stats.bytes += bytes;
+	stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+	stats.allocatedBytes += bytes;
+	m_liveBytes += bytes;
+	return true;
+}
+
+void LuaAllocator::refund(OwnerId owner, std::size_t bytes) {
+	auto& stats = m_owners[owner];
+	stats.bytes -= bytes;
+	m_liveBytes -= bytes;
+
+	// Nothing can be charged to a released owner anymore, so this was its last block
+	if (stats.released && stats.bytes == 0 && bytes > 0) m_freeOwners.push_back(owner);
+}
+
+std::uint32_t LuaAllocator::classFor(std::size_t size) {
+	std::size_t total = size + HEADER_SIZE;
+	if (total > MAX_POOLED_SIZE) return LARGE_CLASS;
+	return static_cast<std::uint32_t>((total + CLASS_GRANULARITY - 1) / CLASS_GRANULARITY - 1);
+}
+
+LuaAllocator::BlockHeader* LuaAllocator::headerOf(void* ptr) {
+	return reinterpret_cast<BlockHeader*>(static_cast<std::byte*>(ptr) - HEADER_SIZE);
+}
+
+void* LuaAllocator::allocate(std::size_t size, OwnerId owner, bool enforceLimit) {
+	// A refused charge makes Lua raise "not enough memory" inside the offending script
+	if (!charge(owner, size, enforceLimit)) return nullptr;
+
+	std::uint32_t sizeClass = classFor(size);
+	std::byte* block = nullptr;
+
+	if (sizeClass == LARGE_CLASS) {
+		block = static_cast<std::byte*>(std::malloc(size + HEADER_SIZE));
+	}
+	else {
+		Pool& pool = m_pools[sizeClass];
+		std::size_t blockSize = (sizeClass + 1) * CLASS_GRANULARITY;
+
+		if (pool.freeList) {
+			block = reinterpret_cast<std::byte*>(pool.freeList);
+			pool.freeList = pool.freeList->next;
+		}
+		else {
+			if (pool.cursor == nullptr || pool.cursor + blockSize > pool.end) {
+				auto* chunk = static_cast<std::byte*>(std::malloc(CHUNK_SIZE));
+				if (chunk) {
+					m_chunks.push_back(chunk);
+					m_reservedBytes += CHUNK_SIZE;
+					pool.cursor = chunk;
+					pool.end = chunk + CHUNK_SIZE;
+				}
+			}
+
+			if (pool.cursor && pool.cursor + blockSize <= pool.end) {
+				block = pool.cursor;
+				pool.cursor += blockSize;
+			}
+		}
+	}
+
+	if (!block) {
+		refund(owner, size);
+		return nullptr;
+	}
+
+	auto* header = reinterpret_cast<BlockHeader*>(block);
+	header->owner = owner;
+	header->sizeClass = sizeClass;
+	return block + HEADER_SIZE;
+}
+
+void LuaAllocator::deallocate(void* ptr, std::size_t size) {
+	BlockHeader* header = headerOf(ptr);
+	refund(header->owner, size);
+
+	if (header->sizeClass == LARGE_CLASS) {
+		std::free(header);
+		return;
+	}
+
+	auto* block = reinterpret_cast<FreeBlock*>(header);
+	Pool& pool = m_pools[header->sizeClass];
+	block->next = pool.freeList;
+	pool.freeList = block;
+}
+
+void* LuaAllocator::reallocate(void* ptr, std::size_t oldSize, std::size_t newSize) {
+	BlockHeader* header = headerOf(ptr);
+	OwnerId owner = header->owner; // growth stays with whoever created the object
+
+	std::uint32_t newClass = classFor(newSize);
+	if (newClass == header->sizeClass && newClass != LARGE_CLASS) {
+		if (newSize > oldSize) {
+			if (!charge(owner, newSize - oldSize)) return nullptr;
+		}
+		else {
+			refund(owner, oldSize - newSize);
+		}
+		return ptr;
+	}
+
+	if (newClass == LARGE_CLASS && header->sizeClass == LARGE_CLASS) {
+		if (newSize > oldSize && !charge(owner, newSize - oldSize)) return nullptr;
+
+		auto* grown = static_cast<BlockHeader*>(std::realloc(header, newSize + HEADER_SIZE));
+		if (!grown) {
+			if (newSize > oldSize) refund(owner, newSize - oldSize);
+			return nullptr;
+		}
+
+		if (newSize < oldSize) refund(owner, oldSize - newSize);
+		return reinterpret_cast<std::byte*>(grown) + HEADER_SIZE;
+	}
+
+	// Lua assumes shrinking never fails, so only growth is held to the limit
+	void* moved = allocate(newSize, owner, newSize > oldSize);
+	if (!moved) {
+		if (newSize > oldSize) return nullptr;
+
+		// Out of memory while shrinking, the old block is still big enough and keeps its class
+		refund(owner, oldSize - newSize);
+		return ptr;
+	}
+
+	std::memcpy(moved, ptr, std::min(oldSize, newSize));
+	deallocate(ptr, oldSize);
+	return moved;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "pch.h"
+
+namespace Lunatic {
+	/// <summary>
+	/// lua_Alloc implementation backed by size-class pools. Every block carries a small
+	/// header naming the owner it was allocated for, which lets a VM account memory per
+	/// script and refuse allocations past a cap. Not thread-safe: each VM owns one and
+	/// only ever uses it from its own thread.
+	/// </summary>
+	class LuaAllocator {
+	public:
+		using OwnerId = std::uint32_t;
+		static constexpr OwnerId SHARED_OWNER = 0; // VM runtime, globals, anything not charged to a script
+
+		struct OwnerStats {
+			std::size_t bytes = 0;       // currently live
+			std::size_t peakBytes = 0;
+			std::size_t limit = 0;       // 0 = unlimited
+			std::size_t allocatedBytes = 0; // allocated since the last takeAllocated(), i.e. GC pressure
+			bool released = false;
+		};
+
+		LuaAllocator();
+		~LuaAllocator();
+
+		// Matches lua_Alloc, ud must point at the LuaAllocator
+		static void* Alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize);
+
+		OwnerId registerOwner(std::size_t limit = 0);
+		void releaseOwner(OwnerId owner);
+		void setLimit(OwnerId owner, std::size_t limit);
+
+		// New blocks are charged to this owner until it is changed again
+		void setCurrentOwner(OwnerId owner) { m_currentOwner = owner; }
+		OwnerId getCurrentOwner() const { return m_currentOwner; }
+
+		const OwnerStats& getStats(OwnerId owner) const { return m_owners[owner]; }
+		std::size_t takeAllocated(OwnerId owner);
+
+		std::size_t getLiveBytes() const { return m_liveBytes; }
+		std::size_t getReservedBytes() const { return m_reservedBytes; }
+
+	private:
+		struct alignas(std::max_align_t) BlockHeader {
+			OwnerId owner;
+			std::uint32_t sizeClass;
+		};
+
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		static constexpr std::size_t HEADER_SIZE = sizeof(BlockHeader);
+		static constexpr std::size_t CLASS_GRANULARITY = alignof(std::max_align_t);
+		static constexpr std::size_t MAX_POOLED_SIZE = 512; // header included
+		static constexpr std::size_t CLASS_COUNT = MAX_POOLED_SIZE / CLASS_GRANULARITY;
+		static constexpr std::uint32_t LARGE_CLASS = std::numeric_limits<std::uint32_t>::max();
+		static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+		struct Pool {
+			FreeBlock* freeList = nullptr;
+			std::byte* cursor = nullptr; // bump region in the newest chunk
+			std::byte* end = nullptr;
+		};
+
+		std::array<Pool, CLASS_COUNT> m_pools{};
+		std::vector<std::byte*> m_chunks;
+		std::vector<OwnerStats> m_owners;
+		std::vector<OwnerId> m_freeOwners; // released owners whose last block is gone
+		OwnerId m_currentOwner = SHARED_OWNER;
+
+		std::size_t m_liveBytes = 0;
+		std::size_t m_reservedBytes = 0;
+
+		void* allocate(std::size_t size, OwnerId owner, bool enforceLimit = true);
+		void deallocate(void* ptr, std::size_t size);
+		void* reallocate(void* ptr, std::size_t oldSize, std::size_t newSize);
+
+		bool charge(OwnerId owner, std::size_t bytes, bool enforceLimit = true);
+		void refund(OwnerId owner, std::size_t bytes);
+
+		static std::uint32_t classFor(std::size_t size);
+		static BlockHeader* headerOf(void* ptr);
+	};
+} // namespace Lunatic
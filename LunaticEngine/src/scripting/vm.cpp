@@ -0,0 +1,704 @@
+#include "pch.h"
+
+#include "vm.h"
+
+using namespace Lunatic;
+
+// How many VM instructions run between two budget checks
+static constexpr int BUDGET_HOOK_INTERVAL = 1000;
+
+// The VM ticking on this thread, count hooks carry no user data of their own
+static thread_local ScriptVM* t_activeVM = nullptr;
+
+// A script past this share of its memory cap gets a full collection before its next resume
+static constexpr std::size_t LIMIT_COLLECT_PERCENT = 90;
+
+static const char* LUA_COROUTINE_SYSTEM = R"CORO(
+-- Script runner factory (always wraps the script, basically so that it is in a coroutine)
+function create_script_runner(script_code, name)
+    name = name or "Script"
+
+    -- Always wrap the code in a function, assume the user isn't stupid
+    local wrapped_code = "return function()\n" .. script_code .. "\nend"
+
+    -- Compile the wrapped code
+    local chunk, err = loadstring(wrapped_code, name)
+    if not chunk then
+        error("Compilation error: " .. err)
+    end
+
+    -- Execute to get the main function
+    local success, main_func = pcall(chunk)
+    if not success then
+        error("Execution error: " .. main_func)
+    end
+
+    if type(main_func) ~= "function" then
+        error("Script must return a function")
+    end
+
+    -- Create the coroutine
+    local co = coroutine.create(main_func)
+
+    -- Return the runner function
+    return function()
+        if coroutine.status(co) == "dead" then
+            return false, 0, nil
+        end
+
+        local status, waitTime = coroutine.resume(co)
+
+        if not status then
+            return false, 0, waitTime -- err
+        end
+
+        if coroutine.status(co) == "suspended" then
+            return true, waitTime or 0, nil
+        else
+            return false, 0, nil
+        end
+    end
+end
+
+-- Standard wait function for use in scripts
+function wait(seconds)
+    return coroutine.yield(seconds or 0.01)
+end
+)CORO";
+
+ScriptVM::ScriptVM(std::size_t index, bool threaded, MainThreadPoster postToMain)
+	: m_index(index), m_threaded(threaded), m_postToMain(std::move(postToMain)),
+	m_state(createState(), &lua_close), m_lua(m_state.get()) {
+	m_lua.open_libraries(
+		sol::lib::base,
+		sol::lib::math,
+		sol::lib::table,
+		sol::lib::string,
+		sol::lib::coroutine
+	);
+
+	// Set up global logging functions
+	sol::global_table globals = m_lua.globals();
+	registerLogFuncs(globals);
+
+	// Initialize coroutine runtime
+	initializeCoroutineRuntime();
+
+	// Take the collector off the allocation path, see collectGarbage()
+	applyGCSettings();
+
+	// The state is fully set up before the worker exists, from here on only the worker touches it
+	if (m_threaded) {
+		m_worker = std::thread(&ScriptVM::workerLoop, this);
+	}
+}
+
+ScriptVM::~ScriptVM() {
+	if (m_worker.joinable()) {
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopRequested = true;
+		}
+		m_wake.notify_one();
+		m_worker.join();
+	}
+}
+
+lua_State* ScriptVM::createState() {
+	lua_State* L = lua_newstate(&LuaAllocator::Alloc, &m_allocator);
+	if (L) {
+		m_pooledAllocator = true;
+	}
+	else {
+		// LuaJIT builds without GC64 refuse custom allocators on 64-bit targets
+		spdlog::warn("[Scripting][VM {}] Pooled allocator unavailable, falling back to the default one", m_index);
+		L = luaL_newstate();
+	}
+
+	LUN_ASSERT(L != nullptr, "Failed to create Lua state")
+	sol::set_default_state(L);
+	return L;
+}
+
+void ScriptVM::post(Job job) {
+	{
+		std::lock_guard lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+
+	if (m_threaded) {
+		m_wake.notify_one();
+	}
+}
+
+void ScriptVM::runInline(Job job) {
+	LUN_ASSERT(!m_threaded, "runInline called on a worker VM")
+
+	std::vector<Job> jobs;
+	{
+		std::lock_guard lock(m_mutex);
+		jobs.swap(m_jobs);
+	}
+
+	jobs.push_back(std::move(job));
+	runJobs(jobs);
+}
+
+void ScriptVM::kick(const ScriptFrame& frame) {
+	if (m_threaded) {
+		{
+			std::lock_guard lock(m_mutex);
+			m_pendingFrame = frame;
+			m_hasFrame = true;
+		}
+		m_wake.notify_one();
+		return;
+	}
+
+	std::vector<Job> jobs;
+	{
+		std::lock_guard lock(m_mutex);
+		jobs.swap(m_jobs);
+	}
+
+	runJobs(jobs);
+	tick(frame);
+	publish();
+}
+
+void ScriptVM::workerLoop() {
+	std::vector<Job> jobs;
+	std::unique_lock lock(m_mutex);
+
+	while (true) {
+		m_wake.wait(lock, [this] { return m_stopRequested || m_hasFrame || !m_jobs.empty(); });
+		if (m_stopRequested) break;
+
+		jobs.swap(m_jobs);
+		bool hasFrame = m_hasFrame;
+		ScriptFrame frame = m_pendingFrame;
+		m_hasFrame = false;
+
+		lock.unlock();
+
+		runJobs(jobs);
+		if (hasFrame) {
+			tick(frame);
+			collectGarbage();
+		}
+		publish();
+
+		lock.lock();
+	}
+}
+
+void ScriptVM::endFrame() {
+	if (m_threaded) return;
+
+	collectGarbage();
+
+	std::lock_guard lock(m_publishMutex);
+	m_publishedGC = m_gcStats;
+}
+
+void ScriptVM::runJobs(std::vector<Job>& jobs) {
+	for (auto& job : jobs) {
+		try {
+			job(*this);
+		}
+		catch (const std::exception& e) {
+			log(spdlog::level::err, fmt::format("[Scripting][VM {}] Job error: {}", m_index, e.what()));
+		}
+	}
+	jobs.clear();
+}
+
+void ScriptVM::tick(const ScriptFrame& frame) {
+	// Counts the steps taken between resumes as well as those at the end of the frame
+	m_gcStats.stepsLastFrame = 0;
+
+	try {
+		t_activeVM = this;
+
+		// Process each script
+		for (auto& [name, script] : m_scripts) {
+			// Skip scripts that are not running
+			if (!script.state.isRunning) continue;
+
+			// Skip paused scripts
+			if (script.state.isPaused) continue;
+
+			// Skip scripts that are waiting
+			if (frame.time < script.state.waitUntil) continue;
+
+			// Skip invalid coroutines
+			if (!script.coroutine.valid()) {
+				script.state.isRunning = false;
+				script.state.error = "Invalid coroutine";
+				continue;
+			}
+
+			resumeScript(name, script, frame);
+			boundHeap();
+		}
+	}
+	catch (std::exception& e) {
+		log(spdlog::level::err, fmt::format("[Scripting] Update error: {}", e.what()));
+	}
+
+	m_running = {};
+	t_activeVM = nullptr;
+}
+
+void ScriptVM::resumeScript(const std::string& name, ScriptData& script, const ScriptFrame& frame) {
+	collectNearLimit(script);
+
+	if (m_budget.isActive()) {
+		// Re-arming the hook resets its counter, so every resume starts with a full budget
+		lua_sethook(m_lua.lua_state(), &ScriptVM::budgetHook, LUA_MASKCOUNT, BUDGET_HOOK_INTERVAL);
+	}
+
+	m_running = RunningScript{
+		.script = &script,
+		.start = std::chrono::steady_clock::now()
+	};
+
+	// Resume the coroutine, charging whatever it allocates to the script
+	m_allocator.setCurrentOwner(script.owner);
+	sol::protected_function_result result = script.coroutine();
+	m_allocator.setCurrentOwner(LuaAllocator::SHARED_OWNER);
+
+	bool exceeded = m_running.exceeded;
+	float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_running.start).count();
+	m_running = {};
+
+	script.state.lastRunMs = elapsedMs;
+	script.state.averageRunMs = script.state.averageRunMs == 0.0f ? elapsedMs : glm::mix(script.state.averageRunMs, elapsedMs, 0.1f);
+	script.state.peakRunMs = std::max(script.state.peakRunMs, elapsedMs);
+
+	if (exceeded) {
+		++script.state.budgetOverruns;
+		if (m_budget.killOnExceed) {
+			log(spdlog::level::warn, fmt::format("[Scripting][{}] Killed after exceeding its CPU budget", name));
+		}
+		else if (script.state.budgetOverruns == 1) {
+			log(spdlog::level::warn, fmt::format("[Scripting][{}] Exceeded its CPU budget, forcing it to yield", name));
+		}
+	}
+
+	// The hook can also land in the runner itself, outside the script's own coroutine.
+	// That suspends the whole script thread, which simply continues next frame.
+	if (result.status() == sol::call_status::yielded) {
+		script.state.waitUntil = frame.time;
+		return;
+	}
+
+	if (!result.valid()) {
+		// Handle error
+		sol::error err = result;
+		script.state.isRunning = false;
+		script.state.error = err.what();
+		log(spdlog::level::err, fmt::format("[Scripting][{}] Error: {}", name, err.what()));
+		return;
+	}
+
+	// Parse results (is_alive, wait_time, error_message)
+	bool isAlive = result[0];
+	float waitTime = result[1];
+
+	if (result[2].is<std::string>()) {
+		// Error occurred
+		script.state.isRunning = false;
+		script.state.error = result[2].get<std::string>();
+		log(spdlog::level::err, fmt::format("[Scripting][{}] Error: {}", name, script.state.error));
+		return;
+	}
+
+	if (isAlive) {
+		// Script is still running, update wait time
+		script.state.waitUntil = frame.time + waitTime;
+	}
+	else {
+		// Script has finished
+		script.state.isRunning = false;
+		log(spdlog::level::info, fmt::format("[Scripting][{}] Script completed", name));
+	}
+}
+
+void ScriptVM::setBudget(const ScriptBudget& budget) {
+	m_budget = budget;
+	updateBudgetHook();
+}
+
+void ScriptVM::setMemoryLimit(std::size_t bytes) {
+	m_memoryLimit = bytes;
+
+	for (auto& [_, script] : m_scripts) {
+		m_allocator.setLimit(script.owner, bytes);
+	}
+}
+
+void ScriptVM::updateBudgetHook() {
+	lua_State* L = m_lua.lua_state();
+
+	if (m_budget.isActive() && !m_hookInstalled) {
+		// Hooks never fire inside compiled traces, so drop the ones we already have
+		luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_FLUSH);
+		lua_sethook(L, &ScriptVM::budgetHook, LUA_MASKCOUNT, BUDGET_HOOK_INTERVAL);
+		m_hookInstalled = true;
+	}
+	else if (!m_budget.isActive() && m_hookInstalled) {
+		lua_sethook(L, nullptr, 0, 0);
+		m_hookInstalled = false;
+	}
+}
+
+void ScriptVM::budgetHook(lua_State* L, lua_Debug* ar) {
+	// Only scripts are budgeted, exec() and script creation run unhooked
+	ScriptVM* vm = t_activeVM;
+	if (!vm || !vm->m_running.script) return;
+
+	auto& running = vm->m_running;
+	const auto& budget = vm->m_budget;
+	running.instructions += BUDGET_HOOK_INTERVAL;
+
+	bool overBudget = budget.instructions > 0 && running.instructions >= budget.instructions;
+	if (!overBudget && budget.milliseconds > 0.0f) {
+		float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - running.start).count();
+		overBudget = elapsedMs >= budget.milliseconds;
+	}
+
+	if (!overBudget) return;
+
+	running.exceeded = true;
+	if (budget.killOnExceed) {
+		luaL_error(L, "CPU budget exceeded (%u instructions, %.2f ms)", budget.instructions, static_cast<double>(budget.milliseconds));
+		return;
+	}
+
+	// LuaJIT supports yielding from count hooks, the script resumes right here next frame
+	lua_yield(L, 0);
+}
+
+void ScriptVM::publish() {
+	std::lock_guard lock(m_publishMutex);
+
+	for (auto it = m_published.begin(); it != m_published.end();) {
+		if (m_scripts.find(it->first) == m_scripts.end()) it = m_published.erase(it);
+		else ++it;
+	}
+
+	m_publishedGC = m_gcStats;
+
+	for (auto& [name, script] : m_scripts) {
+		if (m_pooledAllocator) {
+			const auto& memory = m_allocator.getStats(script.owner);
+			script.state.memoryBytes = memory.bytes;
+			script.state.peakMemoryBytes = memory.peakBytes;
+			script.state.allocatedBytes = m_allocator.takeAllocated(script.owner);
+		}
+
+		auto& published = m_published[name];
+		published.state = script.state;
+		published.valid = script.coroutine.valid();
+	}
+}
+
+bool ScriptVM::getState(const std::string& name, ScriptState& outState, bool* outValid) const {
+	std::lock_guard lock(m_publishMutex);
+
+	auto it = m_published.find(name);
+	if (it == m_published.end()) return false;
+
+	outState = it->second.state;
+	if (outValid) *outValid = it->second.valid;
+	return true;
+}
+
+GCStats ScriptVM::getGCStats() const {
+	std::lock_guard lock(m_publishMutex);
+	return m_publishedGC;
+}
+
+void ScriptVM::setGCSettings(const GCSettings& settings) {
+	m_gc = settings;
+	applyGCSettings();
+}
+
+void ScriptVM::applyGCSettings() {
+	lua_State* L = m_lua.lua_state();
+	lua_gc(L, LUA_GCSETPAUSE, m_gc.pause);
+	lua_gc(L, LUA_GCSETSTEPMUL, m_gc.stepMul);
+
+	if (m_gc.manual) {
+		lua_gc(L, LUA_GCSTOP, 0);
+
+		// Without a first threshold nothing would bound the heap before the first cycle ends
+		if (m_gcThresholdKB == 0) {
+			m_gcThresholdKB = static_cast<std::size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * m_gc.pause / 100;
+		}
+	}
+	else {
+		lua_gc(L, LUA_GCRESTART, 0);
+		m_gcCycleInProgress = false;
+	}
+}
+
+void ScriptVM::finishGCCycle() {
+	lua_State* L = m_lua.lua_state();
+	lua_gc(L, LUA_GCCOLLECT, 0);
+	if (!m_gc.manual) return;
+
+	lua_gc(L, LUA_GCSTOP, 0); // a full cycle re-arms the automatic trigger
+	completeGCCycle(true);
+}
+
+void ScriptVM::completeGCCycle(bool forced) {
+	m_gcCycleInProgress = false;
+	++m_gcStats.cyclesCompleted;
+	if (forced) ++m_gcStats.forcedCycles;
+
+	m_gcThresholdKB = static_cast<std::size_t>(lua_gc(m_lua.lua_state(), LUA_GCCOUNT, 0)) * m_gc.pause / 100;
+}
+
+void ScriptVM::boundHeap() {
+	if (!m_gc.manual || m_gcThresholdKB == 0) return;
+
+	// Frame end is too late for a script that allocates a lot within one resume. Past the
+	// threshold every resume steps the cycle once, far past it the cycle is finished.
+	lua_State* L = m_lua.lua_state();
+	std::size_t heapKB = static_cast<std::size_t>(lua_gc(L, LUA_GCCOUNT, 0));
+	if (heapKB >= m_gcThresholdKB * 2) {
+		finishGCCycle();
+		return;
+	}
+	if (heapKB < m_gcThresholdKB) return;
+
+	m_gcCycleInProgress = true;
+	++m_gcStats.stepsLastFrame;
+	if (lua_gc(L, LUA_GCSTEP, 0)) completeGCCycle(false);
+	lua_gc(L, LUA_GCSTOP, 0);
+}
+
+void ScriptVM::collectNearLimit(ScriptData& script) {
+	if (!m_pooledAllocator) return;
+
+	// The allocator only refuses blocks past the cap, collecting from inside it could free
+	// objects that are still being built. Part of what the script holds may be garbage the
+	// stopped collector hasn't got to, so it is collected here, between two resumes.
+	const auto& memory = m_allocator.getStats(script.owner);
+	if (memory.limit == 0 || memory.bytes * 100 < memory.limit * LIMIT_COLLECT_PERCENT) return;
+
+	// Still at what the last collection left behind, another cycle wouldn't free anything
+	if (memory.bytes <= script.collectedBytes) return;
+
+	finishGCCycle();
+	script.collectedBytes = m_allocator.getStats(script.owner).bytes;
+}
+
+void ScriptVM::collectGarbage() {
+	lua_State* L = m_lua.lua_state();
+	auto start = std::chrono::steady_clock::now();
+	auto elapsedMs = [&start] {
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		};
+
+	if (m_gc.manual) {
+		std::size_t heapKB = static_cast<std::size_t>(lua_gc(L, LUA_GCCOUNT, 0));
+
+		// Like the automatic collector, a new cycle only starts once the heap has grown
+		// past the pause threshold. Far past it the budget is ignored to keep the heap bounded.
+		if (!m_gcCycleInProgress && heapKB >= m_gcThresholdKB) m_gcCycleInProgress = true;
+		bool forced = m_gcThresholdKB > 0 && heapKB >= m_gcThresholdKB * 2;
+
+		while (m_gcCycleInProgress && (forced || elapsedMs() < m_gc.budgetMs)) {
+			++m_gcStats.stepsLastFrame;
+			if (lua_gc(L, LUA_GCSTEP, 0)) completeGCCycle(forced);
+		}
+
+		// Stepping re-arms the automatic trigger, keep it off until the next frame
+		lua_gc(L, LUA_GCSTOP, 0);
+	}
+
+	m_gcStats.lastStepMs = elapsedMs();
+	m_gcStats.heapBytes = static_cast<std::size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024
+		+ static_cast<std::size_t>(lua_gc(L, LUA_GCCOUNTB, 0));
+}
+
+void ScriptVM::runScript(const std::string& name, const std::string& code) {
+	// Replacing a script always starts it from scratch. Scripts that fail to load keep
+	// an entry without a coroutine so the error can still be shown.
+	deleteScript(name);
+
+	LuaAllocator::OwnerId owner = m_allocator.registerOwner(m_memoryLimit);
+	m_allocator.setCurrentOwner(owner);
+
+	try {
+		// Create a new thread for this script
+		sol::thread scriptThread = sol::thread::create(m_lua.lua_state());
+		// Get a reference to the thread's state
+		sol::state_view threadState = scriptThread.state();
+		// Create an environment for the script
+		sol::environment env(threadState, sol::create, m_lua.globals());
+
+		// Add logging functions to the environment
+		registerLogFuncs(env);
+
+		// Create the script runner
+		sol::protected_function createRunner = m_lua["create_script_runner"];
+		sol::protected_function_result result = createRunner(code, name);
+
+		if (!result.valid()) {
+			sol::error err = result;
+			auto& failed = m_scripts[name];
+			failed.owner = owner;
+			failed.state.error = err.what();
+			log(spdlog::level::err, fmt::format("[Scripting][{}] Failed to create script: {}", name, err.what()));
+		}
+		else {
+			sol::function runner = result;
+
+			// Store the script data
+			m_scripts[name] = ScriptData{
+				.thread = std::move(scriptThread),
+				.env = std::move(env),
+				.coroutine = sol::coroutine(threadState, runner),
+				.state = {
+					.isRunning = true,
+					.isPaused = false,
+					.waitUntil = 0.0f,
+					.error = ""
+				},
+				.owner = owner
+			};
+
+			log(spdlog::level::info, fmt::format("[Scripting] Successfully loaded script: {} (VM {})", name, m_index));
+		}
+	}
+	catch (const std::exception& e) {
+		auto& failed = m_scripts[name];
+		failed.owner = owner;
+		failed.state.error = e.what();
+		log(spdlog::level::err, fmt::format("[Scripting][{}] Exception during script loading: {}", name, e.what()));
+	}
+
+	m_allocator.setCurrentOwner(LuaAllocator::SHARED_OWNER);
+}
+
+bool ScriptVM::deleteScript(const std::string& name) {
+	auto it = m_scripts.find(name);
+	if (it == m_scripts.end()) return false;
+
+	// Its objects are still charged to it until the GC gets to them
+	m_allocator.releaseOwner(it->second.owner);
+	m_scripts.erase(it);
+	return true;
+}
+
+void ScriptVM::setPaused(const std::string& name, bool paused) {
+	auto it = m_scripts.find(name);
+	if (it != m_scripts.end()) {
+		it->second.state.isPaused = paused;
+	}
+}
+
+void ScriptVM::stopScript(const std::string& name) {
+	auto it = m_scripts.find(name);
+	if (it != m_scripts.end()) {
+		it->second.state.isRunning = false;
+	}
+}
+
+void ScriptVM::exec(const std::string& code) {
+	sol::protected_function_result result = m_lua.safe_script(code, &sol::script_pass_on_error);
+	if (!result.valid()) {
+		sol::error err = result;
+		log(spdlog::level::err, fmt::format("[Scripting] exec error: {}", err.what()));
+	}
+}
+
+void ScriptVM::log(spdlog::level::level_enum level, std::string message) {
+	if (!m_threaded || !m_postToMain) {
+		spdlog::log(level, "{}", message);
+		return;
+	}
+
+	m_postToMain([level, message = std::move(message)] {
+		spdlog::log(level, "{}", message);
+	});
+}
+
+void ScriptVM::initializeCoroutineRuntime() {
+	try {
+		// Load our coroutine system
+		sol::protected_function_result result = m_lua.safe_script(
+			LUA_COROUTINE_SYSTEM,
+			&sol::script_pass_on_error
+		);
+
+		if (!result.valid()) {
+			sol::error err = result;
+			spdlog::error("[Scripting] Failed to initialize coroutine system: {}", err.what());
+		}
+	}
+	catch (const std::exception& e) {
+		spdlog::error("[Scripting] Exception during initialization: {}", e.what());
+	}
+}
+
+std::string ScriptVM::luaValueToString(const sol::object& obj) {
+	switch (obj.get_type()) {
+	case sol::type::number:
+		return std::to_string(obj.as<double>());
+	case sol::type::string:
+		return obj.as<std::string>();
+	case sol::type::boolean:
+		return obj.as<bool>() ? "true" : "false";
+	case sol::type::nil:
+		return "nil";
+	case sol::type::userdata: {
+		auto ud = obj.as<sol::userdata>();
+		if (ud.is<glm::vec2>()) {
+			auto v = ud.as<glm::vec2>();
+			return fmt::format("vec2({}, {})", v.x, v.y);
+		}
+		else if (ud.is<glm::vec3>()) {
+			auto v = ud.as<glm::vec3>();
+			return fmt::format("vec3({}, {}, {})", v.x, v.y, v.z);
+		}
+		return "<userdata>";
+	}
+	case sol::type::table:
+		return "<table>";
+	default:
+		return "<unknown>";
+	}
+}
+
+std::string ScriptVM::formatLuaArgs(sol::variadic_args va) {
+	std::string result;
+	for (size_t i = 0; i < va.size(); ++i) {
+		if (i > 0) result += ", ";
+		result += luaValueToString(va[i]);
+	}
+	return result;
+}
+
+template <typename Table>
+void ScriptVM::registerLogFuncs(Table& target) {
+	auto bind = [this, &target](const char* name, spdlog::level::level_enum level) {
+		target.set_function(name, [this, level](sol::variadic_args va) {
+			// Disabled levels return before any argument is converted
+			if (!spdlog::should_log(level)) return;
+			log(level, fmt::format("[LUA] {}", formatLuaArgs(va)));
+			});
+		};
+
+	bind("trace", spdlog::level::trace);
+	bind("debug", spdlog::level::debug);
+	bind("info", spdlog::level::info);
+	bind("print", spdlog::level::info);
+	bind("warn", spdlog::level::warn);
+	bind("error", spdlog::level::err);
+	bind("critical", spdlog::level::critical);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "pch.h"
+
+#include "allocator.h"
+
+namespace Lunatic {
+	struct ScriptState {
+		bool isRunning = false;
+		bool isPaused = false;
+		float waitUntil = 0.0f;
+		std::string error;
+
+		// Execution time accounting, in milliseconds per resume
+		float lastRunMs = 0.0f;
+		float averageRunMs = 0.0f;
+		float peakRunMs = 0.0f;
+		std::uint32_t budgetOverruns = 0;
+
+		// Memory accounting, only tracked while the VM runs on the pooled allocator
+		std::size_t memoryBytes = 0;
+		std::size_t peakMemoryBytes = 0;
+		std::size_t allocatedBytes = 0; // allocated during the last tick, i.e. GC pressure
+	};
+
+	// CPU budget for a single resume of a script. A script that runs past it is forced
+	// to yield (and continues next frame) or, with killOnExceed, stopped with an error.
+	// Enforcement uses a count hook, which keeps LuaJIT from compiling new traces while
+	// a budget is active.
+	struct ScriptBudget {
+		std::uint32_t instructions = 0; // 0 = unlimited
+		float milliseconds = 0.0f;      // 0 = unlimited
+		bool killOnExceed = false;
+
+		bool isActive() const { return instructions > 0 || milliseconds > 0.0f; }
+	};
+
+	// Engine data handed to a VM at the start of each tick. Every VM works on its
+	// own copy, so the main thread is free to publish the next frame at any time.
+	struct ScriptFrame {
+		float time = 0.0f;
+		float deltaTime = 0.0f;
+		std::uint64_t index = 0;
+	};
+
+	// How the VM drives its garbage collector. In manual mode the collector never runs
+	// on its own, instead it is stepped at the end of every frame for at most budgetMs.
+	// A heap past the pause threshold is also stepped after each script resume.
+	struct GCSettings {
+		bool manual = true;
+		float budgetMs = 1.0f;
+		int pause = 200;   // LUA_GCSETPAUSE, heap growth (%) before the next cycle starts
+		int stepMul = 200; // LUA_GCSETSTEPMUL, collector speed relative to allocation
+	};
+
+	struct GCStats {
+		float lastStepMs = 0.0f;
+		std::size_t heapBytes = 0;
+		std::uint32_t stepsLastFrame = 0;
+		std::uint32_t cyclesCompleted = 0;
+		std::uint32_t forcedCycles = 0; // cycles finished past the budget to keep the heap bounded
+	};
+
+	/// <summary>
+	/// An isolated Lua state and the scripts that live in it. A VM is either ticked
+	/// inline on the main thread or owns a worker thread, which is then the only
+	/// thread that ever touches its lua_State.
+	/// </summary>
+	class ScriptVM {
+	public:
+		using Job = std::function<void(ScriptVM&)>;
+		using MainThreadCall = std::function<void()>;
+		using MainThreadPoster = std::function<void(MainThreadCall)>;
+
+		ScriptVM(std::size_t index, bool threaded, MainThreadPoster postToMain);
+		~ScriptVM();
+
+		std::size_t getIndex() const { return m_index; }
+		bool isThreaded() const { return m_threaded; }
+
+		// Queues work to run on the VM's thread before its next tick
+		void post(Job job);
+
+		// Inline VMs only: runs the queued jobs and then job right away on the caller's thread
+		void runInline(Job job);
+
+		// Inline VMs tick right away, worker VMs are woken up and tick on their own
+		// thread. A worker that is still busy picks up the newest frame when done.
+		void kick(const ScriptFrame& frame);
+
+		// Reads the state published at the end of the last tick (any thread)
+		bool getState(const std::string& name, ScriptState& outState, bool* outValid = nullptr) const;
+		GCStats getGCStats() const;
+
+		// Worker VMs collect at the end of each tick, the inline VM once the frame is done
+		void endFrame();
+
+		// Everything below must only be called from the VM's own thread (i.e. from a Job)
+		void runScript(const std::string& name, const std::string& code);
+		bool deleteScript(const std::string& name);
+		void setPaused(const std::string& name, bool paused);
+		void stopScript(const std::string& name);
+		void exec(const std::string& code);
+		void setBudget(const ScriptBudget& budget);
+		void setMemoryLimit(std::size_t bytes); // per script, 0 = unlimited
+		void setGCSettings(const GCSettings& settings);
+
+	private:
+		struct ScriptData {
+			sol::thread thread;
+			sol::environment env;
+			sol::coroutine coroutine;
+			ScriptState state;
+			LuaAllocator::OwnerId owner = LuaAllocator::SHARED_OWNER;
+			std::size_t collectedBytes = 0; // what it held right after the last collection for its cap
+		};
+
+		struct PublishedState {
+			ScriptState state;
+			bool valid = false;
+		};
+
+		std::size_t m_index;
+		bool m_threaded;
+		MainThreadPoster m_postToMain;
+
+		// Declaration order matters: the allocator outlives the state, which outlives the view
+		LuaAllocator m_allocator;
+		bool m_pooledAllocator = false;
+		std::unique_ptr<lua_State, decltype(&lua_close)> m_state;
+		sol::state_view m_lua;
+		std::unordered_map<std::string, ScriptData> m_scripts;
+		std::size_t m_memoryLimit = 0;
+
+		// Budget bookkeeping for the script currently being resumed
+		struct RunningScript {
+			ScriptData* script = nullptr;
+			std::chrono::steady_clock::time_point start;
+			std::uint32_t instructions = 0;
+			bool exceeded = false;
+		};
+
+		ScriptBudget m_budget;
+		RunningScript m_running;
+		bool m_hookInstalled = false;
+
+		// Shared between the owner and the VM thread
+		mutable std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::vector<Job> m_jobs;
+		ScriptFrame m_pendingFrame;
+		bool m_hasFrame = false;
+		bool m_stopRequested = false;
+		std::thread m_worker;
+
+		mutable std::mutex m_publishMutex;
+		std::unordered_map<std::string, PublishedState> m_published;
+		GCStats m_publishedGC;
+
+		GCSettings m_gc;
+		GCStats m_gcStats;
+		std::size_t m_gcThresholdKB = 0; // heap size that starts the next manual cycle
+		bool m_gcCycleInProgress = false;
+
+		void workerLoop();
+		void runJobs(std::vector<Job>& jobs);
+		void tick(const ScriptFrame& frame);
+		void publish();
+
+		void applyGCSettings();
+		void collectGarbage();
+		void finishGCCycle();
+		void completeGCCycle(bool forced);
+		void boundHeap();
+		void collectNearLimit(ScriptData& script);
+
+		void resumeScript(const std::string& name, ScriptData& script, const ScriptFrame& frame);
+		void updateBudgetHook();
+		static void budgetHook(lua_State* L, lua_Debug* ar);
+
+		// Worker VMs must not touch the console sink directly, so their logs are
+		// formatted here and handed back to the main thread.
+		void log(spdlog::level::level_enum level, std::string message);
+
+		lua_State* createState();
+		void initializeCoroutineRuntime();
+		std::string luaValueToString(const sol::object& obj);
+		std::string formatLuaArgs(sol::variadic_args va);
+		template <typename Table>
+		void registerLogFuncs(Table& target);
+	};
+} // namespace Lunatic
@@ -0,0 +1,46 @@
+#include "logging/binary_log_reader.h"
+
+#include "spdlog/pattern_formatter.h"
+
+// Decodes a binary log capture (see Lunatic::BinaryLog) to text on stdout
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "Usage: LunaticLogDecode <capture.lbl> [spdlog pattern]\n";
+		return 1;
+	}
+
+	std::unique_ptr<Lunatic::BinaryLogReader> reader;
+	try {
+		reader = std::make_unique<Lunatic::BinaryLogReader>(argv[1]);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Could not open " << argv[1] << ": " << e.what() << '\n';
+		return 1;
+	}
+
+	auto formatter = argc > 2
+		? std::make_unique<spdlog::pattern_formatter>(argv[2])
+		: std::make_unique<spdlog::pattern_formatter>();
+
+	spdlog::memory_buf_t formatted;
+	Lunatic::BinaryLogReader::Entry entry;
+	std::size_t count = 0;
+
+	while (reader->next(entry)) {
+		spdlog::details::log_msg msg(entry.time, spdlog::source_loc{}, "Lunatic", entry.level,
+			spdlog::string_view_t(entry.text.data(), entry.text.size()));
+		msg.thread_id = entry.threadId;
+
+		formatted.clear();
+		formatter->format(msg, formatted);
+		std::cout.write(formatted.data(), static_cast<std::streamsize>(formatted.size()));
+		++count;
+	}
+
+	std::cerr << count << " records decoded";
+	if (reader->getDroppedCount() > 0) {
+		std::cerr << ", " << reader->getDroppedCount() << " dropped while capturing";
+	}
+	std::cerr << '\n';
+	return 0;
+}
@@ -1,20 +1,118 @@
 #include "core/engine.h"
+#include "core/perf_run.h"
+
+#include "stress_scene.h"
 
 #include "hierarchy/services/workspace.h"
 #include "hierarchy/services/scripting.h"
 #include "hierarchy/services/renderer.h"
+#include "hierarchy/services/mesh_cache.h"
+#include "hierarchy/services/streaming.h"
 
 #include "spdlog/spdlog.h"
 
-int main(void) {
+static void printUsage() {
+	std::cerr << "Usage: LunaticRuntime [--headless] [--no-vsync] [--frames N] [--warmup N]\n"
+		"                      [--camera-path file] [--golden file.ppm] [--capture file.ppm]\n"
+		"                      [--stress flat|chain|fanout|scripts] [--count N] [--breadth N] [--csv file.csv]\n"
+		"  --frames runs a measured perf run of N frames and exits, 1 if the image differs from --golden\n"
+		"  --stress replaces the scene with a generated one and implies a perf run, 600 frames by default\n";
+}
+
+int main(int argc, char** argv) {
 	spdlog::set_level(spdlog::level::trace);
 
-	Lunatic::Engine engine(1280, 720, "Lunatic Engine");
+	Lunatic::EngineOptions options;
+	Lunatic::PerfRun::Config perf;
+	bool perfRun = false;
+	std::filesystem::path cameraPath;
+	std::optional<Lunatic::StressScene::Config> stress;
+	std::optional<std::size_t> stressCount;
+	std::optional<std::size_t> stressBreadth;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--headless") options.headless = true;
+		else if (arg == "--no-vsync") options.vsync = false;
+		else if (arg == "--frames" && hasValue) { perf.frames = std::stoull(argv[++i]); perfRun = true; }
+		else if (arg == "--warmup" && hasValue) perf.warmupFrames = std::stoull(argv[++i]);
+		else if (arg == "--camera-path" && hasValue) cameraPath = argv[++i];
+		else if (arg == "--golden" && hasValue) perf.golden = argv[++i];
+		else if (arg == "--capture" && hasValue) perf.capture = argv[++i];
+		else if (arg == "--csv" && hasValue) { perf.csv = argv[++i]; perfRun = true; }
+		else if (arg == "--stress" && hasValue) {
+			auto shape = Lunatic::StressScene::ParseShape(argv[++i]);
+			if (!shape) {
+				printUsage();
+				return 2;
+			}
+			if (!stress) stress.emplace();
+			stress->shape = *shape;
+			perfRun = true;
+		}
+		else if (arg == "--count" && hasValue) stressCount = std::stoull(argv[++i]);
+		else if (arg == "--breadth" && hasValue) stressBreadth = std::stoull(argv[++i]);
+		else {
+			printUsage();
+			return 2;
+		}
+	}
+
+	if (stress) {
+		stress->count = stressCount.value_or(stress->count);
+		stress->breadth = stressBreadth.value_or(stress->breadth);
+	}
+	if ((perfRun && perf.frames == 0) || (stress && stress->count == 0)) {
+		printUsage();
+		return 2;
+	}
+
+	// Measurements shouldn't be capped at the display's refresh rate
+	if (perfRun) options.vsync = false;
+
+	Lunatic::Engine engine(1280, 720, "Lunatic Engine", options);
 
 	engine.registerService<Lunatic::Services::Workspace>("Workspace");
 	engine.registerService<Lunatic::Services::Scripting>("Scripting");
+	engine.registerService<Lunatic::Services::MeshCache>("MeshCache");
 	engine.registerService<Lunatic::Services::Renderer>("Renderer");
 	engine.registerService<Lunatic::Services::Debug>("Debug");
+	engine.registerService<Lunatic::Services::Streaming>("Streaming");
+
+	// Streamed worlds are optional, scenes can still be loaded whole through the Workspace.
+	// Stress runs measure the generated scene alone.
+	if (!stress && std::filesystem::is_directory("world")) {
+		engine.getService<Lunatic::Services::Streaming>("Streaming")->setWorld("world");
+	}
+
+	if (!perfRun) {
+		if (options.headless) {
+			spdlog::warn("[Runtime] Headless without --frames runs until killed");
+		}
+		engine.run();
+		return 0;
+	}
+
+	auto renderer = engine.getService<Lunatic::Services::Renderer>("Renderer");
+	if (stress) {
+		const Lunatic::StressScene::Built built = Lunatic::StressScene::Build(*stress,
+			*engine.getService<Lunatic::Services::Workspace>("Workspace"), *engine.getService<Lunatic::Services::Scripting>("Scripting"));
+
+		// One slow lap around the whole scene, unless a path was given
+		const float distance = built.radius * 1.5f;
+		renderer->getCamera().setNearFar(0.1f, distance * 4.0f);
+		if (cameraPath.empty()) {
+			perf.cameraPath = Lunatic::CameraPath::Orbit(glm::vec3(0.0f), distance, distance * 0.5f,
+				static_cast<float>(perf.frames) * perf.timeStep);
+		}
+	}
+	if (!cameraPath.empty()) {
+		perf.cameraPath = Lunatic::CameraPath::Load(cameraPath);
+	}
+	perf.warmupFrames = std::min(perf.warmupFrames, perf.frames - 1);
 
-	engine.run();
-}
\ No newline at end of file
+	Lunatic::PerfRun::Report report = Lunatic::PerfRun(engine, perf).run();
+	spdlog::info("[Runtime] {}", report.summary());
+	return report.passed ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#include "stress_scene.h"
+
+#include "hierarchy/objects/cube.h"
+
+#include <glm/gtc/constants.hpp>
+
+using namespace Lunatic;
+
+static constexpr float GRID_SPACING = 2.0f;
+static constexpr std::size_t SCRIPT_CUBES = 64;
+
+// Each script keeps its own little simulation going, the VM resumes all of them every frame.
+// Build() puts a "local phase = ..." line in front.
+static constexpr std::string_view ANIMATED_SCRIPT = R"LUA(
+local state = { x = 0, y = 0, angle = 0 }
+while true do
+	state.angle = state.angle + 0.05
+	state.x = math.cos(state.angle + phase) * 2
+	state.y = math.sin(state.angle * 2 + phase)
+	wait(0)
+end
+)LUA";
+
+static std::vector<std::shared_ptr<Instance>> createCubes(std::size_t count) {
+	std::vector<std::shared_ptr<Instance>> cubes;
+	InstanceRegistry::CreateMany(InstanceRegistry::GetClassId<Cube>(), count, cubes);
+	return cubes;
+}
+
+// count cubes on a square grid around the origin, returns the grid's half extent
+static float buildGrid(Instance& parent, std::size_t count) {
+	const auto side = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	const float offset = (static_cast<float>(side) - 1.0f) * GRID_SPACING * 0.5f;
+
+	auto cubes = createCubes(count);
+	for (std::size_t i = 0; i < cubes.size(); ++i) {
+		cubes[i]->setName(std::format("Cube{}", i));
+		cubes[i]->position = glm::vec3(static_cast<float>(i % side) * GRID_SPACING - offset, 0.0f,
+			static_cast<float>(i / side) * GRID_SPACING - offset);
+		parent.addChild(cubes[i]);
+	}
+	return offset + GRID_SPACING;
+}
+
+std::optional<StressScene::Shape> StressScene::ParseShape(std::string_view name) {
+	for (Shape shape : { Shape::Flat, Shape::Chain, Shape::Fanout, Shape::Scripts }) {
+		if (name == GetShapeName(shape)) return shape;
+	}
+	return std::nullopt;
+}
+
+std::string_view StressScene::GetShapeName(Shape shape) {
+	switch (shape) {
+	case Shape::Flat: return "flat";
+	case Shape::Chain: return "chain";
+	case Shape::Fanout: return "fanout";
+	case Shape::Scripts: return "scripts";
+	}
+	return "unknown";
+}
+
+StressScene::Built StressScene::Build(const Config& config, Services::Workspace& workspace, Services::Scripting& scripting) {
+	LUN_ASSERT(config.count > 0, "A stress scene needs at least one instance or script")
+	auto start = std::chrono::steady_clock::now();
+
+	workspace.clearAllChildren();
+	Built built;
+
+	switch (config.shape) {
+	case Shape::Flat:
+		built.radius = buildGrid(workspace, config.count);
+		built.instances = config.count;
+		built.depth = 1;
+		break;
+
+	case Shape::Chain: {
+		// Every link is offset and turned a little from its parent, so the chain coils up
+		auto cubes = createCubes(config.count);
+		Instance* parent = &workspace;
+		for (std::size_t i = 0; i < cubes.size(); ++i) {
+			cubes[i]->setName(std::format("Link{}", i));
+			cubes[i]->position = i == 0 ? glm::vec3(0.0f) : glm::vec3(1.5f, 0.02f, 0.0f);
+			cubes[i]->rotation = glm::vec3(0.0f, 10.0f, 0.0f);
+			parent->addChild(cubes[i]);
+			parent = cubes[i].get();
+		}
+		built.instances = config.count;
+		built.depth = config.count;
+		built.radius = 10.0f + 0.02f * static_cast<float>(config.count);
+		break;
+	}
+
+	case Shape::Fanout: {
+		// Breadth first, so a count that doesn't fill the last level leaves it ragged
+		const std::size_t breadth = std::max<std::size_t>(config.breadth, 1);
+		auto cubes = createCubes(config.count);
+		std::deque<std::pair<Instance*, std::size_t>> open{ { &workspace, 0 } };
+		std::size_t next = 0;
+		while (next < cubes.size() && !open.empty()) {
+			auto [parent, level] = open.front();
+			open.pop_front();
+
+			// Rings shrink with depth so siblings stay apart
+			const float ring = 8.0f / static_cast<float>(level + 1);
+			for (std::size_t i = 0; i < breadth && next < cubes.size(); ++i, ++next) {
+				const float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(breadth);
+				cubes[next]->setName(std::format("Node{}", next));
+				cubes[next]->position = glm::vec3(std::cos(angle) * ring, -1.5f, std::sin(angle) * ring);
+				parent->addChild(cubes[next]);
+				open.emplace_back(cubes[next].get(), level + 1);
+				built.depth = std::max(built.depth, level + 1);
+			}
+		}
+		built.instances = config.count;
+		built.radius = 16.0f;
+		break;
+	}
+
+	case Shape::Scripts:
+		built.radius = buildGrid(workspace, SCRIPT_CUBES);
+		built.instances = SCRIPT_CUBES;
+		built.depth = 1;
+		for (std::size_t i = 0; i < config.count; ++i) {
+			scripting.loadScript(std::format("Stress{}", i),
+				std::format("local phase = {:.2f}", static_cast<float>(i) * 0.1f) + std::string(ANIMATED_SCRIPT));
+		}
+		built.scripts = config.count;
+		break;
+	}
+
+	spdlog::info("[StressScene] Built {} with {} instances and {} scripts, {} levels deep, in {:.1f} ms",
+		GetShapeName(config.shape), built.instances, built.scripts, built.depth,
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	return built;
+}
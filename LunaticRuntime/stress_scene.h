@@ -0,0 +1,43 @@
+#pragma once
+
+#include "hierarchy/services/workspace.h"
+#include "hierarchy/services/scripting.h"
+
+#include <optional>
+
+namespace Lunatic {
+	/// <summary>
+	/// Procedural scenes for finding where the engine stops scaling. Flat puts count cubes
+	/// on a grid under the workspace, Chain parents count cubes each to the one before, Fanout
+	/// gives every cube breadth children down to a total of about count, and Scripts loads
+	/// count Lua coroutines that animate a small state every frame next to a few cubes.
+	/// The same config always builds the same scene.
+	/// </summary>
+	struct StressScene {
+		enum class Shape {
+			Flat,
+			Chain,
+			Fanout,
+			Scripts
+		};
+
+		struct Config {
+			Shape shape = Shape::Flat;
+			std::size_t count = 10000;
+			std::size_t breadth = 8; // Fanout only
+		};
+
+		struct Built {
+			std::size_t instances = 0;
+			std::size_t scripts = 0;
+			std::size_t depth = 0;  // deepest level below the workspace
+			float radius = 0.0f;    // around the origin, for placing the camera
+		};
+
+		static std::optional<Shape> ParseShape(std::string_view name);
+		static std::string_view GetShapeName(Shape shape);
+
+		// Replaces whatever the workspace holds. Call before Engine::run, which keeps it.
+		static Built Build(const Config& config, Services::Workspace& workspace, Services::Scripting& scripting);
+	};
+} // namespace Lunatic
@@ -0,0 +1,40 @@
+@echo off
+rem Renders every scene under golden\ headless and compares it against its expected.ppm.
+rem   run_golden.bat [path\to\LunaticRuntime.exe] [record]
+rem Each scene directory holds a scene.lscene, which the Workspace loads from the working
+rem directory, and a camera.path. "record" writes the missing expected.ppm files instead,
+rem review and commit them; without it a missing reference fails the run.
+setlocal enabledelayedexpansion
+
+set "ROOT=%~dp0"
+set "RUNTIME=%~1"
+if "%RUNTIME%"=="" set "RUNTIME=%ROOT%..\x64\Release\LunaticRuntime.exe"
+for %%F in ("%RUNTIME%") do set "RUNTIME=%%~fF"
+if not exist "%RUNTIME%" (
+	echo LunaticRuntime not found at %RUNTIME%
+	exit /b 2
+)
+
+set FAILED=0
+for /d %%D in ("%ROOT%*") do (
+	if exist "%%D\scene.lscene" (
+		set "RUN=1"
+		if not exist "%%D\expected.ppm" if /i not "%~2"=="record" set "RUN=0"
+		if "!RUN!"=="0" (
+			echo %%~nxD: no expected.ppm, run with record first
+			set FAILED=1
+		) else (
+			pushd "%%D"
+			"%RUNTIME%" --headless --frames 120 --warmup 10 --camera-path camera.path --golden expected.ppm --capture actual.ppm
+			if errorlevel 1 (
+				echo %%~nxD: FAILED, compare actual.ppm against expected.ppm
+				set FAILED=1
+			) else (
+				echo %%~nxD: ok
+			)
+			popd
+		)
+	)
+)
+
+exit /b %FAILED%